@@ -0,0 +1,678 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "JsonDocument.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "JsonValue.h"
+
+namespace Common {
+
+namespace {
+
+const size_t MIN_BLOCK_SIZE = 64 * 1024;
+const uint32_t MIN_CONTAINER_CAPACITY = 4;
+// parseValue recurses per array or object, deeper documents are rejected before they exhaust the stack
+const size_t MAX_NESTING_DEPTH = 128;
+
+bool isWhiteSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+char readNonWsChar(const char*& it, const char* end) {
+  while (it != end && isWhiteSpace(*it)) {
+    ++it;
+  }
+
+  if (it == end) {
+    throw std::runtime_error("Unable to parse: unexpected end of stream");
+  }
+
+  return *it++;
+}
+
+void expectWord(const char*& it, const char* end, const char* rest, size_t size) {
+  if (static_cast<size_t>(end - it) < size || memcmp(it, rest, size) != 0) {
+    throw std::runtime_error("Unable to parse");
+  }
+
+  it += size;
+}
+
+// Returns raw contents of a string token, 'it' points past the opening quote
+StringView readStringToken(const char*& it, const char* end) {
+  const char* begin = it;
+  for (;;) {
+    if (it == end) {
+      throw std::runtime_error("Unable to parse: unexpected end of stream");
+    }
+
+    char c = *it++;
+    if (c == '"') {
+      return StringView(begin, it - begin - 1);
+    }
+
+    if (c == '\\') {
+      if (it == end) {
+        throw std::runtime_error("Unable to parse: unexpected end of stream");
+      }
+
+      ++it;
+    }
+  }
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+void appendInteger(std::string& out, int64_t value) {
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* begin = end;
+  uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  do {
+    *--begin = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  if (value < 0) {
+    *--begin = '-';
+  }
+
+  out.append(begin, end);
+}
+
+void appendReal(std::string& out, double value) {
+  // same formatting as JsonValue: fixed with 11 digits, trailing zeros trimmed
+  char buffer[512];
+  int size = snprintf(buffer, sizeof(buffer), "%.11f", value);
+  if (size < 0 || static_cast<size_t>(size) >= sizeof(buffer)) {
+    throw std::runtime_error("Unable to format real value");
+  }
+
+  while (size > 1 && buffer[size - 2] != '.' && buffer[size - 1] == '0') {
+    --size;
+  }
+
+  out.append(buffer, size);
+}
+
+}
+
+bool JsonNode::getBool() const {
+  if (type != BOOL) {
+    throw std::runtime_error("JsonValue type is not BOOL");
+  }
+
+  return valueBool;
+}
+
+int64_t JsonNode::getInteger() const {
+  if (type != INTEGER) {
+    throw std::runtime_error("JsonValue type is not INTEGER");
+  }
+
+  return valueInteger;
+}
+
+double JsonNode::getReal() const {
+  if (type != REAL) {
+    throw std::runtime_error("JsonValue type is not REAL");
+  }
+
+  return valueReal;
+}
+
+StringView JsonNode::getString() const {
+  if (type != STRING) {
+    throw std::runtime_error("JsonValue type is not STRING");
+  }
+
+  return StringView(valueString, count);
+}
+
+uint64_t JsonNode::size() const {
+  switch (type) {
+  case ARRAY:
+  case OBJECT:
+    return count;
+  default:
+    throw std::runtime_error("JsonValue type is not ARRAY or OBJECT");
+  }
+}
+
+const JsonNode& JsonNode::operator[](uint64_t index) const {
+  if (type != ARRAY) {
+    throw std::runtime_error("JsonValue type is not ARRAY");
+  }
+
+  if (index >= count) {
+    throw std::out_of_range("JsonValue array index out of range");
+  }
+
+  return items[index];
+}
+
+const JsonNode::Member& JsonNode::getMember(uint64_t index) const {
+  if (type != OBJECT) {
+    throw std::runtime_error("JsonValue type is not OBJECT");
+  }
+
+  if (index >= count) {
+    throw std::out_of_range("JsonValue member index out of range");
+  }
+
+  return members[index];
+}
+
+const JsonNode* JsonNode::find(StringView key, uint64_t hint) const {
+  uint64_t index = findIndex(key, hint);
+  return index < count ? &members[index].value : nullptr;
+}
+
+uint64_t JsonNode::findIndex(StringView key, uint64_t hint) const {
+  if (type != OBJECT) {
+    throw std::runtime_error("JsonValue type is not OBJECT");
+  }
+
+  if (hint >= count) {
+    hint = 0;
+  }
+
+  for (uint64_t i = hint; i < count; ++i) {
+    if (members[i].key == key) {
+      return i;
+    }
+  }
+
+  for (uint64_t i = 0; i < hint; ++i) {
+    if (members[i].key == key) {
+      return i;
+    }
+  }
+
+  return count;
+}
+
+JsonDocument::JsonDocument() : current(nullptr), remaining(0) {
+}
+
+JsonDocument::JsonDocument(JsonDocument&& other) : root(other.root), blocks(std::move(other.blocks)), current(other.current), remaining(other.remaining) {
+  other.root = JsonNode();
+  other.current = nullptr;
+  other.remaining = 0;
+}
+
+JsonDocument::~JsonDocument() {
+}
+
+JsonDocument& JsonDocument::operator=(JsonDocument&& other) {
+  if (this != &other) {
+    root = other.root;
+    blocks = std::move(other.blocks);
+    current = other.current;
+    remaining = other.remaining;
+    other.root = JsonNode();
+    other.current = nullptr;
+    other.remaining = 0;
+  }
+
+  return *this;
+}
+
+void JsonDocument::parse(StringView source) {
+  uint32_t size;
+  const char* it = copyString(source, size);
+  const char* end = it + size;
+
+  std::vector<JsonNode> items;
+  std::vector<JsonNode::Member> members;
+  JsonNode node;
+  parseValue(it, end, node, items, members, 0);
+  root = node;
+}
+
+void JsonDocument::setNil(JsonNode& node) {
+  node = JsonNode();
+}
+
+void JsonDocument::setBool(JsonNode& node, bool value) {
+  node = JsonNode();
+  node.type = JsonNode::BOOL;
+  node.valueBool = value;
+}
+
+void JsonDocument::setInteger(JsonNode& node, int64_t value) {
+  node = JsonNode();
+  node.type = JsonNode::INTEGER;
+  node.valueInteger = value;
+}
+
+void JsonDocument::setReal(JsonNode& node, double value) {
+  node = JsonNode();
+  node.type = JsonNode::REAL;
+  node.valueReal = value;
+}
+
+void JsonDocument::setString(JsonNode& node, StringView value) {
+  uint32_t size;
+  const char* data = copyString(value, size);
+  node = JsonNode();
+  node.type = JsonNode::STRING;
+  node.valueString = data;
+  node.count = size;
+}
+
+void JsonDocument::setArray(JsonNode& node) {
+  node = JsonNode();
+  node.type = JsonNode::ARRAY;
+  node.items = nullptr;
+}
+
+void JsonDocument::setObject(JsonNode& node) {
+  node = JsonNode();
+  node.type = JsonNode::OBJECT;
+  node.members = nullptr;
+}
+
+JsonNode& JsonDocument::pushBack(JsonNode& array) {
+  if (array.type != JsonNode::ARRAY) {
+    throw std::runtime_error("JsonValue type is not ARRAY");
+  }
+
+  if (array.count == array.capacity) {
+    array.items = grow(array.items, array.count, array.capacity);
+  }
+
+  JsonNode* item = new(&array.items[array.count++]) JsonNode();
+  return *item;
+}
+
+JsonNode& JsonDocument::insert(JsonNode& object, StringView key) {
+  if (object.type != JsonNode::OBJECT) {
+    throw std::runtime_error("JsonValue type is not OBJECT");
+  }
+
+  uint32_t keySize;
+  const char* keyData = copyString(key, keySize);
+  if (object.count == object.capacity) {
+    object.members = grow(object.members, object.count, object.capacity);
+  }
+
+  JsonNode::Member* member = new(&object.members[object.count++]) JsonNode::Member{StringView(keyData, keySize), JsonNode()};
+  return member->value;
+}
+
+JsonNode& JsonDocument::set(JsonNode& object, StringView key) {
+  uint64_t index = object.findIndex(key);
+  if (index < object.count) {
+    return object.members[index].value;
+  }
+
+  return insert(object, key);
+}
+
+void JsonDocument::assign(JsonNode& node, const JsonValue& value) {
+  switch (value.getType()) {
+  case JsonValue::ARRAY: {
+    setArray(node);
+    const JsonValue::Array& array = value.getArray();
+    for (const JsonValue& item : array) {
+      assign(pushBack(node), item);
+    }
+
+    break;
+  }
+  case JsonValue::BOOL:
+    setBool(node, value.getBool());
+    break;
+  case JsonValue::INTEGER:
+    setInteger(node, value.getInteger());
+    break;
+  case JsonValue::NIL:
+    setNil(node);
+    break;
+  case JsonValue::OBJECT: {
+    setObject(node);
+    const JsonValue::Object& object = value.getObject();
+    for (const auto& member : object) {
+      assign(insert(node, member.first), member.second);
+    }
+
+    break;
+  }
+  case JsonValue::REAL:
+    setReal(node, value.getReal());
+    break;
+  case JsonValue::STRING:
+    setString(node, value.getString());
+    break;
+  }
+}
+
+void JsonDocument::assign(JsonNode& node, const JsonNode& value) {
+  switch (value.type) {
+  case JsonNode::ARRAY:
+    setArray(node);
+    for (uint32_t i = 0; i < value.count; ++i) {
+      assign(pushBack(node), value.items[i]);
+    }
+
+    break;
+  case JsonNode::OBJECT:
+    setObject(node);
+    for (uint32_t i = 0; i < value.count; ++i) {
+      assign(insert(node, value.members[i].key), value.members[i].value);
+    }
+
+    break;
+  case JsonNode::STRING:
+    setString(node, value.getString());
+    break;
+  default:
+    node = value;
+    break;
+  }
+}
+
+JsonValue JsonDocument::toJsonValue(const JsonNode& node) {
+  switch (node.type) {
+  case JsonNode::ARRAY: {
+    JsonValue::Array array;
+    array.reserve(node.count);
+    for (uint32_t i = 0; i < node.count; ++i) {
+      array.push_back(toJsonValue(node.items[i]));
+    }
+
+    return JsonValue(std::move(array));
+  }
+  case JsonNode::BOOL:
+    return JsonValue(node.valueBool);
+  case JsonNode::INTEGER:
+    return JsonValue(node.valueInteger);
+  case JsonNode::OBJECT: {
+    JsonValue::Object object;
+    for (uint32_t i = 0; i < node.count; ++i) {
+      object.emplace(std::string(node.members[i].key), toJsonValue(node.members[i].value));
+    }
+
+    return JsonValue(std::move(object));
+  }
+  case JsonNode::REAL:
+    return JsonValue(node.valueReal);
+  case JsonNode::STRING:
+    return JsonValue(std::string(node.valueString, node.count));
+  default:
+    return JsonValue(JsonValue::NIL);
+  }
+}
+
+void JsonDocument::write(const JsonNode& node, std::string& out) {
+  switch (node.type) {
+  case JsonNode::ARRAY:
+    out += '[';
+    for (uint32_t i = 0; i < node.count; ++i) {
+      if (i != 0) {
+        out += ',';
+      }
+
+      write(node.items[i], out);
+    }
+
+    out += ']';
+    break;
+  case JsonNode::BOOL:
+    out += node.valueBool ? "true" : "false";
+    break;
+  case JsonNode::INTEGER:
+    appendInteger(out, node.valueInteger);
+    break;
+  case JsonNode::NIL:
+    out += "null";
+    break;
+  case JsonNode::OBJECT:
+    out += '{';
+    for (uint32_t i = 0; i < node.count; ++i) {
+      if (i != 0) {
+        out += ',';
+      }
+
+      const JsonNode::Member& member = node.members[i];
+      out += '"';
+      out.append(member.key.getData(), member.key.getSize());
+      out += "\":";
+      write(member.value, out);
+    }
+
+    out += '}';
+    break;
+  case JsonNode::REAL:
+    appendReal(out, node.valueReal);
+    break;
+  case JsonNode::STRING:
+    out += '"';
+    out.append(node.valueString, node.count);
+    out += '"';
+    break;
+  }
+}
+
+std::string JsonDocument::toString() const {
+  std::string out;
+  write(root, out);
+  return out;
+}
+
+void* JsonDocument::allocate(size_t size) {
+  size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+  if (size > remaining) {
+    size_t blockSize = std::max(size, MIN_BLOCK_SIZE);
+    blocks.emplace_back(new char[blockSize]);
+    current = blocks.back().get();
+    remaining = blockSize;
+  }
+
+  void* result = current;
+  current += size;
+  remaining -= size;
+  return result;
+}
+
+const char* JsonDocument::copyString(StringView value, uint32_t& size) {
+  if (value.getSize() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("JsonValue string is too long");
+  }
+
+  size = static_cast<uint32_t>(value.getSize());
+  if (size == 0) {
+    return "";
+  }
+
+  char* data = static_cast<char*>(allocate(size));
+  memcpy(data, value.getData(), size);
+  return data;
+}
+
+template<class T> T* JsonDocument::grow(T* data, uint32_t count, uint32_t& capacity) {
+  if (capacity > std::numeric_limits<uint32_t>::max() / 2) {
+    throw std::runtime_error("JsonValue container is too large");
+  }
+
+  // the old table stays in the arena until the document is released
+  uint32_t newCapacity = std::max(capacity * 2, MIN_CONTAINER_CAPACITY);
+  T* result = static_cast<T*>(allocate(sizeof(T) * newCapacity));
+  std::uninitialized_copy(data, data + count, result);
+  capacity = newCapacity;
+  return result;
+}
+
+void JsonDocument::parseValue(const char*& it, const char* end, JsonNode& node, std::vector<JsonNode>& items, std::vector<JsonNode::Member>& members, size_t depth) {
+  char c = readNonWsChar(it, end);
+  if ((c == '[' || c == '{') && depth == MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Unable to parse: nesting too deep");
+  }
+
+  if (c == '[') {
+    size_t first = items.size();
+    c = readNonWsChar(it, end);
+    if (c != ']') {
+      --it;
+      for (;;) {
+        JsonNode item;
+        parseValue(it, end, item, items, members, depth + 1);
+        items.push_back(item);
+        c = readNonWsChar(it, end);
+
+        if (c == ']') {
+          break;
+        }
+
+        if (c != ',') {
+          throw std::runtime_error("Unable to parse");
+        }
+      }
+    }
+
+    setArray(node);
+    node.count = node.capacity = static_cast<uint32_t>(items.size() - first);
+    if (node.count != 0) {
+      node.items = static_cast<JsonNode*>(allocate(sizeof(JsonNode) * node.count));
+      std::uninitialized_copy(items.begin() + first, items.end(), node.items);
+    }
+
+    items.resize(first);
+  } else if (c == '{') {
+    size_t first = members.size();
+    c = readNonWsChar(it, end);
+    if (c != '}') {
+      for (;;) {
+        if (c != '"') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        JsonNode::Member member{readStringToken(it, end), JsonNode()};
+        if (readNonWsChar(it, end) != ':') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        parseValue(it, end, member.value, items, members, depth + 1);
+        members.push_back(member);
+        c = readNonWsChar(it, end);
+
+        if (c == '}') {
+          break;
+        }
+
+        if (c != ',') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        c = readNonWsChar(it, end);
+      }
+    }
+
+    setObject(node);
+    node.count = node.capacity = static_cast<uint32_t>(members.size() - first);
+    if (node.count != 0) {
+      node.members = static_cast<JsonNode::Member*>(allocate(sizeof(JsonNode::Member) * node.count));
+      std::uninitialized_copy(members.begin() + first, members.end(), node.members);
+    }
+
+    members.resize(first);
+  } else if (c == '"') {
+    StringView value = readStringToken(it, end);
+    node = JsonNode();
+    node.type = JsonNode::STRING;
+    node.valueString = value.getData();
+    node.count = static_cast<uint32_t>(value.getSize());
+  } else if (c == 't') {
+    expectWord(it, end, "rue", 3);
+    setBool(node, true);
+  } else if (c == 'f') {
+    expectWord(it, end, "alse", 4);
+    setBool(node, false);
+  } else if (c == 'n') {
+    expectWord(it, end, "ull", 3);
+    setNil(node);
+  } else if (c == '-' || isDigit(c)) {
+    const char* begin = it - 1;
+    bool negative = c == '-';
+    const char* digits = negative ? it : begin;
+    while (it != end && isDigit(*it)) {
+      ++it;
+    }
+
+    if (digits == it || (it - digits > 1 && *digits == '0')) {
+      throw std::runtime_error("Unable to parse");
+    }
+
+    const char* digitsEnd = it;
+    bool real = false;
+    if (it != end && *it == '.') {
+      real = true;
+      ++it;
+      while (it != end && isDigit(*it)) {
+        ++it;
+      }
+    }
+
+    if (it != end && (*it == 'e' || *it == 'E')) {
+      real = true;
+      ++it;
+      if (it != end && (*it == '+' || *it == '-')) {
+        ++it;
+      }
+
+      if (it == end || !isDigit(*it)) {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      while (it != end && isDigit(*it)) {
+        ++it;
+      }
+    }
+
+    if (it != end && *it == '.') {
+      throw std::runtime_error("Unable to parse");
+    }
+
+    if (!real) {
+      uint64_t value = 0;
+      for (const char* d = digits; d != digitsEnd; ++d) {
+        uint64_t digit = static_cast<uint64_t>(*d - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+          real = true;
+          break;
+        }
+
+        value = value * 10 + digit;
+      }
+
+      if (negative && value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + 1) {
+        real = true;
+      }
+
+      if (!real) {
+        setInteger(node, static_cast<int64_t>(negative ? 0 - value : value));
+      }
+    }
+
+    if (real) {
+      setReal(node, strtod(std::string(begin, it).c_str(), nullptr));
+    }
+  } else {
+    throw std::runtime_error("Unable to parse");
+  }
+}
+
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "StringView.h"
+
+namespace Common {
+
+class JsonValue;
+
+// Flat JSON node. Items, members and strings live in the arena of the owning 'JsonDocument'.
+// Objects keep their members in insertion order. Strings are kept as raw JSON text, escape
+// sequences are not decoded, same as 'JsonValue'.
+class JsonNode {
+public:
+  enum Type : uint8_t {
+    ARRAY,
+    BOOL,
+    INTEGER,
+    NIL,
+    OBJECT,
+    REAL,
+    STRING
+  };
+
+  struct Member;
+
+  JsonNode() : type(NIL), count(0), capacity(0), valueInteger(0) {}
+
+  Type getType() const { return type; }
+  bool isArray() const { return type == ARRAY; }
+  bool isBool() const { return type == BOOL; }
+  bool isInteger() const { return type == INTEGER; }
+  bool isNil() const { return type == NIL; }
+  bool isObject() const { return type == OBJECT; }
+  bool isReal() const { return type == REAL; }
+  bool isString() const { return type == STRING; }
+
+  bool getBool() const;
+  int64_t getInteger() const;
+  double getReal() const;
+  StringView getString() const;
+
+  // Number of array items or object members
+  uint64_t size() const;
+
+  const JsonNode& operator[](uint64_t index) const;
+  const Member& getMember(uint64_t index) const;
+
+  // Returns nullptr if the object has no such member. Search starts at 'hint' and wraps around,
+  // so members read in stored order are found in constant time.
+  const JsonNode* find(StringView key, uint64_t hint = 0) const;
+  uint64_t findIndex(StringView key, uint64_t hint = 0) const;
+
+private:
+  friend class JsonDocument;
+
+  Type type;
+  // item or member count, string length for STRING nodes
+  uint32_t count;
+  uint32_t capacity;
+  union {
+    bool valueBool;
+    int64_t valueInteger;
+    double valueReal;
+    const char* valueString;
+    JsonNode* items;
+    Member* members;
+  };
+};
+
+struct JsonNode::Member {
+  StringView key;
+  JsonNode value;
+};
+
+// Owns a tree of 'JsonNode'. Nodes are allocated from an arena released with the document.
+// Node references stay valid until an item or member is added to the same container.
+class JsonDocument {
+public:
+  JsonDocument();
+  JsonDocument(const JsonDocument&) = delete;
+  JsonDocument(JsonDocument&& other);
+  ~JsonDocument();
+
+  JsonDocument& operator=(const JsonDocument&) = delete;
+  JsonDocument& operator=(JsonDocument&& other);
+
+  // Parses 'source' into the root node, throws std::runtime_error on malformed input or nesting deeper than 128.
+  // Integers above INT64_MAX up to UINT64_MAX keep their uint64_t bits, larger ones are parsed as REAL.
+  void parse(StringView source);
+
+  JsonNode& getRoot() { return root; }
+  const JsonNode& getRoot() const { return root; }
+
+  void setNil(JsonNode& node);
+  void setBool(JsonNode& node, bool value);
+  void setInteger(JsonNode& node, int64_t value);
+  void setReal(JsonNode& node, double value);
+  void setString(JsonNode& node, StringView value);
+  void setArray(JsonNode& node);
+  void setObject(JsonNode& node);
+
+  // Appends a NIL item to 'array'
+  JsonNode& pushBack(JsonNode& array);
+  // Appends a NIL member to 'object', keys are not checked for duplicates
+  JsonNode& insert(JsonNode& object, StringView key);
+  // Returns the existing member or appends a NIL one
+  JsonNode& set(JsonNode& object, StringView key);
+
+  void assign(JsonNode& node, const JsonValue& value);
+  void assign(JsonNode& node, const JsonNode& value);
+  static JsonValue toJsonValue(const JsonNode& node);
+
+  static void write(const JsonNode& node, std::string& out);
+  std::string toString() const;
+
+private:
+  JsonNode root;
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char* current;
+  size_t remaining;
+
+  void* allocate(size_t size);
+  const char* copyString(StringView value, uint32_t& size);
+  template<class T> T* grow(T* data, uint32_t count, uint32_t& capacity);
+
+  void parseValue(const char*& it, const char* end, JsonNode& node, std::vector<JsonNode>& items, std::vector<JsonNode::Member>& members, size_t depth);
+};
+
+}
@@ -16,7 +16,9 @@
 #include <shlobj.h>
 #include <strsafe.h>
 #else 
+#include <fcntl.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 #endif
 
 
@@ -348,6 +350,31 @@ std::string get_nix_version_display_string()
     return std::error_code(code, std::system_category());
   }
 
+  std::error_code sync_file(const std::string& name)
+  {
+    int code;
+#if defined(WIN32)
+    HANDLE file = ::CreateFile(name.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+      return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+    }
+
+    bool ok = 0 != ::FlushFileBuffers(file);
+    code = ok ? 0 : static_cast<int>(::GetLastError());
+    ::CloseHandle(file);
+#else
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return std::error_code(errno, std::system_category());
+    }
+
+    bool ok = 0 == ::fsync(fd);
+    code = ok ? 0 : errno;
+    ::close(fd);
+#endif
+    return std::error_code(code, std::system_category());
+  }
+
   bool directoryExists(const std::string& path) {
     boost::system::error_code ec;
     return boost::filesystem::is_directory(path, ec);
@@ -15,5 +15,7 @@ namespace Tools
   std::string get_os_version_string();
   bool create_directories_if_necessary(const std::string& path);
   std::error_code replace_file(const std::string& replacement_name, const std::string& replaced_name);
+  // flushes the file's written data to the disk
+  std::error_code sync_file(const std::string& name);
   bool directoryExists(const std::string& path);
 }
@@ -79,6 +79,8 @@ const uint64_t   CRYPTONOTE_OPTIMIZE_SIZE = 100; /* proportional to CRYPTONOTE_M
 
 const uint64_t CRYPTONOTE_MEMPOOL_TX_LIVETIME = (60 * 60 * 12); /* 12 hours in seconds */
 const uint64_t CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME = (60 * 60 * 24); /* 23 hours in seconds */
+const uint64_t CRYPTONOTE_MEMPOOL_MAX_SIZE = 256 * 1024 * 1024; /* bytes of transaction blobs kept in the pool */
+const uint64_t CRYPTONOTE_MEMPOOL_CHANGE_FEED_SIZE = 10000; /* pool additions and removals remembered for delta sync */
 const uint64_t CRYPTONOTE_NUMBER_OF_PERIODS_TO_FORGET_TX_DELETED_FROM_POOL  = 7; /* CRYPTONOTE_NUMBER_OF_PERIODS_TO_FORGET_TX_DELETED_FROM_POOL * CRYPTONOTE_MEMPOOL_TX_LIVETIME  = time to forget tx */
 
 const uint64_t   FUSION_TX_MAX_SIZE = CRYPTONOTE_MAX_TX_SIZE_LIMIT * 2;
@@ -100,6 +102,7 @@ const char     CRYPTONOTE_BLOCKS_FILENAME[]               = "blocks.dat";
 const char     CRYPTONOTE_BLOCKINDEXES_FILENAME[]         = "blockindexes.dat";
 const char     CRYPTONOTE_BLOCKSCACHE_FILENAME[]          = "blockscache.dat";
 const char     CRYPTONOTE_POOLDATA_FILENAME[]             = "poolstate.bin";
+const char     CRYPTONOTE_POOLJOURNAL_FILENAME[]          = "pooljournal.bin";
 const char     P2P_NET_DATA_FILENAME[]                    = "p2pstate.bin";
 const char     CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME[]   = "blockchainindices.dat";
 const char     MINER_CONFIG_FILE_NAME[]                   = "miner_conf.json";
@@ -129,11 +132,14 @@ const uint8_t  BLOCK_MINOR_VERSION_1 = 1;
 
 const uint64_t   BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT = 10000; // by default, blocks ids count in synchronizing
 const uint64_t   BLOCKS_SYNCHRONIZING_DEFAULT_COUNT = 128; // by default, blocks count in blocks downloading
+const uint64_t   BLOCK_HEADERS_SYNCHRONIZING_DEFAULT_COUNT = 2000; // by default, block headers count in headers-first synchronizing
+const uint64_t   BLOCKS_SYNCHRONIZING_BUFFER_MAX_COUNT = 2048; // block bodies downloaded ahead of the chain before no new spans are requested
+const uint64_t   BLOCKS_SYNCHRONIZING_SPAN_TIMEOUT = 120; // seconds a peer gets to deliver the block bodies it was asked for
 const uint64_t   COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT = 1000;
 
 /* P2P Network Configuration Section - This defines our current P2P network version
 and the minimum version for communication between nodes */
-const uint8_t  P2P_CURRENT_VERSION = 1;
+const uint8_t  P2P_CURRENT_VERSION = 2;
 const uint8_t  P2P_MINIMUM_VERSION = 1;
 const uint8_t  P2P_UPGRADE_WINDOW = 2;
 
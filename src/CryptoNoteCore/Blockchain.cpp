@@ -13,12 +13,17 @@
 #include <numeric>
 #include <cstdio>
 #include <cmath>
+#include <future>
+#include <thread>
+#include <unordered_set>
 #include <boost/foreach.hpp>
 #include "Common/Math.h"
 #include "Common/int-util.h"
+#include "Common/MemoryInputStream.h"
 #include "Common/ShuffleGenerator.h"
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
+#include "System/WorkerPool.h"
 #include "Rpc/CoreRpcServerCommandsDefinitions.h"
 #include "Serialization/BinarySerializationTools.h"
 #include "CryptoNoteTools.h"
@@ -394,6 +399,35 @@ bool Blockchain::checkTransactionInputs(const CryptoNote::Transaction& tx, Block
   return true;
 }
 
+bool Blockchain::checkVerifiedTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+  if (maxUsedBlock.height >= getCurrentBlockchainHeight() || getBlockIdByHeight(maxUsedBlock.height) != maxUsedBlock.id) {
+    // the chain was reorganized after the signatures were checked
+    maxUsedBlock.clear();
+    return checkTransactionInputs(tx, maxUsedBlock);
+  }
+
+  if (haveTransactionKeyImagesAsSpent(tx)) {
+    logger(DEBUGGING) << "Transaction " << getObjectHash(tx) << " spends a key image already spent in blockchain";
+    return false;
+  }
+
+  // multisignature inputs can be spent by any transaction, they are only checked with the chain locked
+  if (!isInCheckpointZone(getCurrentBlockchainHeight())) {
+    Crypto::Hash transactionHash = getObjectHash(tx);
+    Crypto::Hash prefixHash = getObjectHash(*static_cast<const TransactionPrefix*>(&tx));
+    for (size_t i = 0; i < tx.inputs.size(); ++i) {
+      if (tx.inputs[i].type() == typeid(MultisignatureInput) &&
+          !validateInput(::boost::get<MultisignatureInput>(tx.inputs[i]), transactionHash, prefixHash, tx.signatures[i])) {
+        return false;
+      }
+    }
+  }
+
+  return check_tx_outputs(tx);
+}
+
 bool Blockchain::haveSpentKeyImages(const CryptoNote::Transaction& tx) {
   return this->haveTransactionKeyImagesAsSpent(tx);
 }
@@ -647,6 +681,7 @@ bool Blockchain::resetAndSetGenesisBlock(const Block& b) {
   m_spent_keys.clear();
   m_alternative_chains.clear();
   m_outputs.clear();
+  m_blockUndos.clear();
 
   m_paymentIdIndex.clear();
   m_timestampIndex.clear();
@@ -813,19 +848,19 @@ uint8_t Blockchain::get_block_major_version_for_height(uint64_t height) const {
   }
 }
 
-bool Blockchain::rollback_blockchain_switching(std::list<Block> &original_chain, uint64_t rollback_height) {
+bool Blockchain::rollback_blockchain_switching(std::list<std::pair<Block, difficulty_type>> &original_chain, uint64_t rollback_height) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   // remove failed subchain
   for (uint64_t i = m_blocks.size() - 1; i >= rollback_height; i--) {
-    popBlock(get_block_hash(m_blocks.back().bl));
+    popBlock();
   }
 
   uint32_t height = static_cast<uint32_t>(rollback_height - 1);
 
-  // return back original chain
+  // return back original chain, it was validated in this very state
   for (auto &bl : original_chain) {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    bool r = pushBlock(bl, get_block_hash(bl), bvc, ++height);
+    bool r = pushBlock(bl.first, get_block_hash(bl.first), bvc, ++height, bl.second);
 
     if (!(r && bvc.m_added_to_main_chain)) {
       logger(ERROR, BRIGHT_RED) << "PANIC!!! failed to add (again) block while "
@@ -856,45 +891,38 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   }  
 
   // Compare transactions in proposed alt chain vs current main chain and reject if some transaction is missing in the alt chain
-  std::vector<Crypto::Hash> mainChainTxHashes, altChainTxHashes;
-  for (uint64_t i = m_blocks.size() - 1; i >= split_height; i--) {
-    Block b = m_blocks[i].bl;
-    std::copy(b.transactionHashes.begin(), b.transactionHashes.end(), std::inserter(mainChainTxHashes, mainChainTxHashes.end()));
-  }
+  std::unordered_set<Crypto::Hash> altChainTxHashes;
   for (auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++) {
-    auto ch_ent = *alt_ch_iter;
-    Block b = ch_ent->second.bl;
-    std::copy(b.transactionHashes.begin(), b.transactionHashes.end(), std::inserter(altChainTxHashes, altChainTxHashes.end()));
-  }
-  for (auto main_ch_it = mainChainTxHashes.begin(); main_ch_it != mainChainTxHashes.end(); main_ch_it++) {
-    auto tx_hash = *main_ch_it;
-    if (std::find(altChainTxHashes.begin(), altChainTxHashes.end(), tx_hash) == altChainTxHashes.end()) {
-      logger(ERROR, BRIGHT_RED) << "Attempting to switch to an alternate chain, but it lacks transaction " << Common::podToHex(tx_hash) << " from main chain, rejected";
-      mainChainTxHashes.clear();
-      mainChainTxHashes.shrink_to_fit();
-      altChainTxHashes.clear();
-      altChainTxHashes.shrink_to_fit();
-      return false;
+    const Block& b = (*alt_ch_iter)->second.bl;
+    altChainTxHashes.insert(b.transactionHashes.begin(), b.transactionHashes.end());
+  }
+  for (uint64_t i = m_blocks.size() - 1; i >= split_height; i--) {
+    for (const auto& tx_hash : m_blocks[i].bl.transactionHashes) {
+      if (altChainTxHashes.count(tx_hash) == 0) {
+        logger(ERROR, BRIGHT_RED) << "Attempting to switch to an alternate chain, but it lacks transaction " << Common::podToHex(tx_hash) << " from main chain, rejected";
+        return false;
+      }
     }
   }
 
-
-  //disconnecting old chain
-  std::list<Block> disconnected_chain;
+  //disconnecting old chain, keeping the difficulty each block's proof of work was checked against
+  std::list<std::pair<Block, difficulty_type>> disconnected_chain;
   for (uint64_t i = m_blocks.size() - 1; i >= split_height; i--) {
-    Block b = m_blocks[i].bl;
-    popBlock(get_block_hash(b));
-    //if (!(r)) { logger(ERROR, BRIGHT_RED) << "failed to remove block on chain switching"; return false; }
-    disconnected_chain.push_front(b);
+    difficulty_type difficulty = m_blocks[i].cumulative_difficulty - m_blocks[i - 1].cumulative_difficulty;
+    disconnected_chain.emplace_front(m_blocks[i].bl, difficulty);
+    popBlock();
   }
 
   uint32_t height = static_cast<uint32_t>(split_height - 1);
+  difficulty_type previousCumulativeDifficulty = m_blocks.back().cumulative_difficulty;
 
-  //connecting new alternative chain
+  //connecting new alternative chain, its proof of work was checked by handle_alternative_block
   for (auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++) {
     auto ch_ent = *alt_ch_iter;
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    bool r = pushBlock(ch_ent->second.bl, get_block_hash(ch_ent->second.bl), bvc, ++height);
+    difficulty_type checkedDifficulty = ch_ent->second.cumulative_difficulty - previousCumulativeDifficulty;
+    previousCumulativeDifficulty = ch_ent->second.cumulative_difficulty;
+    bool r = pushBlock(ch_ent->second.bl, get_block_hash(ch_ent->second.bl), bvc, ++height, checkedDifficulty);
     if (!r || !bvc.m_added_to_main_chain) {
       logger(DEBUGGING) << "Failed to switch to alternative blockchain";
       std::cout << BrightRedMsg("Failed to switch to alternative Blockchain.") << std::endl;
@@ -923,7 +951,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
     //pushing old chain as alternative chain
     for (auto& old_ch_ent : disconnected_chain) {
       block_verification_context bvc = boost::value_initialized<block_verification_context>();
-      bool r = handle_alternative_block(old_ch_ent, get_block_hash(old_ch_ent), bvc, false);
+      bool r = handle_alternative_block(old_ch_ent.first, get_block_hash(old_ch_ent.first), bvc, false, old_ch_ent.second);
       if (!r) {
         logger(ERROR, BRIGHT_RED) << ("Failed to push ex-main chain blocks to alternative chain ");
         rollback_blockchain_switching(disconnected_chain, split_height);
@@ -1178,7 +1206,7 @@ bool Blockchain::complete_timestamps_vector(uint64_t start_top_height, std::vect
   return true;
 }
 
-bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id, block_verification_context& bvc, bool sendNewAlternativeBlockMessage) {
+bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id, block_verification_context& bvc, bool sendNewAlternativeBlockMessage, difficulty_type checkedDifficulty) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   auto block_height = get_block_height(b);
@@ -1295,12 +1323,12 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
       return false;
     }
 
-    // Always check PoW for alternative blocks
+    // Always check PoW for alternative blocks, unless it was checked at this difficulty while the block was in the main chain
     m_is_in_checkpoint_zone = false;
     difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     if (!(current_diff)) { logger(ERROR, BRIGHT_RED) << "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!"; return false; }
     Crypto::Hash proof_of_work = NULL_HASH;
-    if (!m_currency.checkProofOfWork(m_cn_context, bei.bl, current_diff, proof_of_work)) {
+    if (current_diff != checkedDifficulty && !m_currency.checkProofOfWork(m_cn_context, bei.bl, current_diff, proof_of_work)) {
       logger(DEBUGGING) <<
         "Block with id: " << id
         << ENDL << " for alternative chain, have not enough proof of work: " << proof_of_work
@@ -1444,25 +1472,94 @@ bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Bloc
   return true;
 }
 
+bool Blockchain::getRawBlock(uint32_t height, Block& block, block_complete_entry& rawBlock) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (height >= m_blocks.size()) {
+    return false;
+  }
+
+  // blocks near the tip are usually cached, encoding them is cheaper than reading the file
+  const BlockEntry* cached = m_blocks.findCached(height);
+  if (cached != nullptr) {
+    block = cached->bl;
+    rawBlock.block = asString(toBinaryArray(cached->bl));
+    rawBlock.txs.clear();
+    rawBlock.txs.reserve(cached->transactions.size() > 0 ? cached->transactions.size() - 1 : 0);
+    for (size_t i = 1; i < cached->transactions.size(); ++i) {
+      rawBlock.txs.push_back(asString(toBinaryArray(cached->transactions[i].tx)));
+    }
+
+    return true;
+  }
+
+  BinaryArray blob;
+  if (!m_blocks.readRaw(height, blob)) {
+    logger(ERROR, BRIGHT_RED) << "Failed to read block " << height << " from the blockchain file";
+    return false;
+  }
+
+  // The stored entry has no length prefixes, so the boundaries are found by walking it
+  // in the order of BlockEntry::serialize; the bytes themselves are copied as stored.
+  Common::MemoryInputStream stream(blob.data(), blob.size());
+  BinaryInputStreamSerializer archive(stream);
+  auto copyRange = [&blob](uint64_t begin, uint64_t end) {
+    return std::string(reinterpret_cast<const char*>(blob.data()) + begin, end - begin);
+  };
+
+  archive(block, "block");
+  rawBlock.block = copyRange(0, stream.getPosition());
+
+  uint32_t blockHeight;
+  uint64_t cumulativeSize;
+  difficulty_type cumulativeDifficulty;
+  uint64_t generatedCoins;
+  archive(blockHeight, "height");
+  archive(cumulativeSize, "block_cumulative_size");
+  archive(cumulativeDifficulty, "cumulative_difficulty");
+  archive(generatedCoins, "already_generated_coins");
+
+  uint64_t transactionCount;
+  archive.beginArray(transactionCount, "transactions");
+  rawBlock.txs.clear();
+  rawBlock.txs.reserve(transactionCount > 0 ? transactionCount - 1 : 0);
+  for (uint64_t i = 0; i < transactionCount; ++i) {
+    TransactionEntry transaction;
+    uint64_t begin = stream.getPosition();
+    archive(transaction.tx, "tx");
+    // the first entry is the miner transaction, which is already part of the block blob
+    if (i != 0) {
+      rawBlock.txs.push_back(copyRange(begin, stream.getPosition()));
+    }
+
+    archive(transaction.m_global_output_indexes, "indexes");
+  }
+
+  archive.endArray();
+  return true;
+}
+
+bool Blockchain::getRawBlock(const Crypto::Hash& blockId, Block& block, block_complete_entry& rawBlock) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  uint32_t height;
+  if (!m_blockIndex.getBlockHeight(blockId, height)) {
+    return false;
+  }
+
+  return getRawBlock(height, block, rawBlock);
+}
+
 bool Blockchain::handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) { //Deprecated. Should be removed with CryptoNoteProtocolHandler.
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   rsp.current_blockchain_height = getCurrentBlockchainHeight();
-  std::list<Block> blocks;
-  getBlocks(arg.blocks, blocks, rsp.missed_ids);
-
-  for (const auto& bl : blocks) {
-    std::list<Crypto::Hash> missed_tx_id;
-    std::list<Transaction> txs;
-    getTransactions(bl.transactionHashes, txs, rsp.missed_ids);
-    if (!(!missed_tx_id.size())) { logger(ERROR, BRIGHT_RED) << "Internal error: have missed missed_tx_id.size()=" << missed_tx_id.size() << ENDL << "for block id = " << get_block_hash(bl); return false; } //WTF???
-    rsp.blocks.push_back(block_complete_entry());
-    block_complete_entry& e = rsp.blocks.back();
-    //pack block
-    e.block = asString(toBinaryArray(bl));
-    //pack transactions
-    for (Transaction& tx : txs) {
-      e.txs.push_back(asString(toBinaryArray(tx)));
+  for (const auto& blockId : arg.blocks) {
+    Block block;
+    block_complete_entry rawBlock;
+    if (!getRawBlock(blockId, block, rawBlock)) {
+      rsp.missed_ids.push_back(blockId);
+      continue;
     }
+
+    rsp.blocks.push_back(std::move(rawBlock));
   }
 
   //get another transactions, if need
@@ -1679,6 +1776,154 @@ std::vector<Crypto::Hash> Blockchain::findBlockchainSupplement(const std::vector
   return m_blockIndex.getBlockIds(startBlockIndex, static_cast<uint32_t>(maxCount));
 }
 
+uint64_t Blockchain::headerChainWindowSize() const {
+  return std::max({ m_currency.difficultyBlocksCount(), m_currency.difficultyBlocksCount2(), static_cast<uint64_t>(m_currency.timestampCheckWindow()) });
+}
+
+bool Blockchain::getBlockHeaderChainTail(const Crypto::Hash& blockId, BlockHeaderChainTail& tail) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  uint32_t height;
+  if (!m_blockIndex.getBlockHeight(blockId, height)) {
+    return false;
+  }
+
+  tail.height = height;
+  tail.id = blockId;
+  tail.timestamps.clear();
+  tail.cumulativeDifficulties.clear();
+  tail.genesisTimestamp = m_blocks[0].bl.timestamp;
+
+  // genesis block never takes part in difficulty calculation
+  uint64_t offset = height + 1 - std::min(static_cast<uint64_t>(height + 1), headerChainWindowSize());
+  if (offset == 0) {
+    ++offset;
+  }
+
+  for (; offset <= height; ++offset) {
+    tail.timestamps.push_back(m_blocks[offset].bl.timestamp);
+    tail.cumulativeDifficulties.push_back(m_blocks[offset].cumulative_difficulty);
+  }
+
+  return true;
+}
+
+bool Blockchain::checkBlockHeaders(const std::vector<BinaryArray>& hashingBlobs, BlockHeaderChainTail& tail, std::vector<Crypto::Hash>& blockIds) {
+  struct PowCheck {
+    uint64_t index;
+    difficulty_type difficulty;
+  };
+
+  std::vector<BlockHeader> headers(hashingBlobs.size());
+  blockIds.resize(hashingBlobs.size());
+  std::vector<PowCheck> powChecks;
+
+  BlockHeaderChainTail newTail = tail;
+  const uint64_t windowSize = headerChainWindowSize();
+
+  // versions and checkpoints come from the chain, only the proof of work below runs without the lock
+  std::unique_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  for (uint64_t i = 0; i < hashingBlobs.size(); ++i) {
+    BlockHeader& header = headers[i];
+    if (!get_block_header_from_hashing_blob(hashingBlobs[i], header)) {
+      logger(DEBUGGING) << "Failed to parse block header at height " << newTail.height + 1;
+      return false;
+    }
+
+    getObjectHash(hashingBlobs[i], blockIds[i]);
+    const Crypto::Hash& id = blockIds[i];
+    uint32_t height = newTail.height + 1;
+
+    if (header.previousBlockHash != newTail.id) {
+      logger(DEBUGGING) << "Block header " << id << " doesn't link to previous header " << newTail.id;
+      return false;
+    }
+
+    if (header.majorVersion != get_block_major_version_for_height(height)) {
+      logger(DEBUGGING) << "Block header " << id << " has wrong major version " << static_cast<int>(header.majorVersion) << " at height " << height;
+      return false;
+    }
+
+    if (header.timestamp > get_adjusted_time() + m_currency.blockFutureTimeLimit()) {
+      logger(DEBUGGING) << "Block header " << id << " has timestamp too far in the future: " << header.timestamp;
+      return false;
+    }
+
+    // same window as check_block_timestamp_main, which includes the genesis block
+    std::vector<uint64_t> medianTimestamps(newTail.timestamps.end() - std::min<uint64_t>(newTail.timestamps.size(), m_currency.timestampCheckWindow()), newTail.timestamps.end());
+    if (medianTimestamps.size() < m_currency.timestampCheckWindow() && height == newTail.timestamps.size() + 1) {
+      medianTimestamps.insert(medianTimestamps.begin(), newTail.genesisTimestamp);
+    }
+
+    if (medianTimestamps.size() >= m_currency.timestampCheckWindow()) {
+      if (header.timestamp < Common::medianValue(medianTimestamps)) {
+        logger(DEBUGGING) << "Block header " << id << " has timestamp below median: " << header.timestamp;
+        return false;
+      }
+    }
+
+    // same window as getDifficultyForNextBlock would use once the chain reaches this height
+    uint64_t difficultyCount = std::min(static_cast<uint64_t>(newTail.timestamps.size()), m_currency.difficultyBlocksCountByBlockVersion(getBlockMajorVersionForHeight(height)));
+    std::vector<uint64_t> timestamps(newTail.timestamps.end() - difficultyCount, newTail.timestamps.end());
+    std::vector<difficulty_type> cumulativeDifficulties(newTail.cumulativeDifficulties.end() - difficultyCount, newTail.cumulativeDifficulties.end());
+    difficulty_type difficulty = get_block_major_version_for_height(height + 1) >= 3 ?
+      m_currency.nextDifficultyLWMA3(timestamps, cumulativeDifficulties) :
+      m_currency.nextDifficulty(timestamps, cumulativeDifficulties);
+    if (difficulty == 0) {
+      logger(ERROR, BRIGHT_RED) << "!!!!!!!!! difficulty overhead !!!!!!!!!";
+      return false;
+    }
+
+    if (m_checkpoints.is_in_checkpoint_zone(height)) {
+      if (!m_checkpoints.check_block(height, id)) {
+        return false;
+      }
+    } else {
+      powChecks.push_back({ i, difficulty });
+    }
+
+    newTail.height = height;
+    newTail.id = id;
+    newTail.timestamps.push_back(header.timestamp);
+    newTail.cumulativeDifficulties.push_back((newTail.cumulativeDifficulties.empty() ? 0 : newTail.cumulativeDifficulties.back()) + difficulty);
+    if (newTail.timestamps.size() > windowSize) {
+      newTail.timestamps.erase(newTail.timestamps.begin());
+      newTail.cumulativeDifficulties.erase(newTail.cumulativeDifficulties.begin());
+    }
+  }
+
+  lk.unlock();
+
+  // proof of work is independent for every header, spread it over all cores
+  uint64_t workers = std::min(static_cast<uint64_t>(std::max(std::thread::hardware_concurrency(), 1u)), static_cast<uint64_t>(powChecks.size()));
+  std::atomic<uint64_t> nextCheck(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::future<void>> results;
+  for (uint64_t w = 0; w < workers; ++w) {
+    results.push_back(std::async(std::launch::async, [&] {
+      Crypto::cn_context context;
+      for (uint64_t c = nextCheck++; c < powChecks.size() && !failed; c = nextCheck++) {
+        const PowCheck& check = powChecks[c];
+        Crypto::Hash proofOfWork;
+        if (!get_block_longhash(context, headers[check.index].majorVersion, hashingBlobs[check.index], proofOfWork) || !check_hash(proofOfWork, check.difficulty)) {
+          logger(DEBUGGING) << "Block header " << blockIds[check.index] << " has too weak proof of work: " << proofOfWork << ", expected difficulty: " << check.difficulty;
+          failed = true;
+        }
+      }
+    }));
+  }
+
+  for (auto& result : results) {
+    result.wait();
+  }
+
+  if (failed) {
+    return false;
+  }
+
+  tail = std::move(newTail);
+  return true;
+}
+
 bool Blockchain::haveBlock(const Crypto::Hash& id) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blockIndex.hasBlock(id))
@@ -1744,6 +1989,13 @@ bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t& max_use
 
   bool res = checkTransactionInputs(tx, &max_used_block_height);
   if (!res) return false;
+  if (isInCheckpointZone(getCurrentBlockchainHeight())) {
+    // ring signatures were not checked, an empty block keeps the transaction from being treated as verified
+    max_used_block_height = 0;
+    max_used_block_id = NULL_HASH;
+    return true;
+  }
+
   if (!(max_used_block_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_blocks.size(); return false; }
   get_block_hash(m_blocks[max_used_block_height].bl, max_used_block_id);
   return true;
@@ -1761,12 +2013,12 @@ bool Blockchain::haveTransactionKeyImagesAsSpent(const Transaction &tx) {
   return false;
 }
 
-bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height) {
+bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height, bool checkSignatures) {
   Crypto::Hash tx_prefix_hash = getObjectHash(*static_cast<const TransactionPrefix*>(&tx));
-  return checkTransactionInputs(tx, tx_prefix_hash, pmax_used_block_height);
+  return checkTransactionInputs(tx, tx_prefix_hash, pmax_used_block_height, checkSignatures);
 }
 
-bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height) {
+bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height, bool checkSignatures) {
   uint64_t inputIndex = 0;
   if (pmax_used_block_height) {
     *pmax_used_block_height = 0;
@@ -1786,7 +2038,7 @@ bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Has
       }
 
       if (!isInCheckpointZone(getCurrentBlockchainHeight())) {
-        if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height)) {
+        if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height, checkSignatures)) {
           logger(DEBUGGING) << "Failed to check input in transaction " << transactionHash;
 
           std::cout << BrightRedMsg("Failed to check input in transaction ") << transactionHash << std::endl;
@@ -1834,7 +2086,7 @@ bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time) {
   return false;
 }
 
-bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height) {
+bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height, bool checkSignature) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   struct outputs_visitor {
@@ -1898,7 +2150,7 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
   } */
 
   if (!(sig.size() == output_keys.size())) { logger(ERROR, BRIGHT_RED) << "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size(); return false; }
-  if (isInCheckpointZone(getCurrentBlockchainHeight())) {
+  if (!checkSignature || isInCheckpointZone(getCurrentBlockchainHeight())) {
     return true;
   }
 
@@ -1911,6 +2163,122 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
   return Crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_keys, sig.data());
 }
 
+bool Blockchain::snapshotTransactionInputs(const Transaction& tx, TransactionInputsSnapshot& snapshot) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+  struct KeysCollector {
+    std::vector<Crypto::PublicKey>& keys;
+    Blockchain& blockchain;
+
+    bool handle_output(const Transaction& tx, const TransactionOutput& out, uint64_t transactionOutputIndex) {
+      if (!blockchain.is_tx_spendtime_unlocked(tx.unlockTime) || out.target.type() != typeid(KeyOutput)) {
+        return false;
+      }
+
+      keys.push_back(boost::get<KeyOutput>(out.target).key);
+      return true;
+    }
+  };
+
+  snapshot.checkSignatures = !isInCheckpointZone(getCurrentBlockchainHeight());
+  snapshot.outputKeys.clear();
+  snapshot.maxUsedBlock.clear();
+
+  if (tx.signatures.size() != tx.inputs.size()) {
+    logger(DEBUGGING) << "Transaction " << getObjectHash(tx) << " has " << tx.signatures.size() << " signature sets for " << tx.inputs.size() << " inputs";
+    return false;
+  }
+
+  uint32_t maxUsedBlockHeight = 0;
+  for (size_t i = 0; i < tx.inputs.size(); ++i) {
+    if (tx.inputs[i].type() != typeid(KeyInput)) {
+      continue;
+    }
+
+    const KeyInput& input = boost::get<KeyInput>(tx.inputs[i]);
+    if (input.outputIndexes.empty() || have_tx_keyimg_as_spent(input.keyImage)) {
+      logger(DEBUGGING) << "Transaction " << getObjectHash(tx) << " has an empty ring or a key image already spent in blockchain";
+      return false;
+    }
+
+    snapshot.outputKeys.emplace_back();
+    if (!snapshot.checkSignatures) {
+      continue;
+    }
+
+    KeysCollector collector{ snapshot.outputKeys.back(), *this };
+    if (!scanOutputKeysForIndexes(input, collector, &maxUsedBlockHeight) ||
+        collector.keys.size() != input.outputIndexes.size() ||
+        tx.signatures[i].size() != collector.keys.size()) {
+      logger(DEBUGGING) << "Failed to get output keys for input " << i << " of transaction " << getObjectHash(tx);
+      return false;
+    }
+  }
+
+  // maxUsedBlock stays empty when the signatures are not going to be checked
+  if (snapshot.checkSignatures) {
+    snapshot.maxUsedBlock.height = maxUsedBlockHeight;
+    snapshot.maxUsedBlock.id = getBlockIdByHeight(maxUsedBlockHeight);
+  }
+
+  return true;
+}
+
+bool Blockchain::checkTransactionSignatures(const Transaction& tx, const TransactionInputsSnapshot& snapshot, System::WorkerPool* pool) {
+  if (!snapshot.checkSignatures) {
+    return true;
+  }
+
+  struct SignatureCheck {
+    const KeyInput* input;
+    const std::vector<Crypto::PublicKey>* keys;
+    const std::vector<Crypto::Signature>* signatures;
+  };
+
+  std::vector<SignatureCheck> checks;
+  for (size_t i = 0; i < tx.inputs.size(); ++i) {
+    if (tx.inputs[i].type() == typeid(KeyInput)) {
+      checks.push_back({ &boost::get<KeyInput>(tx.inputs[i]), &snapshot.outputKeys[checks.size()], &tx.signatures[i] });
+    }
+  }
+
+  static const Crypto::KeyImage I = { {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } };
+  static const Crypto::KeyImage L = { {0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 } };
+
+  Crypto::Hash prefixHash = getObjectHash(*static_cast<const TransactionPrefix*>(&tx));
+  std::atomic<uint64_t> nextCheck(0);
+  std::atomic<bool> failed(false);
+  auto worker = [&] {
+    for (uint64_t c = nextCheck++; c < checks.size() && !failed; c = nextCheck++) {
+      const SignatureCheck& check = checks[c];
+      std::vector<const Crypto::PublicKey*> keys;
+      for (const auto& key : *check.keys) {
+        keys.push_back(&key);
+      }
+
+      if (!(scalarmultKey(check.input->keyImage, L) == I) ||
+          !Crypto::check_ring_signature(prefixHash, check.input->keyImage, keys, check.signatures->data())) {
+        failed = true;
+      }
+    }
+  };
+
+  // ring signatures are independent for every input, spread them over the pool threads
+  if (pool != nullptr) {
+    size_t workers = std::min(pool->getThreadCount(), checks.size());
+    pool->execute(std::vector<std::function<void()>>(workers, worker));
+  } else {
+    worker();
+  }
+
+  if (failed) {
+    logger(DEBUGGING) << "Transaction " << getObjectHash(tx) << " has an invalid ring signature";
+    return false;
+  }
+
+  return true;
+}
+
 uint64_t Blockchain::get_adjusted_time() {
   //TODO: add collecting median time
   return time(NULL);
@@ -2097,22 +2465,23 @@ const Blockchain::TransactionEntry& Blockchain::transactionByIndex(TransactionIn
   return m_blocks[index.block].transactions[index.transaction];
 }
 
-bool Blockchain::pushBlock(const Block& blockData, const Crypto::Hash& id, block_verification_context& bvc, uint32_t height) {
+bool Blockchain::pushBlock(const Block& blockData, const Crypto::Hash& id, block_verification_context& bvc, uint32_t height, difficulty_type checkedDifficulty) {
   std::vector<Transaction> transactions;
-  if (!loadTransactions(blockData, transactions, height)) {
+  std::vector<BlockInfo> verifiedInputs;
+  if (!loadTransactions(blockData, transactions, verifiedInputs, height)) {
     bvc.m_verification_failed = true;
     return false;
   }
 
-  if (!pushBlock(blockData, transactions, id, bvc)) {
-    saveTransactions(transactions, height);
+  if (!pushBlock(blockData, transactions, verifiedInputs, id, bvc, checkedDifficulty)) {
+    saveTransactions(transactions, height, &verifiedInputs);
     return false;
   }
 
   return true;
 }
 
-bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction>& transactions, const Crypto::Hash& id, block_verification_context& bvc) {
+bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction>& transactions, const std::vector<BlockInfo>& verifiedInputs, const Crypto::Hash& id, block_verification_context& bvc, difficulty_type checkedDifficulty) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   auto blockProcessingStart = std::chrono::steady_clock::now();
@@ -2179,7 +2548,7 @@ bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction
       bvc.m_verification_failed = true;
       return false;
     }
-  } else {
+  } else if (currentDifficulty != checkedDifficulty) {
     if (!m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work)) {
       logger(DEBUGGING) << "Block " << blockHash << ", has too weak proof of work: "
                                  << Common::podToHex(proof_of_work) << ", expected difficulty: "
@@ -2207,6 +2576,9 @@ bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction
   BlockEntry block;
   block.bl = blockData;
   block.height = static_cast<uint32_t>(m_blocks.size());
+  BlockUndo undo;
+  undo.blockHash = blockHash;
+  undo.minerTransactionHash = minerTransactionHash;
   block.transactions.resize(1);
   block.transactions[0].tx = blockData.baseTransaction;
   TransactionIndex transactionIndex = { block.height, static_cast<uint16_t>(0) };
@@ -2236,7 +2608,10 @@ bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction
                 << BrightYellowMsg("(") << BrightYellowMsg(std::to_string(transactions[i].version))<< BrightYellowMsg(")") << std::endl;
     }
 
-    if (!checkTransactionInputs(transactions[i])) {
+    // the pool checked the ring signatures against outputs that are still in the chain
+    bool signaturesVerified = checkedDifficulty != 0 && isVerifiedInMainChain(verifiedInputs[i]);
+    uint32_t maxUsedBlockHeight = 0;
+    if (!checkTransactionInputs(transactions[i], &maxUsedBlockHeight, !signaturesVerified)) {
       isTransactionValid = false;
       logger(DEBUGGING) << "Block " << blockHash << " has at least one transaction with wrong inputs: " << tx_id;
       std::cout << BrightRedMsg("Block ") << blockHash << BrightRedMsg(" has at least one transaction with the wrong inputs. ") << std::endl
@@ -2260,6 +2635,12 @@ bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction
       return false;
     }
 
+    undo.verifiedInputs.emplace_back();
+    if (!isInCheckpointZone(getCurrentBlockchainHeight())) {
+      undo.verifiedInputs.back().height = maxUsedBlockHeight;
+      undo.verifiedInputs.back().id = getBlockIdByHeight(maxUsedBlockHeight);
+    }
+
     ++transactionIndex.transaction;
     pushTransaction(block, tx_id, transactionIndex);
 
@@ -2292,7 +2673,7 @@ bool Blockchain::pushBlock(const Block& blockData, const std::vector<Transaction
     block.cumulative_difficulty += m_blocks.back().cumulative_difficulty;
   }
 
-  pushBlock(block);
+  pushBlock(block, undo);
   pushToDepositIndex(block, interestSummary);
 
   auto block_processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - blockProcessingStart).count();
@@ -2353,8 +2734,32 @@ void Blockchain::pushToDepositIndex(const BlockEntry& block, uint64_t interest)
 }
 
 
-bool Blockchain::pushBlock(BlockEntry& block) {
-  Crypto::Hash blockHash = get_block_hash(block.bl);
+bool Blockchain::pushBlock(BlockEntry& block, BlockUndo& undo) {
+  const Crypto::Hash& blockHash = undo.blockHash;
+
+  for (const auto& transaction : block.transactions) {
+    for (const auto& input : transaction.tx.inputs) {
+      if (input.type() == typeid(KeyInput)) {
+        undo.spentKeyImages.push_back(::boost::get<KeyInput>(input).keyImage);
+      } else if (input.type() == typeid(MultisignatureInput)) {
+        const MultisignatureInput& in = ::boost::get<MultisignatureInput>(input);
+        undo.usedMultisignatureOutputs.push_back(std::make_pair(in.amount, in.outputIndex));
+      }
+    }
+
+    for (const auto& output : transaction.tx.outputs) {
+      if (output.target.type() == typeid(KeyOutput)) {
+        undo.keyOutputAmounts.push_back(output.amount);
+      } else if (output.target.type() == typeid(MultisignatureOutput)) {
+        undo.multisignatureOutputAmounts.push_back(output.amount);
+      }
+    }
+  }
+
+  m_blockUndos.push_back(std::move(undo));
+  if (m_blockUndos.size() > CryptoNote::parameters::CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW) {
+    m_blockUndos.pop_front();
+  }
 
   m_blocks.push_back(block);
   m_blockIndex.push(blockHash);
@@ -2364,10 +2769,12 @@ bool Blockchain::pushBlock(BlockEntry& block) {
 
   assert(m_blockIndex.size() == m_blocks.size());
 
+  m_tx_pool.on_blockchain_inc(m_blocks.size(), blockHash);
+
   return true;
 }
 
-void Blockchain::popBlock(const Crypto::Hash& blockHash) {
+void Blockchain::popBlock() {
   if (m_blocks.empty()) {
     logger(ERROR, BRIGHT_RED) <<
       "Attempt to pop block from empty blockchain.";
@@ -2375,15 +2782,23 @@ void Blockchain::popBlock(const Crypto::Hash& blockHash) {
     return;
   }
 
+  Crypto::Hash blockHash = getTailId();
   std::vector<Transaction> transactions(m_blocks.back().transactions.size() - 1);
   for (uint64_t i = 0; i < m_blocks.back().transactions.size() - 1; ++i) {
     transactions[i] = m_blocks.back().transactions[1 + i].tx;
   }
 
   uint32_t height = m_blocks.size(); //height of popped block should be same as number of blocks
-  saveTransactions(transactions, height);
-
-  popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
+  if (!m_blockUndos.empty() && m_blockUndos.back().blockHash == blockHash) {
+    saveTransactions(transactions, height, &m_blockUndos.back().verifiedInputs);
+    popTransactions(m_blocks.back(), m_blockUndos.back());
+    m_blockUndos.pop_back();
+  } else {
+    // blocks loaded from disk or pushed before the records that are kept
+    m_blockUndos.clear();
+    saveTransactions(transactions, height);
+    popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
+  }
 
   m_timestampIndex.remove(m_blocks.back().bl.timestamp, blockHash);
   m_generatedTransactionsIndex.remove(m_blocks.back().bl);
@@ -2396,6 +2811,8 @@ void Blockchain::popBlock(const Crypto::Hash& blockHash) {
 
   m_upgradeDetectorV2.blockPopped();
   m_upgradeDetectorV3.blockPopped();
+
+  m_tx_pool.on_blockchain_dec(m_blocks.size(), getTailId());
 }
 
 bool Blockchain::pushTransaction(BlockEntry& block, const Crypto::Hash& transactionHash, TransactionIndex transactionIndex) {
@@ -2579,6 +2996,104 @@ void Blockchain::popTransactions(const BlockEntry& block, const Crypto::Hash& mi
   popTransaction(block.bl.baseTransaction, minerTransactionHash);
 }
 
+void Blockchain::popTransactions(const BlockEntry& block, const BlockUndo& undo) {
+  // the record is only valid for the tail block it was written for
+  assert(undo.blockHash == getTailId());
+  uint32_t blockIndex = static_cast<uint32_t>(m_blocks.size() - 1);
+
+  // inputs first, the block may spend multisignature outputs it creates
+  for (const auto& output : undo.usedMultisignatureOutputs) {
+    auto amountOutputs = m_multisignatureOutputs.find(output.first);
+    if (amountOutputs == m_multisignatureOutputs.end() || output.second >= amountOutputs->second.size() || !amountOutputs->second[output.second].isUsed) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - multisignature output not marked as used.";
+
+      continue;
+    }
+
+    amountOutputs->second[output.second].isUsed = false;
+  }
+
+  for (const auto& keyImage : undo.spentKeyImages) {
+    uint64_t count = m_spent_keys.erase(keyImage);
+    if (count != 1) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find spent key.";
+    }
+  }
+
+  for (auto amount = undo.keyOutputAmounts.rbegin(); amount != undo.keyOutputAmounts.rend(); ++amount) {
+    auto amountOutputs = m_outputs.find(*amount);
+    if (amountOutputs == m_outputs.end() || amountOutputs->second.empty()) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find specific amount in outputs map.";
+
+      continue;
+    }
+
+    if (amountOutputs->second.back().first.block != blockIndex) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - invalid transaction index.";
+
+      continue;
+    }
+
+    amountOutputs->second.pop_back();
+    if (amountOutputs->second.empty()) {
+      m_outputs.erase(amountOutputs);
+    }
+  }
+
+  for (auto amount = undo.multisignatureOutputAmounts.rbegin(); amount != undo.multisignatureOutputAmounts.rend(); ++amount) {
+    auto amountOutputs = m_multisignatureOutputs.find(*amount);
+    if (amountOutputs == m_multisignatureOutputs.end() || amountOutputs->second.empty()) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find specific amount in outputs map.";
+
+      continue;
+    }
+
+    if (amountOutputs->second.back().isUsed) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - attempting to remove used output.";
+
+      continue;
+    }
+
+    if (amountOutputs->second.back().transactionIndex.block != blockIndex) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - invalid transaction index.";
+
+      continue;
+    }
+
+    amountOutputs->second.pop_back();
+    if (amountOutputs->second.empty()) {
+      m_multisignatureOutputs.erase(amountOutputs);
+    }
+  }
+
+  for (const auto& transaction : block.transactions) {
+    m_paymentIdIndex.remove(transaction.tx);
+  }
+
+  for (const auto& transactionHash : block.bl.transactionHashes) {
+    if (m_transactionMap.erase(transactionHash) != 1) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find transaction by hash.";
+    }
+  }
+
+  if (m_transactionMap.erase(undo.minerTransactionHash) != 1) {
+    logger(ERROR, BRIGHT_RED) <<
+      "Blockchain consistency broken - cannot find transaction by hash.";
+  }
+}
+
+bool Blockchain::isVerifiedInMainChain(const BlockInfo& maxUsedBlock) {
+  return !maxUsedBlock.empty() && maxUsedBlock.height < m_blocks.size() && getBlockIdByHeight(maxUsedBlock.height) == maxUsedBlock.id;
+}
+
 bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::Hash& transactionHash, const Crypto::Hash& transactionPrefixHash, const std::vector<Crypto::Signature>& transactionSignatures) {
   assert(input.signatureCount == transactionSignatures.size());
   MultisignatureOutputsContainer::const_iterator amountOutputs = m_multisignatureOutputs.find(input.amount);
@@ -2671,9 +3186,15 @@ bool Blockchain::removeLastBlock() {
   }
 
   logger(DEBUGGING) << "Removing last block with height " << m_blocks.back().height;
-  popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
-
   Crypto::Hash blockHash = getBlockIdByHeight(m_blocks.back().height);
+  if (!m_blockUndos.empty() && m_blockUndos.back().blockHash == blockHash) {
+    popTransactions(m_blocks.back(), m_blockUndos.back());
+    m_blockUndos.pop_back();
+  } else {
+    m_blockUndos.clear();
+    popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
+  }
+
   m_timestampIndex.remove(m_blocks.back().bl.timestamp, blockHash);
   m_generatedTransactionsIndex.remove(m_blocks.back().bl);
 
@@ -2853,15 +3374,16 @@ bool Blockchain::getTransactionIdsByPaymentId(const Crypto::Hash& paymentId, std
   return m_paymentIdIndex.find(paymentId, transactionHashes);
 }
 
-bool Blockchain::loadTransactions(const Block& block, std::vector<Transaction>& transactions, uint32_t height) {
+bool Blockchain::loadTransactions(const Block& block, std::vector<Transaction>& transactions, std::vector<BlockInfo>& verifiedInputs, uint32_t height) {
   transactions.resize(block.transactionHashes.size());
+  verifiedInputs.resize(block.transactionHashes.size());
   uint64_t transactionSize;
   uint64_t fee;
   for (uint64_t i = 0; i < block.transactionHashes.size(); ++i) {
-    if (!m_tx_pool.take_tx(block.transactionHashes[i], transactions[i], transactionSize, fee)) {
+    if (!m_tx_pool.take_tx(block.transactionHashes[i], transactions[i], transactionSize, fee, verifiedInputs[i])) {
       tx_verification_context context;
       for (uint64_t j = 0; j < i; ++j) {
-        if (!m_tx_pool.add_tx(transactions[i - 1 - j], context, true, height)
+        if (!m_tx_pool.add_tx(transactions[i - 1 - j], context, true, height, &verifiedInputs[i - 1 - j])
 		) {
           throw std::runtime_error("Blockchain::loadTransactions, failed to add transaction to pool");
         }
@@ -2873,10 +3395,15 @@ bool Blockchain::loadTransactions(const Block& block, std::vector<Transaction>&
   return true;
 }
 
-void Blockchain::saveTransactions(const std::vector<Transaction>& transactions, uint32_t height) {
+void Blockchain::saveTransactions(const std::vector<Transaction>& transactions, uint32_t height, const std::vector<BlockInfo>* verifiedInputs) {
   tx_verification_context context;
   for (uint64_t i = 0; i < transactions.size(); ++i) {
-    if (!m_tx_pool.add_tx(transactions[transactions.size() - 1 - i], context, true, height)) {
+    const BlockInfo* verified = nullptr;
+    if (verifiedInputs != nullptr && !(*verifiedInputs)[transactions.size() - 1 - i].empty()) {
+      verified = &(*verifiedInputs)[transactions.size() - 1 - i];
+    }
+
+    if (!m_tx_pool.add_tx(transactions[transactions.size() - 1 - i], context, true, height, verified)) {
       throw std::runtime_error("Blockchain::saveTransactions, failed to add transaction to pool");
     }
   }
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 
 #include "google/sparse_hash_set"
 #include "google/sparse_hash_map"
@@ -19,6 +20,7 @@
 #include "CryptoNoteCore/Checkpoints.h"
 #include "CryptoNoteCore/Currency.h"
 #include "CryptoNoteCore/DepositIndex.h"
+#include "CryptoNoteCore/ICore.h"
 #include "CryptoNoteCore/IBlockchainStorageObserver.h"
 #include "CryptoNoteCore/ITransactionValidator.h"
 #include "CryptoNoteCore/SwappedVector.h"
@@ -53,6 +55,9 @@ namespace CryptoNote {
     // ITransactionValidator
     virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) override;
     virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) override;
+    virtual bool checkVerifiedTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) override;
+    virtual bool snapshotTransactionInputs(const CryptoNote::Transaction& tx, TransactionInputsSnapshot& snapshot) override;
+    virtual bool checkTransactionSignatures(const CryptoNote::Transaction& tx, const TransactionInputsSnapshot& snapshot, System::WorkerPool* pool) override;
     virtual bool haveSpentKeyImages(const CryptoNote::Transaction& tx) override;
     virtual bool checkTransactionSize(uint64_t blobSize) override;
 
@@ -71,6 +76,9 @@ namespace CryptoNote {
     Crypto::Hash getBlockIdByHeight(uint32_t height);
     bool getBlockByHash(const Crypto::Hash &h, Block &blk);
     bool getBlockHeight(const Crypto::Hash& blockId, uint32_t& blockHeight);
+    // Main chain block and its transactions as stored in blocks.dat, without re-serialization
+    bool getRawBlock(uint32_t height, Block& block, block_complete_entry& rawBlock);
+    bool getRawBlock(const Crypto::Hash& blockId, Block& block, block_complete_entry& rawBlock);
 
     template<class archive_t> void serialize(archive_t & ar, const unsigned int version);
 
@@ -95,6 +103,8 @@ namespace CryptoNote {
       uint32_t& totalBlockCount, uint32_t& startBlockIndex);
       uint8_t getBlockMajorVersionForHeight(uint32_t height) const;
 	uint8_t blockMajorVersion;
+    bool getBlockHeaderChainTail(const Crypto::Hash& blockId, BlockHeaderChainTail& tail);
+    bool checkBlockHeaders(const std::vector<BinaryArray>& hashingBlobs, BlockHeaderChainTail& tail, std::vector<Crypto::Hash>& blockIds);
     bool handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp); //Deprecated. Should be removed with CryptoNoteProtocolHandler.
     bool getRandomOutsByAmount(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res);
     bool getBackwardBlocksSize(uint64_t from_height, std::vector<uint64_t>& sz, uint64_t count);
@@ -232,6 +242,20 @@ bool have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im);
       }
     };
 
+    // Index changes a main chain block made and the validation done for it, recorded when the block is
+    // pushed. Popping the block replays the changes backwards and hands its transactions back to the pool
+    // as verified, so a reorganization neither re-derives them nor checks the ring signatures again.
+    struct BlockUndo {
+      Crypto::Hash blockHash;
+      Crypto::Hash minerTransactionHash;
+      // block the ring signatures of each non-miner transaction were checked against, empty if they were not
+      std::vector<BlockInfo> verifiedInputs;
+      std::vector<Crypto::KeyImage> spentKeyImages;
+      std::vector<std::pair<uint64_t, uint32_t>> usedMultisignatureOutputs; // amount, global output index
+      std::vector<uint64_t> keyOutputAmounts;
+      std::vector<uint64_t> multisignatureOutputAmounts;
+    };
+
     typedef google::sparse_hash_set<Crypto::KeyImage> key_images_container;
     typedef std::unordered_map<Crypto::Hash, BlockEntry> blocks_ext_by_hash;
     typedef google::sparse_hash_map<uint64_t, std::vector<std::pair<TransactionIndex, uint16_t>>> outputs_container; //Crypto::Hash - tx hash, uint64_t - index of out in transaction
@@ -265,6 +289,7 @@ bool have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im);
     CryptoNote::DepositIndex m_depositIndex;
     TransactionMap m_transactionMap;
     MultisignatureOutputsContainer m_multisignatureOutputs;
+    std::deque<BlockUndo> m_blockUndos; // for the blocks a reorganization can reach, back is the tail
     UpgradeDetector m_upgradeDetectorV2;
     UpgradeDetector m_upgradeDetectorV3;
   
@@ -280,12 +305,13 @@ bool have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im);
     void rebuildCache();
     bool storeCache();
     bool switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::iterator>& alt_chain, bool discard_disconnected_chain);
-    bool handle_alternative_block(const Block& b, const Crypto::Hash& id, block_verification_context& bvc, bool sendNewAlternativeBlockMessage = true);
+    // checkedDifficulty is the difficulty the proof of work was already checked against, 0 if it was not
+    bool handle_alternative_block(const Block& b, const Crypto::Hash& id, block_verification_context& bvc, bool sendNewAlternativeBlockMessage = true, difficulty_type checkedDifficulty = 0);
     difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, BlockEntry& bei);
     void pushToDepositIndex(const BlockEntry& block, uint64_t interest);
     bool prevalidate_miner_transaction(const Block& b, uint32_t height);
     bool validate_miner_transaction(const Block& b, uint32_t height, uint64_t cumulativeBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint64_t& reward, int64_t& emissionChange);
-    bool rollback_blockchain_switching(std::list<Block>& original_chain, uint64_t rollback_height);
+    bool rollback_blockchain_switching(std::list<std::pair<Block, difficulty_type>>& original_chain, uint64_t rollback_height);
     bool get_last_n_blocks_sizes(std::vector<uint64_t>& sz, uint64_t count);
     bool add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount& result_outs, uint64_t amount, uint64_t i);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
@@ -297,29 +323,34 @@ bool have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im);
     bool checkBlockVersion(const Block& b, const Crypto::Hash& blockHash);
     bool checkCumulativeBlockSize(const Crypto::Hash& blockId, uint64_t cumulativeBlockSize, uint64_t height);
     std::vector<Crypto::Hash> doBuildSparseChain(const Crypto::Hash& startBlockId) const;
+    uint64_t headerChainWindowSize() const;
     bool getBlockCumulativeSize(const Block& block, uint64_t& cumulativeSize);
     bool update_next_comulative_size_limit();
-    bool check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height = NULL);
-    bool checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height = NULL);
-    bool checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height = NULL);
+    bool check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height = NULL, bool checkSignature = true);
+    bool checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height = NULL, bool checkSignatures = true);
+    bool checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height = NULL, bool checkSignatures = true);
     bool check_tx_outputs(const Transaction& tx) const;
 
     const TransactionEntry& transactionByIndex(TransactionIndex index);
-    bool pushBlock(const Block& blockData, const Crypto::Hash& id, block_verification_context& bvc, uint32_t height);
-    bool pushBlock(const Block& blockData, const std::vector<Transaction>& transactions, const Crypto::Hash& id, block_verification_context& bvc);
-    bool pushBlock(BlockEntry& block);
-    void popBlock(const Crypto::Hash& blockHash);
+    // a non zero checkedDifficulty marks a block a reorganization already validated on this chain prefix: the proof
+    // of work is not checked again at that difficulty, nor the ring signatures the pool verified against this chain
+    bool pushBlock(const Block& blockData, const Crypto::Hash& id, block_verification_context& bvc, uint32_t height, difficulty_type checkedDifficulty = 0);
+    bool pushBlock(const Block& blockData, const std::vector<Transaction>& transactions, const std::vector<BlockInfo>& verifiedInputs, const Crypto::Hash& id, block_verification_context& bvc, difficulty_type checkedDifficulty);
+    bool pushBlock(BlockEntry& block, BlockUndo& undo);
+    void popBlock();
     bool pushTransaction(BlockEntry& block, const Crypto::Hash& transactionHash, TransactionIndex transactionIndex);
     void popTransaction(const Transaction& transaction, const Crypto::Hash& transactionHash);
     void popTransactions(const BlockEntry& block, const Crypto::Hash& minerTransactionHash);
+    void popTransactions(const BlockEntry& block, const BlockUndo& undo);
+    bool isVerifiedInMainChain(const BlockInfo& maxUsedBlock);
     bool validateInput(const MultisignatureInput& input, const Crypto::Hash& transactionHash, const Crypto::Hash& transactionPrefixHash, const std::vector<Crypto::Signature>& transactionSignatures);
     bool removeLastBlock();
     bool checkCheckpoints(uint32_t& lastValidCheckpointHeight);    
     bool storeBlockchainIndices();
     bool loadBlockchainIndices();
 
-    bool loadTransactions(const Block& block, std::vector<Transaction>& transactions, uint32_t height);
-    void saveTransactions(const std::vector<Transaction>& transactions, uint32_t height);
+    bool loadTransactions(const Block& block, std::vector<Transaction>& transactions, std::vector<BlockInfo>& verifiedInputs, uint32_t height);
+    void saveTransactions(const std::vector<Transaction>& transactions, uint32_t height, const std::vector<BlockInfo>* verifiedInputs = nullptr);
 
     void sendMessage(const BlockchainMessage& message);
 
@@ -85,6 +85,10 @@ void core::set_cryptonote_protocol(i_cryptonote_protocol* pprotocol) {
     m_pprotocol = &m_protocol_stub;
   }
 }
+
+void core::setSignatureWorkers(System::Dispatcher& dispatcher, size_t threadCount) {
+  m_signaturePool.reset(new System::WorkerPool(dispatcher, threadCount));
+}
 //-----------------------------------------------------------------------------------
 void core::set_checkpoints(Checkpoints&& chk_pts) {
   m_blockchain.setCheckpoints(std::move(chk_pts));
@@ -132,6 +136,7 @@ uint64_t core::get_alternative_blocks_count() {
 //-----------------------------------------------------------------------------------------------
 bool core::init(const CoreConfig& config, const MinerConfig& minerConfig, bool load_existing) {
   m_config_folder = config.configFolder;
+  m_mempool.setMaxSize(config.txPoolMaxSize);
   bool r = m_mempool.init(m_config_folder);
 
   start_time = std::time(nullptr);
@@ -147,6 +152,8 @@ bool core::init(const CoreConfig& config, const MinerConfig& minerConfig, bool l
     return false;
   }
 
+  m_mempool.revalidate();
+
   r = m_miner->init(minerConfig);
   if (!(r)) {
     logger(ERROR, BRIGHT_RED) << "<< Core.cpp << " << "Failed to initialize blockchain storage";
@@ -167,6 +174,7 @@ bool core::load_state_data() {
 
 bool core::deinit() {
   m_miner->stop();
+  m_signaturePool.reset();
   m_mempool.deinit();
   m_blockchain.deinit();
   return true;
@@ -323,7 +331,7 @@ uint64_t core::get_blockchain_total_transactions() {
 //  return m_blockchain.get_outs(amount, pkeys);
 //}
 
-bool core::add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, uint64_t blob_size, tx_verification_context& tvc, bool keeped_by_block, uint32_t height) {
+bool core::add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, uint64_t blob_size, tx_verification_context& tvc, bool keeped_by_block, uint32_t height, const BlockInfo* verifiedInputs) {
   //Locking on m_mempool and m_blockchain closes possibility to add tx to memory pool which is already in blockchain
   std::lock_guard<decltype(m_mempool)> lk(m_mempool);
   LockedBlockchainStorage lbs(m_blockchain);
@@ -337,12 +345,24 @@ bool core::add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, uint64
     logger(TRACE) << "<< Core.cpp << " << "tx " << tx_hash << " is already in transaction pool";
     return true;
   }
-  return m_mempool.add_tx(tx, tx_hash, blob_size, tvc, keeped_by_block, height);
+  return m_mempool.add_tx(tx, tx_hash, blob_size, tvc, keeped_by_block, height, verifiedInputs);
 }
 
 bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const BinaryArray& ex_nonce) {
-  uint64_t median_size;
-  uint64_t already_generated_coins;
+  BlockTemplateBase base;
+  if (!prepareBlockTemplate(base) || !completeBlockTemplate(base, adr, ex_nonce, b)) {
+    return false;
+  }
+
+  diffic = base.difficulty;
+  height = base.height;
+  return true;
+}
+
+bool core::prepareBlockTemplate(BlockTemplateBase& base) {
+  Block& b = base.block;
+  uint32_t& height = base.height;
+  difficulty_type& diffic = base.difficulty;
 
   {
     LockedBlockchainStorage blockchainLock(m_blockchain);
@@ -367,7 +387,7 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
 	}
 
     b.previousBlockHash = get_tail_id();
-    b.timestamp = time(NULL);
+    base.minimalTimestamp = 0;
 // k0x001
 // Don't generate a block template with invalid timestamp
 // Fix by Jagerman
@@ -376,21 +396,25 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
       for(uint32_t offset = height - static_cast<uint32_t>(m_currency.timestampCheckWindow()); offset < height; ++offset) {
         timestamps.push_back(m_blockchain.getBlockTimestamp(offset));
       }
-      uint64_t median_ts = Common::medianValue(timestamps);
-      if (b.timestamp < median_ts) {
-          b.timestamp = median_ts;
-      }
+      base.minimalTimestamp = Common::medianValue(timestamps);
     }
 //	
-    median_size = m_blockchain.getCurrentCumulativeBlocksizeLimit() / 2;
-    already_generated_coins = m_blockchain.getCoinsInCirculation();
+    base.medianSize = m_blockchain.getCurrentCumulativeBlocksizeLimit() / 2;
+    base.alreadyGeneratedCoins = m_blockchain.getCoinsInCirculation();
   }
 
-  uint64_t txs_size;
-  uint64_t fee;
-  if (!m_mempool.fill_block_template(b, median_size, m_currency.maxBlockCumulativeSize(height), already_generated_coins, txs_size, fee, height)) {
-    return false;
-  }
+  return m_mempool.fill_block_template(b, base.medianSize, m_currency.maxBlockCumulativeSize(height), base.alreadyGeneratedCoins, base.transactionsSize, base.fee, height);
+}
+
+bool core::completeBlockTemplate(const BlockTemplateBase& base, const AccountPublicAddress& adr, const BinaryArray& ex_nonce, Block& b) {
+  b = base.block;
+  b.timestamp = std::max<uint64_t>(time(NULL), base.minimalTimestamp);
+
+  const uint32_t height = base.height;
+  const uint64_t median_size = base.medianSize;
+  const uint64_t already_generated_coins = base.alreadyGeneratedCoins;
+  const uint64_t txs_size = base.transactionsSize;
+  const uint64_t fee = base.fee;
 
   /*
      two-phase miner transaction generation: we don't know exact block size until we prepare block, but we don't know reward until we know
@@ -457,6 +481,14 @@ std::vector<Crypto::Hash> core::findBlockchainSupplement(const std::vector<Crypt
   return m_blockchain.findBlockchainSupplement(remoteBlockIds, maxCount, totalBlockCount, startBlockIndex);
 }
 
+bool core::getBlockHeaderChainTail(const Crypto::Hash& blockId, BlockHeaderChainTail& tail) {
+  return m_blockchain.getBlockHeaderChainTail(blockId, tail);
+}
+
+bool core::checkBlockHeaders(const std::vector<BinaryArray>& hashingBlobs, BlockHeaderChainTail& tail, std::vector<Crypto::Hash>& blockIds) {
+  return m_blockchain.checkBlockHeaders(hashingBlobs, tail, blockIds);
+}
+
 void core::print_blockchain(uint32_t start_index, uint32_t end_index) {
   m_blockchain.print_blockchain(start_index, end_index);
 }
@@ -529,6 +561,34 @@ bool core::getPoolChangesLite(const Crypto::Hash& tailBlockId, const std::vector
   return returnStatus;
 }
 
+void core::getPoolFeedPosition(uint64_t& feedId, uint64_t& sequence) {
+  m_mempool.getChangeFeedPosition(feedId, sequence);
+}
+
+bool core::getPoolChangesSince(const Crypto::Hash& tailBlockId, uint64_t& feedId, uint64_t& sequence, bool& isSequenceActual,
+                               std::vector<TransactionPrefixInfo>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) {
+  std::vector<Crypto::Hash> addedTxsIds;
+  std::vector<Transaction> added;
+  {
+    auto guard = m_mempool.obtainGuard();
+    isSequenceActual = m_mempool.getChangesSince(feedId, sequence, addedTxsIds, deletedTxsIds);
+    m_mempool.getChangeFeedPosition(feedId, sequence);
+
+    std::vector<Crypto::Hash> misses;
+    m_mempool.getTransactions(addedTxsIds, added, misses);
+    assert(misses.empty());
+  }
+
+  for (size_t i = 0; i < added.size(); ++i) {
+    TransactionPrefixInfo tpi;
+    tpi.txPrefix = std::move(added[i]);
+    tpi.txHash = addedTxsIds[i];
+    addedTxs.push_back(std::move(tpi));
+  }
+
+  return tailBlockId == m_blockchain.getTailId();
+}
+
 void core::getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vector<Transaction>& addedTxs,
                           std::vector<Crypto::Hash>& deletedTxsIds) {
 
@@ -612,6 +672,22 @@ uint64_t core::get_pool_transactions_count() {
   return m_mempool.get_transactions_count();
 }
 
+uint64_t core::get_pool_size() {
+  return m_mempool.getPoolSize();
+}
+
+uint64_t core::get_pool_fee() {
+  return m_mempool.getPoolFee();
+}
+
+uint64_t core::get_pool_evicted_count() {
+  return m_mempool.getEvictedCount();
+}
+
+uint64_t core::get_pool_rejected_count() {
+  return m_mempool.getRejectedCount();
+}
+
 bool core::have_block(const Crypto::Hash& id) {
   return m_blockchain.haveBlock(id);
 }
@@ -772,26 +848,17 @@ bool core::queryBlocks(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t
     return true;
   }
 
-  std::list<Block> blocks;
-  lbs->getBlocks(startFullOffset, blocksLeft, blocks);
-
-  for (auto& b : blocks) {
+  for (uint32_t height = startFullOffset; height < startFullOffset + blocksLeft && height < currentHeight; ++height) {
     BlockFullInfo item;
+    Block b;
+    block_complete_entry rawBlock;
+    if (!lbs->getRawBlock(height, b, rawBlock)) {
+      break;
+    }
 
-    item.block_id = get_block_hash(b);
-
+    item.block_id = lbs->getBlockIdByHeight(height);
     if (b.timestamp >= timestamp) {
-      // query transactions
-      std::list<Transaction> txs;
-      std::list<Crypto::Hash> missedTxs;
-      lbs->getTransactions(b.transactionHashes, txs, missedTxs);
-
-      // fill data
-      block_complete_entry& completeEntry = item;
-      completeEntry.block = asString(toBinaryArray(b));
-      for (auto& tx : txs) {
-        completeEntry.txs.push_back(asString(toBinaryArray(tx)));
-      }
+      static_cast<block_complete_entry&>(item) = std::move(rawBlock);
     }
 
     entries.push_back(std::move(item));
@@ -1056,7 +1123,22 @@ bool core::handleIncomingTransaction(const Transaction& tx, const Crypto::Hash&
     return false;
   }
 
-  bool r = add_new_tx(tx, txHash, blobSize, tvc, keptByBlock, height);
+  // ring signatures are verified against a snapshot of the outputs they reference, so
+  // add_new_tx only needs the locks for the double spend checks
+  TransactionInputsSnapshot snapshot;
+  bool inputsVerified = false;
+  if (!keptByBlock && !m_mempool.have_tx(txHash) && !m_blockchain.haveTransaction(txHash)) {
+    if (!m_blockchain.snapshotTransactionInputs(tx, snapshot) || !m_blockchain.checkTransactionSignatures(tx, snapshot, m_signaturePool.get())) {
+      logger(DEBUGGING) << "tx " << txHash << " used wrong inputs, rejected";
+      std::cout << BrightRedMsg("The Transaction uses the wrong inputs so it was rejected.") << std::endl;
+      tvc.m_verification_failed = true;
+      return false;
+    }
+
+    inputsVerified = !snapshot.maxUsedBlock.empty();
+  }
+
+  bool r = add_new_tx(tx, txHash, blobSize, tvc, keptByBlock, height, inputsVerified ? &snapshot.maxUsedBlock : nullptr);
   if (tvc.m_verification_failed) {
     if (!tvc.m_tx_fee_too_small) {
       logger(ERROR) << "Transaction verification failed: " << txHash;
@@ -1099,6 +1181,11 @@ std::unique_ptr<IBlock> core::getBlock(const Crypto::Hash& blockId) {
   return std::move(blockPtr);
 }
 
+bool core::getRawBlock(const Crypto::Hash& blockId, block_complete_entry& rawBlock) {
+  Block block;
+  return m_blockchain.getRawBlock(blockId, block, rawBlock);
+}
+
 bool core::is_key_image_spent(const Crypto::KeyImage& key_im) {
   return m_blockchain.have_tx_keyimg_as_spent(key_im);
 }
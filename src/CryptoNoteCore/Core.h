@@ -25,6 +25,7 @@
 #include "Common/ObserverManager.h"
 
 #include "System/Dispatcher.h"
+#include "System/WorkerPool.h"
 #include "CryptoNoteCore/MessageQueue.h"
 #include "CryptoNoteCore/BlockchainMessages.h"
 
@@ -36,6 +37,18 @@ namespace CryptoNote {
   class miner;
   class CoreConfig;
 
+  // the miner independent part of a block template, the pool's transaction selection is the costly part of it
+  struct BlockTemplateBase {
+    Block block;
+    difficulty_type difficulty;
+    uint32_t height;
+    uint64_t minimalTimestamp;
+    uint64_t medianSize;
+    uint64_t alreadyGeneratedCoins;
+    uint64_t transactionsSize;
+    uint64_t fee;
+  };
+
   class core : public ICore, public IMinerHandler, public IBlockchainStorageObserver, public ITxPoolObserver {
    public:
      core(const Currency& currency, i_cryptonote_protocol* pprotocol, Logging::ILogger& logger);
@@ -52,6 +65,9 @@ namespace CryptoNote {
      //-------------------- IMinerHandler -----------------------
      virtual bool handle_block_found(Block& b) override;
      virtual bool get_block_template(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const BinaryArray& ex_nonce) override;
+     bool prepareBlockTemplate(BlockTemplateBase& base);
+     // fresh timestamp and coinbase on top of a prepared template, the base can be reused until the chain or pool changes
+     bool completeBlockTemplate(const BlockTemplateBase& base, const AccountPublicAddress& adr, const BinaryArray& ex_nonce, Block& b);
 
      bool addObserver(ICoreObserver* observer) override;
      bool removeObserver(ICoreObserver* observer) override;
@@ -82,6 +98,7 @@ namespace CryptoNote {
      virtual bool getTransactionsByPaymentId(const Crypto::Hash& paymentId, std::vector<Transaction>& transactions) override;
      virtual bool getOutByMSigGIndex(uint64_t amount, uint64_t gindex, MultisignatureOutput& out) override;
      virtual std::unique_ptr<IBlock> getBlock(const Crypto::Hash& blocksId) override;
+     virtual bool getRawBlock(const Crypto::Hash& blockId, block_complete_entry& rawBlock) override;
      virtual bool handleIncomingTransaction(const Transaction& tx, const Crypto::Hash& txHash, uint64_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) override;
      virtual std::error_code executeLocked(const std::function<std::error_code()>& func) override;
      
@@ -119,14 +136,23 @@ namespace CryptoNote {
      uint64_t difficultyAtHeight(uint64_t height);
 
      void set_cryptonote_protocol(i_cryptonote_protocol* pprotocol);
+     // Relayed transaction signatures are checked on 'threadCount' threads while the calling context waits on
+     // 'dispatcher'. Transactions must then be handled on the dispatcher thread. Without a pool they are checked inline.
+     void setSignatureWorkers(System::Dispatcher& dispatcher, size_t threadCount);
      void set_checkpoints(Checkpoints&& chk_pts);
 
      std::vector<Transaction> getPoolTransactions() override;
      uint64_t get_pool_transactions_count();
+     uint64_t get_pool_size();
+     uint64_t get_pool_fee();
+     uint64_t get_pool_evicted_count();
+     uint64_t get_pool_rejected_count();
      uint64_t get_blockchain_total_transactions();
      //bool get_outs(uint64_t amount, std::list<Crypto::PublicKey>& pkeys);
      virtual std::vector<Crypto::Hash> findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds, uint64_t maxCount,
        uint32_t& totalBlockCount, uint32_t& startBlockIndex) override;
+     virtual bool getBlockHeaderChainTail(const Crypto::Hash& blockId, BlockHeaderChainTail& tail) override;
+     virtual bool checkBlockHeaders(const std::vector<BinaryArray>& hashingBlobs, BlockHeaderChainTail& tail, std::vector<Crypto::Hash>& blockIds) override;
      bool get_stat_info(core_stat_info& st_inf) override;
      
      virtual bool get_tx_outputs_gindexs(const Crypto::Hash& tx_id, std::vector<uint32_t>& indexs) override;
@@ -146,6 +172,10 @@ namespace CryptoNote {
                                   std::vector<TransactionPrefixInfo>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) override;
      virtual void getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vector<Transaction>& addedTxs,
                                  std::vector<Crypto::Hash>& deletedTxsIds) override;
+     void getPoolFeedPosition(uint64_t& feedId, uint64_t& sequence);
+     // delta of the pool since a change feed position, isSequenceActual is false if the feed no longer reaches back to it
+     bool getPoolChangesSince(const Crypto::Hash& tailBlockId, uint64_t& feedId, uint64_t& sequence, bool& isSequenceActual,
+                              std::vector<TransactionPrefixInfo>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds);
 
      uint64_t getNextBlockDifficulty();
      uint64_t getTotalGeneratedAmount();
@@ -158,7 +188,7 @@ namespace CryptoNote {
      uint32_t getDaemonHeight();
 
    private:
-     bool add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, uint64_t blob_size, tx_verification_context& tvc, bool keeped_by_block, uint32_t height);
+     bool add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, uint64_t blob_size, tx_verification_context& tvc, bool keeped_by_block, uint32_t height, const BlockInfo* verifiedInputs);
      bool load_state_data();
      bool parse_tx_from_blob(Transaction& tx, Crypto::Hash& tx_hash, Crypto::Hash& tx_prefix_hash, const BinaryArray& blob);
      bool handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block);
@@ -190,6 +220,7 @@ namespace CryptoNote {
      Blockchain m_blockchain;
      i_cryptonote_protocol* m_pprotocol;
      std::unique_ptr<miner> m_miner;
+     std::unique_ptr<System::WorkerPool> m_signaturePool;
      std::string m_config_folder;
      cryptonote_protocol_stub m_protocol_stub;
      friend class tx_validate_inputs;
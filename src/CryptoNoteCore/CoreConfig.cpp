@@ -8,11 +8,19 @@
 
 #include "Common/Util.h"
 #include "Common/CommandLine.h"
+#include "CryptoNoteConfig.h"
 
 namespace CryptoNote {
 
+namespace {
+
+const command_line::arg_descriptor<uint64_t> arg_txpool_max_size = { "txpool-max-size", "Maximum size in bytes of the transactions kept in the pool, the lowest fee per byte ones are evicted beyond it", parameters::CRYPTONOTE_MEMPOOL_MAX_SIZE };
+
+}
+
 CoreConfig::CoreConfig() {
   configFolder = Tools::getDefaultDataDirectory();
+  txPoolMaxSize = parameters::CRYPTONOTE_MEMPOOL_MAX_SIZE;
 }
 
 void CoreConfig::init(const boost::program_options::variables_map& options) {
@@ -20,8 +28,13 @@ void CoreConfig::init(const boost::program_options::variables_map& options) {
     configFolder = command_line::get_arg(options, command_line::arg_data_dir);
     configFolderDefaulted = options[command_line::arg_data_dir.name].defaulted();
   }
+
+  if (options.count(arg_txpool_max_size.name) != 0) {
+    txPoolMaxSize = command_line::get_arg(options, arg_txpool_max_size);
+  }
 }
 
 void CoreConfig::initOptions(boost::program_options::options_description& desc) {
+  command_line::add_arg(desc, arg_txpool_max_size);
 }
 } //namespace CryptoNote
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include <boost/program_options.hpp>
@@ -21,6 +22,7 @@ public:
 
   std::string configFolder;
   bool configFolderDefaulted = true;
+  uint64_t txPoolMaxSize;
 };
 
 } //namespace CryptoNote
@@ -490,18 +490,34 @@ bool get_block_longhash(cn_context &context, const Block& b, Hash& res) {
     return false;
   }
 
-if (b.majorVersion >= 3) {
-    cn_conceal_slow_hash_v0(context, bd.data(), bd.size(), res);
-  } else if (b.majorVersion == 2) {
-    cn_fast_slow_hash_v1(context, bd.data(), bd.size(), res);
+  return get_block_longhash(context, b.majorVersion, bd, res);
+}
+
+bool get_block_longhash(cn_context &context, uint8_t majorVersion, const BinaryArray& hashingBlob, Hash& res) {
+  if (majorVersion >= 3) {
+    cn_conceal_slow_hash_v0(context, hashingBlob.data(), hashingBlob.size(), res);
+  } else if (majorVersion == 2) {
+    cn_fast_slow_hash_v1(context, hashingBlob.data(), hashingBlob.size(), res);
   } else {
-    cn_slow_hash(context, bd.data(), bd.size(), res);
+    cn_slow_hash(context, hashingBlob.data(), hashingBlob.size(), res);
   }
-  
 
   return true;
 }
 
+bool get_block_header_from_hashing_blob(const BinaryArray& hashingBlob, BlockHeader& header) {
+  try {
+    Common::MemoryInputStream stream(hashingBlob.data(), hashingBlob.size());
+    BinaryInputStreamSerializer serializer(stream);
+    serialize(header, serializer);
+
+    // header must be followed by the transactions tree root hash and the transactions count
+    return hashingBlob.size() - stream.getPosition() > sizeof(Hash);
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
 std::vector<uint32_t> relative_output_offsets_to_absolute(const std::vector<uint32_t>& off) {
   std::vector<uint32_t> res = off;
   for (uint64_t i = 1; i < res.size(); i++)
@@ -92,6 +92,7 @@ bool Currency::init() {
     m_blocksCacheFileName = "testnet_" + m_blocksCacheFileName;
     m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
     m_txPoolFileName = "testnet_" + m_txPoolFileName;
+    m_txPoolJournalFileName = "testnet_" + m_txPoolJournalFileName;
     m_blockchinIndicesFileName = "testnet_" + m_blockchinIndicesFileName;
   }
 
@@ -845,6 +846,7 @@ CurrencyBuilder::CurrencyBuilder(Logging::ILogger& log) : m_currency(log) {
   blocksCacheFileName(parameters::CRYPTONOTE_BLOCKSCACHE_FILENAME);
   blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
   txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
+  txPoolJournalFileName(parameters::CRYPTONOTE_POOLJOURNAL_FILENAME);
   blockchinIndicesFileName(parameters::CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME);
 
   testnet(false);
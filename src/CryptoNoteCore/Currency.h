@@ -122,6 +122,7 @@ public:
   const std::string& blocksCacheFileName() const { return m_blocksCacheFileName; }
   const std::string& blockIndexesFileName() const { return m_blockIndexesFileName; }
   const std::string& txPoolFileName() const { return m_txPoolFileName; }
+  const std::string& txPoolJournalFileName() const { return m_txPoolJournalFileName; }
   const std::string& blockchinIndicesFileName() const { return m_blockchinIndicesFileName; }
 
   bool isBlockexplorer() const { return m_isBlockexplorer; }
@@ -241,6 +242,7 @@ private:
   std::string m_blocksCacheFileName;
   std::string m_blockIndexesFileName;
   std::string m_txPoolFileName;
+  std::string m_txPoolJournalFileName;
   std::string m_blockchinIndicesFileName;
 
   static const std::vector<uint64_t> REWARD_INCREASING_FACTOR;
@@ -334,6 +336,7 @@ public:
   CurrencyBuilder& blocksCacheFileName(const std::string& val) { m_currency.m_blocksCacheFileName = val; return *this; }
   CurrencyBuilder& blockIndexesFileName(const std::string& val) { m_currency.m_blockIndexesFileName = val; return *this; }
   CurrencyBuilder& txPoolFileName(const std::string& val) { m_currency.m_txPoolFileName = val; return *this; }
+  CurrencyBuilder& txPoolJournalFileName(const std::string& val) { m_currency.m_txPoolJournalFileName = val; return *this; }
   CurrencyBuilder& blockchinIndicesFileName(const std::string& val) { m_currency.m_blockchinIndicesFileName = val; return *this; }
 
   CurrencyBuilder& genesisCoinbaseTxHex(const std::string& val) { m_currency.m_genesisCoinbaseTxHex = val; return *this; }
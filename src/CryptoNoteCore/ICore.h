@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <list>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <system_error>
@@ -29,6 +30,7 @@ class Currency;
 class IBlock;
 class ICoreObserver;
 struct Block;
+struct block_complete_entry;
 struct block_verification_context;
 struct BlockFullInfo;
 struct BlockShortInfo;
@@ -40,6 +42,16 @@ struct KeyInput;
 struct TransactionPrefixInfo;
 struct tx_verification_context;
 
+// Last block of a header chain together with the difficulty and timestamp windows needed to validate its successors
+struct BlockHeaderChainTail {
+  uint32_t height;
+  Crypto::Hash id;
+  // the genesis block is left out of these windows, it only counts for the timestamp median
+  std::vector<uint64_t> timestamps;
+  std::vector<difficulty_type> cumulativeDifficulties;
+  uint64_t genesisTimestamp;
+};
+
 class ICore {
 public:
   virtual ~ICore() {}
@@ -65,6 +77,8 @@ public:
   virtual void get_blockchain_top(uint32_t& height, Crypto::Hash& top_id) = 0;
   virtual std::vector<Crypto::Hash> findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds, uint64_t maxCount,
     uint32_t& totalBlockCount, uint32_t& startBlockIndex) = 0;
+  virtual bool getBlockHeaderChainTail(const Crypto::Hash& blockId, BlockHeaderChainTail& tail) = 0;
+  virtual bool checkBlockHeaders(const std::vector<BinaryArray>& hashingBlobs, BlockHeaderChainTail& tail, std::vector<Crypto::Hash>& blockIds) = 0;
   virtual bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res) = 0;
   virtual bool get_tx_outputs_gindexs(const Crypto::Hash& tx_id, std::vector<uint32_t>& indexs) = 0;
   virtual bool getOutByMSigGIndex(uint64_t amount, uint64_t gindex, MultisignatureOutput& out) = 0;
@@ -103,6 +117,7 @@ public:
   virtual bool getTransactionsByPaymentId(const Crypto::Hash& paymentId, std::vector<Transaction>& transactions) = 0;
 
   virtual std::unique_ptr<IBlock> getBlock(const Crypto::Hash& blocksId) = 0;
+  virtual bool getRawBlock(const Crypto::Hash& blockId, block_complete_entry& rawBlock) = 0;
   virtual bool handleIncomingTransaction(const Transaction& tx, const Crypto::Hash& txHash, uint64_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) = 0;
   virtual std::error_code executeLocked(const std::function<std::error_code()>& func) = 0;
 
@@ -6,8 +6,14 @@
 
 #pragma once
 
+#include <vector>
+
 #include "CryptoNoteCore/CryptoNoteBasic.h"
 
+namespace System {
+class WorkerPool;
+}
+
 namespace CryptoNote {
 
   struct BlockInfo {
@@ -28,12 +34,27 @@ namespace CryptoNote {
     }
   };
 
+  struct TransactionInputsSnapshot {
+    // empty when checkSignatures is false
+    BlockInfo maxUsedBlock;
+    // ring member keys of every key input, in input order
+    std::vector<std::vector<Crypto::PublicKey>> outputKeys;
+    bool checkSignatures;
+  };
+
   class ITransactionValidator {
   public:
     virtual ~ITransactionValidator() {}
     
     virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) = 0;
     virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) = 0;
+    // for transactions whose ring signatures were already verified against the outputs known at maxUsedBlock
+    virtual bool checkVerifiedTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) = 0;
+    // short locked phase: resolves the ring members of the key inputs and rejects key images spent in the chain
+    virtual bool snapshotTransactionInputs(const CryptoNote::Transaction& tx, TransactionInputsSnapshot& snapshot) = 0;
+    // lock free phase: key image subgroup and ring signature checks against the snapshot, spread over
+    // 'pool' when given, the calling dispatcher context is suspended meanwhile
+    virtual bool checkTransactionSignatures(const CryptoNote::Transaction& tx, const TransactionInputsSnapshot& snapshot, System::WorkerPool* pool) = 0;
     virtual bool haveSpentKeyImages(const CryptoNote::Transaction& tx) = 0;
     virtual bool checkTransactionSize(uint64_t blobSize) = 0;
   };
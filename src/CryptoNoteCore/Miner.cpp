@@ -8,6 +8,7 @@
 
 #include "Miner.h"
 
+#include <cstring>
 #include <future>
 #include <numeric>
 #include <sstream>
@@ -27,6 +28,7 @@
 #include "Serialization/SerializationTools.h"
 
 #include "CryptoNoteFormatUtils.h"
+#include "CryptoNoteTools.h"
 #include "TransactionExtra.h"
 
 #include "Common/ColouredMsg.h"
@@ -40,15 +42,13 @@ namespace CryptoNote
     m_currency(currency),
     logger(log, "miner"),
     m_stop(true),
-    m_template(boost::value_initialized<Block>()),
     m_template_no(0),
-    m_diffic(0),
     m_handler(handler),
     m_pausers_count(0),
     m_threads_total(0),
     m_starter_nonce(0),
     m_last_hr_merge_time(0),
-    m_hashes(0),
+    m_hashCounters(std::make_shared<std::vector<HashCounter>>()),
     m_do_print_hashrate(false),
     m_do_mining(false),
     m_current_hash_rate(0),
@@ -62,12 +62,21 @@ namespace CryptoNote
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::set_block_template(const Block& bl, const difficulty_type& di) {
-    std::lock_guard<decltype(m_template_lock)> lk(m_template_lock);
+    auto job = std::make_shared<MiningJob>();
+    job->block = bl;
+    job->difficulty = di;
+
+    // the nonce is the last field of the header, which starts the hashing blob
+    BinaryArray header;
+    if (!toBinaryArray(static_cast<const BlockHeader&>(bl), header) || !get_block_hashing_blob(bl, job->hashingBlob)) {
+      logger(ERROR) << "Failed to build the hashing blob of the block template";
+      return false;
+    }
+    job->nonceOffset = header.size() - sizeof(bl.nonce);
 
-    m_template = bl;
-    m_diffic = di;
-    ++m_template_no;
     m_starter_nonce = Crypto::rand<uint32_t>();
+    std::atomic_store(&m_job, std::shared_ptr<const MiningJob>(std::move(job)));
+    ++m_template_no;
     return true;
   }
   //-----------------------------------------------------------------------------------------------------
@@ -127,8 +136,13 @@ namespace CryptoNote
   //-----------------------------------------------------------------------------------------------------
   void miner::merge_hr()
   {
+    uint64_t hashes = 0;
+    for (HashCounter& counter : *std::atomic_load(&m_hashCounters)) {
+      hashes += counter.hashes.exchange(0, std::memory_order_relaxed);
+    }
+
     if(m_last_hr_merge_time && is_mining()) {
-      m_current_hash_rate = m_hashes * 1000 / (millisecondsSinceEpoch() - m_last_hr_merge_time + 1);
+      m_current_hash_rate = hashes * 1000 / (millisecondsSinceEpoch() - m_last_hr_merge_time + 1);
       std::lock_guard<std::mutex> lk(m_last_hash_rates_lock);
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
@@ -142,7 +156,6 @@ namespace CryptoNote
     }
     
     m_last_hr_merge_time = millisecondsSinceEpoch();
-    m_hashes = 0;
   }
 
   bool miner::init(const MinerConfig& config) {
@@ -214,6 +227,7 @@ namespace CryptoNote
     m_mine_address = adr;
     m_threads_total = static_cast<uint32_t>(threads_count);
     m_starter_nonce = Crypto::rand<uint32_t>();
+    std::atomic_store(&m_hashCounters, std::make_shared<std::vector<HashCounter>>(threads_count));
 
     if (!m_template_no) {
       request_block_template(); //lets update block template
@@ -269,6 +283,13 @@ namespace CryptoNote
     unsigned nthreads = std::thread::hardware_concurrency();
 
     if (nthreads > 0 && diffic > 5) {
+      BinaryArray header;
+      BinaryArray hashingBlob;
+      if (!toBinaryArray(static_cast<const BlockHeader&>(bl), header) || !get_block_hashing_blob(bl, hashingBlob)) {
+        return false;
+      }
+      size_t nonceOffset = header.size() - sizeof(bl.nonce);
+
       std::vector<std::future<void>> threads(nthreads);
       std::atomic<uint32_t> foundNonce;
       std::atomic<bool> found(false);
@@ -279,12 +300,12 @@ namespace CryptoNote
           Crypto::cn_context localctx;
           Crypto::Hash h;
 
-          Block lb(bl); // copy to local block
+          BinaryArray blob(hashingBlob); // copy to local blob
 
           for (uint32_t nonce = startNonce + i; !found; nonce += nthreads) {
-            lb.nonce = nonce;
+            std::memcpy(blob.data() + nonceOffset, &nonce, sizeof(nonce));
 
-            if (!get_block_longhash(localctx, lb, h)) {
+            if (!get_block_longhash(localctx, bl.majorVersion, blob, h)) {
               return;
             }
 
@@ -357,10 +378,12 @@ namespace CryptoNote
               << BrightMagentaMsg(std::to_string(th_local_index)) << std::endl;
 
     uint32_t nonce = m_starter_nonce + th_local_index;
-    difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
+    std::shared_ptr<const MiningJob> job;
+    BinaryArray blob;
     Crypto::cn_context context;
-    Block b;
+    std::shared_ptr<std::vector<HashCounter>> counters = std::atomic_load(&m_hashCounters);
+    std::atomic<uint64_t>& hashes = (*counters)[th_local_index].hashes;
 
     while(!m_stop)
     {
@@ -371,38 +394,40 @@ namespace CryptoNote
       }
 
       if(local_template_ver != m_template_no) {
-        std::unique_lock<std::mutex> lk(m_template_lock);
-        b = m_template;
-        local_diff = m_diffic;
-        lk.unlock();
-
         local_template_ver = m_template_no;
+        job = std::atomic_load(&m_job);
+        if (job) {
+          blob = job->hashingBlob;
+        }
         nonce = m_starter_nonce + th_local_index;
       }
 
-      if(!local_template_ver)//no any set_block_template call
+      if(!job)//no any set_block_template call
       {
         logger(TRACE) << "Block template not set yet";
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
         continue;
       }
 
-      b.nonce = nonce;
+      // only the nonce changes between hashes, the rest of the blob is built once per template
+      std::memcpy(blob.data() + job->nonceOffset, &nonce, sizeof(nonce));
       Crypto::Hash h;
-      if (!m_stop && !get_block_longhash(context, b, h)) {
+      if (!m_stop && !get_block_longhash(context, job->block.majorVersion, blob, h)) {
         logger(ERROR) << "Failed to get block long hash";
         m_stop = true;
       }
 
-      if (!m_stop && check_hash(h, local_diff))
+      if (!m_stop && check_hash(h, job->difficulty))
       {
         //we lucky!
         ++m_config.current_extra_message_index;
 
-        logger(DEBUGGING) << "Found block for difficulty: " << local_diff;
+        logger(DEBUGGING) << "Found block for difficulty: " << job->difficulty;
         std::cout << BrightGreenMsg("Found Block for difficulty: ")
-                  << BrightMagentaMsg(std::to_string(local_diff)) << std::endl;
+                  << BrightMagentaMsg(std::to_string(job->difficulty)) << std::endl;
 
+        Block b = job->block;
+        b.nonce = nonce;
         if(!m_handler.handle_block_found(b)) {
           --m_config.current_extra_message_index;
         } else {
@@ -412,7 +437,7 @@ namespace CryptoNote
       }
 
       nonce += m_threads_total;
-      ++m_hashes;
+      hashes.fetch_add(1, std::memory_order_relaxed);
     }
     logger(DEBUGGING) << "Miner thread stopped ["<< th_local_index << "]";
     std::cout << GreenMsg("Miner thread stopped ")
@@ -8,8 +8,10 @@
 
 #include <atomic>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "CryptoNoteCore/CryptoNoteBasic.h"
 #include "CryptoNoteCore/Currency.h"
@@ -49,6 +51,19 @@ namespace CryptoNote {
     bool request_block_template();
     void  merge_hr();
 
+    // one block template generation, never modified after it is published
+    struct MiningJob {
+      Block block;
+      BinaryArray hashingBlob;
+      size_t nonceOffset;
+      difficulty_type difficulty;
+    };
+
+    // padded so that threads counting hashes do not share a cache line
+    struct alignas(64) HashCounter {
+      std::atomic<uint64_t> hashes{0};
+    };
+
     struct miner_config
     {
       uint64_t current_extra_message_index;
@@ -61,11 +76,10 @@ namespace CryptoNote {
     Logging::LoggerRef logger;
 
     std::atomic<bool> m_stop;
-    std::mutex m_template_lock;
-    Block m_template;
+    // swapped with std::atomic_store, worker threads pick up a new job when m_template_no changes
+    std::shared_ptr<const MiningJob> m_job;
     std::atomic<uint32_t> m_template_no;
     std::atomic<uint32_t> m_starter_nonce;
-    difficulty_type m_diffic;
 
     std::atomic<uint32_t> m_threads_total;
     std::atomic<int32_t> m_pausers_count;
@@ -82,7 +96,7 @@ namespace CryptoNote {
     miner_config m_config;
     std::string m_config_folder_path;
     std::atomic<uint64_t> m_last_hr_merge_time;
-    std::atomic<uint64_t> m_hashes;
+    std::shared_ptr<std::vector<HashCounter>> m_hashCounters;
     std::atomic<uint64_t> m_current_hash_rate;
     std::mutex m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
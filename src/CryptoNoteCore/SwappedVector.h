@@ -145,6 +145,11 @@ public:
   const_iterator begin();
   const_iterator end();
   const T& operator[](uint64_t index);
+  // Returns the cached item or nullptr, without reading the file.
+  const T* findCached(uint64_t index);
+  // Reads the serialized item as stored, bypassing the cache. Returns false if the read failed,
+  // the stream is left in the state it had before.
+  bool readRaw(uint64_t index, std::vector<uint8_t>& data);
   const T& front();
   const T& back();
   void clear();
@@ -291,6 +296,39 @@ template<class T> const T& SwappedVector<T>::operator[](uint64_t index) {
   return *item;
 }
 
+template<class T> const T* SwappedVector<T>::findCached(uint64_t index) {
+  auto itemIter = m_items.find(index);
+  if (itemIter == m_items.end()) {
+    return nullptr;
+  }
+
+  if (itemIter->second.cacheIter != --m_cache.end()) {
+    m_cache.splice(m_cache.end(), m_cache, itemIter->second.cacheIter);
+  }
+
+  ++m_cacheHits;
+  return &itemIter->second.item;
+}
+
+template<class T> bool SwappedVector<T>::readRaw(uint64_t index, std::vector<uint8_t>& data) {
+  if (index >= m_offsets.size() || !m_itemsFile) {
+    return false;
+  }
+
+  uint64_t itemEnd = index + 1 < m_offsets.size() ? m_offsets[index + 1] : m_itemsFileSize;
+  data.resize(itemEnd - m_offsets[index]);
+  m_itemsFile.seekg(m_offsets[index]);
+  m_itemsFile.read(reinterpret_cast<char*>(data.data()), data.size());
+  if (!m_itemsFile) {
+    // push_back and operator[] share the stream, a short read must not fail them
+    m_itemsFile.clear();
+    data.clear();
+    return false;
+  }
+
+  return true;
+}
+
 template<class T> const T& SwappedVector<T>::front() {
   return operator[](0);
 }
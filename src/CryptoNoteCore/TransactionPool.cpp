@@ -9,7 +9,10 @@
 #include "TransactionPool.h"
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <future>
+#include <thread>
 #include <vector>
 #include <unordered_set>
 
@@ -37,6 +40,26 @@ using namespace Logging;
 
 namespace CryptoNote {
 
+  namespace {
+
+    const uint8_t JOURNAL_ADD = 1;
+    const uint8_t JOURNAL_REMOVE = 2;
+    // the journal is rewritten once it holds this many records more than twice the pool
+    const uint64_t JOURNAL_COMPACTION_SLACK = 1000;
+    const uint32_t JOURNAL_MAX_RECORD_SIZE = 64 * 1024 * 1024;
+
+    BinaryArray makeJournalRecord(uint8_t type, const BinaryArray& payload) {
+      uint32_t size = static_cast<uint32_t>(payload.size());
+      BinaryArray record;
+      record.reserve(sizeof(type) + sizeof(size) + payload.size());
+      record.push_back(type);
+      record.insert(record.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
+      record.insert(record.end(), payload.begin(), payload.end());
+      return record;
+    }
+
+  }
+
   //---------------------------------------------------------------------------------
   // BlockTemplate
   //---------------------------------------------------------------------------------
@@ -65,6 +88,25 @@ namespace CryptoNote {
       return true;
     }
 
+    bool removeTransaction(const Crypto::Hash& txid, const Transaction& tx) {
+      auto it = std::find(m_txHashes.begin(), m_txHashes.end(), txid);
+      if (it == m_txHashes.end()) {
+        return false;
+      }
+
+      for (const auto& in : tx.inputs) {
+        if (in.type() == typeid(KeyInput)) {
+          m_keyImages.erase(boost::get<KeyInput>(in).keyImage);
+        } else if (in.type() == typeid(MultisignatureInput)) {
+          const auto& msig = boost::get<MultisignatureInput>(in);
+          m_usedOutputs.erase(std::make_pair(msig.amount, msig.outputIndex));
+        }
+      }
+
+      m_txHashes.erase(it);
+      return true;
+    }
+
     const std::vector<Crypto::Hash>& getTransactions() const {
       return m_txHashes;
     }
@@ -104,10 +146,25 @@ namespace CryptoNote {
     m_timeProvider(timeProvider),
     m_txCheckInterval(60, timeProvider),
     m_fee_index(boost::get<1>(m_transactions)),
-    logger(log, "txpool") {
+    logger(log, "txpool"),
+    m_maxPoolSize(parameters::CRYPTONOTE_MEMPOOL_MAX_SIZE),
+    m_poolSize(0),
+    m_poolFee(0),
+    m_evictedCount(0),
+    m_rejectedCount(0),
+    m_chainVersion(0),
+    m_readyCacheVersion(0),
+    m_feedId(Crypto::rand<uint64_t>() | 1),
+    m_feedSequence(0),
+    m_feedChainVersion(0),
+    m_journalRecords(0),
+    m_journalCompacting(false) {
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::~tx_memory_pool() {
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::add_tx(const Transaction &tx, const Crypto::Hash &id, uint64_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) {
+  bool tx_memory_pool::add_tx(const Transaction &tx, const Crypto::Hash &id, uint64_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height, const BlockInfo* verifiedInputs) {
     if (!check_inputs_types_supported(tx)) {
       tvc.m_verification_failed = true;
       return false;
@@ -158,6 +215,15 @@ namespace CryptoNote {
     //check key images for transaction if it is not kept by block
     if (!keptByBlock) {
       std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      if (isBelowEvictionFloor(id, blobSize, fee)) {
+        logger(DEBUGGING) << "Transaction " << id << " rejected, its fee per byte is too low for the full pool: fee = " << m_currency.formatAmount(fee) << ", size = " << blobSize;
+        ++m_rejectedCount;
+        tvc.m_verification_failed = false;
+        tvc.m_should_be_relayed = false;
+        tvc.m_added_to_pool = false;
+        return true;
+      }
+
       if (haveSpentInputs(tx)) {
         logger(DEBUGGING) << "Transaction with id= " << id << " used already spent inputs";
         std::cout << id << YellowMsg(" has already used its spent inputs.") << std::endl;
@@ -169,7 +235,13 @@ namespace CryptoNote {
     BlockInfo maxUsedBlock;
 
     // check inputs
-    bool inputsValid = m_validator.checkTransactionInputs(tx, maxUsedBlock);
+    bool inputsValid;
+    if (verifiedInputs != nullptr) {
+      maxUsedBlock = *verifiedInputs;
+      inputsValid = m_validator.checkVerifiedTransactionInputs(tx, maxUsedBlock);
+    } else {
+      inputsValid = m_validator.checkTransactionInputs(tx, maxUsedBlock);
+    }
 
     if (!inputsValid) {
       if (!keptByBlock) {
@@ -217,17 +289,10 @@ namespace CryptoNote {
       txd.maxUsedBlock = maxUsedBlock;
       txd.lastFailedBlock.clear();
 
-      auto txd_p = m_transactions.insert(std::move(txd));
-      if (!(txd_p.second)) {
+      if (!insertTransaction(std::move(txd), ttl.ttl)) {
         logger(ERROR, BRIGHT_RED) << "<< TransactionPool.cpp << " << "transaction already exists at inserting in memory pool";
         return false;
       }
-      m_paymentIdIndex.add(txd.tx);
-      m_timestampIndex.add(txd.receiveTime, txd.id);
-
-      if (ttl.ttl != 0) {
-        m_ttlIndex.emplace(std::make_pair(id, ttl.ttl));
-      }
     }
 
     tvc.m_added_to_pool = true;
@@ -238,19 +303,28 @@ namespace CryptoNote {
       return false;
 
     tvc.m_verification_failed = false;
+    const TransactionDetails& added = *m_transactions.find(id);
+    templateTransactionAdded(added);
+    recordChange(id);
+    writeJournalRecord(JOURNAL_ADD, toBinaryArray(added));
+    if (!evictTransactions(id)) {
+      tvc.m_added_to_pool = false;
+      tvc.m_should_be_relayed = false;
+    }
+
     //succeed
     return true;
   }
 
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block, uint32_t height) {
+  bool tx_memory_pool::add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block, uint32_t height, const BlockInfo* verifiedInputs) {
     Crypto::Hash h = NULL_HASH;
     uint64_t blobSize = 0;
     getObjectHash(tx, h, blobSize);
-    return add_tx(tx, h, blobSize, tvc, keeped_by_block, height);
+    return add_tx(tx, h, blobSize, tvc, keeped_by_block, height, verifiedInputs);
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::take_tx(const Crypto::Hash &id, Transaction &tx, uint64_t& blobSize, uint64_t& fee) {
+  bool tx_memory_pool::take_tx(const Crypto::Hash &id, Transaction &tx, uint64_t& blobSize, uint64_t& fee, BlockInfo& maxUsedBlock) {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
     auto it = m_transactions.find(id);
     if (it == m_transactions.end()) {
@@ -262,6 +336,7 @@ namespace CryptoNote {
     tx = txd.tx;
     blobSize = txd.blobSize;
     fee = txd.fee;
+    maxUsedBlock = txd.maxUsedBlock;
 
     removeTransaction(it);
     return true;
@@ -272,6 +347,84 @@ namespace CryptoNote {
     return m_transactions.size();
   }
   //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::getPoolSize() const {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    return m_poolSize;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::getPoolFee() const {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    return m_poolFee;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::getEvictedCount() const {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    return m_evictedCount;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::getRejectedCount() const {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    return m_rejectedCount;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::setMaxSize(uint64_t maxSize) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    m_maxPoolSize = maxSize;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::isBelowEvictionFloor(const Crypto::Hash& id, uint64_t blobSize, uint64_t fee) const {
+    if (m_poolSize + blobSize <= m_maxPoolSize) {
+      return false;
+    }
+
+    if (blobSize > m_maxPoolSize || m_fee_index.empty()) {
+      return true;
+    }
+
+    // every transaction evicted to make room must rank below this one, otherwise it would be evicted right away
+    TransactionDetails candidate;
+    candidate.id = id;
+    candidate.blobSize = blobSize;
+    candidate.fee = fee;
+    candidate.receiveTime = m_timeProvider.now();
+
+    uint64_t freed = 0;
+    for (auto it = m_fee_index.rbegin(); m_poolSize - freed + blobSize > m_maxPoolSize; ++it) {
+      if (it == m_fee_index.rend() || !TransactionPriorityComparator()(candidate, *it)) {
+        return true;
+      }
+
+      freed += it->blobSize;
+    }
+
+    return false;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::evictTransactions(const Crypto::Hash& keepId) {
+    // only transactions ranked below keepId may make room for it, if they are not enough it is refused instead
+    uint64_t below = 0;
+    for (auto it = m_fee_index.rbegin(); m_poolSize - below > m_maxPoolSize && it != m_fee_index.rend(); ++it) {
+      if (it->id == keepId) {
+        logger(DEBUGGING) << "Tx " << keepId << " rejected, the full tx pool has no cheaper transactions to evict for it";
+        removeTransaction(m_transactions.project<0>(std::prev(it.base())));
+        ++m_rejectedCount;
+        return false;
+      }
+
+      below += it->blobSize;
+    }
+
+    // pooled transactions only spend outputs from the blockchain, so evicting one never orphans another
+    while (m_poolSize > m_maxPoolSize && !m_fee_index.empty()) {
+      auto victim = std::prev(m_fee_index.end());
+      logger(DEBUGGING) << "Tx " << victim->id << " evicted from the full tx pool, fee: " << m_currency.formatAmount(victim->fee) << ", size: " << victim->blobSize;
+      removeTransaction(m_transactions.project<0>(victim));
+      ++m_evictedCount;
+    }
+
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::list<Transaction>& txs) const {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
     for (const auto& tx_vt : m_transactions) {
@@ -283,8 +436,7 @@ namespace CryptoNote {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
     std::unordered_set<Crypto::Hash> ready_tx_ids;
     for (const auto& tx : m_transactions) {
-      TransactionCheckInfo checkInfo(tx);
-      if (is_transaction_ready_to_go(tx.tx, checkInfo)) {
+      if (isTransactionReady(tx)) {
         ready_tx_ids.insert(tx.id);
       }
     }
@@ -305,11 +457,72 @@ namespace CryptoNote {
     deleted_tx_ids.assign(known_set.begin(), known_set.end());
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::getChangeFeedPosition(uint64_t& feedId, uint64_t& sequence) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    syncChangeFeedWithChain();
+    feedId = m_feedId;
+    sequence = m_feedSequence;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::getChangesSince(uint64_t feedId, uint64_t sequence, std::vector<Crypto::Hash>& new_tx_ids, std::vector<Crypto::Hash>& deleted_tx_ids) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    syncChangeFeedWithChain();
+    if (feedId != m_feedId || sequence > m_feedSequence || m_feedSequence - sequence > m_feedChanges.size()) {
+      return false;
+    }
+
+    // report the current state of every touched transaction, so a change is never lost between add and remove
+    std::unordered_set<Crypto::Hash> touched(m_feedChanges.end() - (m_feedSequence - sequence), m_feedChanges.end());
+    for (const auto& id : touched) {
+      auto it = m_transactions.find(id);
+      if (it != m_transactions.end() && isTransactionReady(*it)) {
+        new_tx_ids.push_back(id);
+      } else {
+        deleted_tx_ids.push_back(id);
+      }
+    }
+
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::recordChange(const Crypto::Hash& id) {
+    m_feedChanges.push_back(id);
+    if (m_feedChanges.size() > parameters::CRYPTONOTE_MEMPOOL_CHANGE_FEED_SIZE) {
+      m_feedChanges.pop_front();
+    }
+
+    ++m_feedSequence;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::syncChangeFeedWithChain() {
+    uint64_t chainVersion = m_chainVersion.load();
+    if (m_feedChainVersion == chainVersion) {
+      return;
+    }
+
+    m_feedChainVersion = chainVersion;
+    for (const auto& txd : m_transactions) {
+      bool ready = isTransactionReady(txd);
+      if (ready == (m_feedNotReady.count(txd.id) > 0)) {
+        if (ready) {
+          m_feedNotReady.erase(txd.id);
+        } else {
+          m_feedNotReady.insert(txd.id);
+        }
+
+        recordChange(txd.id);
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash& top_block_id) {
+    // called with the blockchain locked, so only bump the version and let readers notice it
+    ++m_chainVersion;
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash& top_block_id) {
+    ++m_chainVersion;
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -350,6 +563,24 @@ namespace CryptoNote {
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::isTransactionReady(const TransactionDetails& txd) const {
+    uint64_t chainVersion = m_chainVersion.load();
+    if (m_readyCacheVersion != chainVersion) {
+      m_readyCache.clear();
+      m_readyCacheVersion = chainVersion;
+    }
+
+    auto it = m_readyCache.find(txd.id);
+    if (it != m_readyCache.end()) {
+      return it->second;
+    }
+
+    TransactionCheckInfo checkInfo(txd);
+    bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
+    m_readyCache.emplace(txd.id, ready);
+    return ready;
+  }
+  //---------------------------------------------------------------------------------
   std::string tx_memory_pool::print_pool(bool short_format) const {
     std::stringstream ss;
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
@@ -390,12 +621,37 @@ namespace CryptoNote {
                                           uint32_t& height)                                      
   {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
-    total_size = 0;
-    fee = 0;
-    uint64_t max_total_size = (125 * median_size) / 100 - m_currency.minerTxBlobReservedSize();
-    max_total_size = std::min(max_total_size, maxCumulativeSize);
 
-    BlockTemplate blockTemplate;
+    uint64_t chainVersion = m_chainVersion.load();
+    if (!m_template.valid ||
+        m_template.chainVersion != chainVersion ||
+        m_template.medianSize != median_size ||
+        m_template.maxCumulativeSize != maxCumulativeSize) {
+      rebuildTemplate(chainVersion, median_size, maxCumulativeSize);
+    }
+
+    total_size = m_template.totalSize;
+    fee = m_template.fee;
+    bl.transactionHashes = m_template.transactions->getTransactions();
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::getMaxTotalSize(uint64_t median_size, uint64_t maxCumulativeSize) const {
+    uint64_t max_total_size = (125 * median_size) / 100 - m_currency.minerTxBlobReservedSize();
+    return std::min(max_total_size, maxCumulativeSize);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::rebuildTemplate(uint64_t chainVersion, uint64_t median_size, uint64_t maxCumulativeSize) {
+    uint64_t max_total_size = getMaxTotalSize(median_size, maxCumulativeSize);
+
+    m_template.valid = true;
+    m_template.complete = true;
+    m_template.chainVersion = chainVersion;
+    m_template.medianSize = median_size;
+    m_template.maxCumulativeSize = maxCumulativeSize;
+    m_template.totalSize = 0;
+    m_template.fee = 0;
+    m_template.transactions.reset(new BlockTemplate());
 
     for (auto it = m_fee_index.rbegin(); it != m_fee_index.rend(); ++it) 
     {
@@ -407,67 +663,136 @@ namespace CryptoNote {
       }
 
       uint64_t blockSizeLimit = (txd.fee == 0) ? median_size : max_total_size;
-      if (blockSizeLimit < total_size + txd.blobSize) 
+      if (blockSizeLimit < m_template.totalSize + txd.blobSize) 
       {
+        m_template.complete = false;
         continue;
       }
 
-      TransactionCheckInfo checkInfo(txd);
-      bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
+      if (!isTransactionReady(txd)) 
+      {
+        continue;
+      }
 
-      if (ready && blockTemplate.addTransaction(txd.id, txd.tx)) 
+      if (m_template.transactions->addTransaction(txd.id, txd.tx)) 
       {
-        total_size += txd.blobSize;
-        fee += txd.fee;
+        m_template.totalSize += txd.blobSize;
+        m_template.fee += txd.fee;
+      } else {
+        m_template.complete = false;
       }
     }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::templateTransactionAdded(const TransactionDetails& txd) {
+    if (!m_template.valid || m_ttlIndex.count(txd.id) > 0) {
+      return;
+    }
 
-    bl.transactionHashes = blockTemplate.getTransactions();
-    return true;
+    if (!m_template.complete || m_template.chainVersion != m_chainVersion.load()) {
+      m_template.valid = false;
+      return;
+    }
+
+    if (!isTransactionReady(txd)) {
+      return;
+    }
+
+    // appending is only equivalent to a rebuild if every transaction still fits
+    // whatever its position in the fee order, and the order of a block's
+    // transactions does not matter
+    uint64_t totalSize = m_template.totalSize + txd.blobSize;
+    uint64_t sizeLimit = std::min(m_template.medianSize, getMaxTotalSize(m_template.medianSize, m_template.maxCumulativeSize));
+    if (totalSize > sizeLimit || !m_template.transactions->addTransaction(txd.id, txd.tx)) {
+      m_template.valid = false;
+      return;
+    }
+
+    m_template.totalSize = totalSize;
+    m_template.fee += txd.fee;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::templateTransactionRemoved(const TransactionDetails& txd) {
+    m_readyCache.erase(txd.id);
+
+    // a transaction left out of the template never took space or inputs from the others
+    if (!m_template.valid || !m_template.transactions->removeTransaction(txd.id, txd.tx)) {
+      return;
+    }
+
+    if (!m_template.complete) {
+      m_template.valid = false;
+      return;
+    }
+
+    m_template.totalSize -= txd.blobSize;
+    m_template.fee -= txd.fee;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::init(const std::string& config_folder) {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
 
     m_config_folder = config_folder;
+    std::string journal_file_path = config_folder + "/" + m_currency.txPoolJournalFileName();
     std::string state_file_path = config_folder + "/" + m_currency.txPoolFileName();
     boost::system::error_code ec;
-    if (!boost::filesystem::exists(state_file_path, ec)) {
-      return true;
+    if (boost::filesystem::exists(journal_file_path, ec)) {
+      if (!replayJournal(journal_file_path)) {
+        logger(ERROR) << "<< TransactionPool.cpp << " << "Failed to replay memory pool journal " << journal_file_path;
+      }
+    } else if (boost::filesystem::exists(state_file_path, ec)) {
+      // pool saved by a version without the journal
+      if (!loadFromBinaryFile(*this, state_file_path)) {
+        logger(ERROR) << "<< TransactionPool.cpp << " << "Failed to load memory pool from file " << state_file_path;
+
+        m_transactions.clear();
+        m_spent_key_images.clear();
+        m_spentOutputs.clear();
+        m_template.valid = false;
+        m_readyCache.clear();
+        m_poolSize = 0;
+        m_poolFee = 0;
+
+        m_paymentIdIndex.clear();
+        m_timestampIndex.clear();
+        m_ttlIndex.clear();
+      } else {
+        buildIndices();
+      }
     }
 
-    if (!loadFromBinaryFile(*this, state_file_path)) {
-      logger(ERROR) << "<< TransactionPool.cpp << " << "Failed to load memory pool from file " << state_file_path;
-
-      m_transactions.clear();
-      m_spent_key_images.clear();
-      m_spentOutputs.clear();
+    removeExpiredTransactions();
+    evictTransactions(NULL_HASH);
 
-      m_paymentIdIndex.clear();
-      m_timestampIndex.clear();
-      m_ttlIndex.clear();
-    } else {
-      buildIndices();
+    if (!Tools::create_directories_if_necessary(m_config_folder) || !compactJournal()) {
+      logger(ERROR) << "<< TransactionPool.cpp << " << "Failed to write memory pool journal " << journal_file_path;
+      return false;
     }
 
-    removeExpiredTransactions();
-
-    // Ignore deserialization error
+    boost::filesystem::remove(state_file_path, ec);
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit() {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+
     if (!Tools::create_directories_if_necessary(m_config_folder)) {
       logger(DEBUGGING) << "Failed to create data directory: " << m_config_folder;
       std::cout << RedMsg("Failed to create data directory at ") << RedMsg(m_config_folder) << std::endl;
       return false;
     }
 
-    std::string state_file_path = m_config_folder + "/" + m_currency.txPoolFileName();
+    // leave the shortest journal possible for the next start
+    if (!compactJournal()) {
+      logger(DEBUGGING) << "Failed to write the memory pool journal to " << m_config_folder;
+      std::cout << RedMsg("Failed to write the memory pool journal to ") << RedMsg(m_config_folder) << std::endl;
+    }
 
-    if (!storeToBinaryFile(*this, state_file_path)) {
-      logger(DEBUGGING) << "Failed to serialize memory pool to file " << state_file_path;
-      std::cout << RedMsg("Failed to serialize the memory pool to file ") << RedMsg(state_file_path) << std::endl;
+    m_journal.close();
+    // the journal is all that survives a restart, make sure it reached the disk
+    std::error_code ec = Tools::sync_file(m_config_folder + "/" + m_currency.txPoolJournalFileName());
+    if (ec) {
+      logger(WARNING) << "Failed to flush the memory pool journal: " << ec.message();
     }
 
     m_paymentIdIndex.clear();
@@ -476,6 +801,190 @@ namespace CryptoNote {
 
     return true;
   }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::revalidate() {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+
+    std::vector<tx_container_t::iterator> transactions;
+    for (auto it = m_transactions.begin(); it != m_transactions.end(); ++it) {
+      transactions.push_back(it);
+    }
+
+    std::vector<BlockInfo> maxUsedBlocks(transactions.size());
+    std::unique_ptr<std::atomic<bool>[]> valid(new std::atomic<bool>[transactions.size()]);
+
+    // only the output lookups take the blockchain lock, so the signatures are checked on all cores
+    uint64_t workers = std::min(static_cast<uint64_t>(std::max(std::thread::hardware_concurrency(), 1u)), static_cast<uint64_t>(transactions.size()));
+    std::atomic<uint64_t> nextCheck(0);
+    std::vector<std::future<void>> results;
+    for (uint64_t w = 0; w < workers; ++w) {
+      results.push_back(std::async(std::launch::async, [&] {
+        for (uint64_t c = nextCheck++; c < transactions.size(); c = nextCheck++) {
+          TransactionInputsSnapshot snapshot;
+          const Transaction& tx = transactions[c]->tx;
+          valid[c] = m_validator.snapshotTransactionInputs(tx, snapshot) && m_validator.checkTransactionSignatures(tx, snapshot, nullptr);
+          maxUsedBlocks[c] = snapshot.maxUsedBlock;
+        }
+      }));
+    }
+
+    for (auto& result : results) {
+      result.wait();
+    }
+
+    uint64_t removed = 0;
+    for (size_t i = 0; i < transactions.size(); ++i) {
+      if (valid[i]) {
+        // readiness checks only confirm maxUsedBlock is still in the main chain from now on
+        m_transactions.modify(transactions[i], [&](TransactionDetails& txd) {
+          txd.maxUsedBlock = maxUsedBlocks[i];
+          txd.lastFailedBlock.clear();
+        });
+      } else if (!transactions[i]->keptByBlock) {
+        logger(DEBUGGING) << "Tx " << transactions[i]->id << " removed from tx pool, it is no longer valid";
+        removeTransaction(transactions[i]);
+        ++removed;
+      } else {
+        // the journaled maxUsedBlock would let pushBlock skip the signatures, so they are checked again there
+        m_transactions.modify(transactions[i], [](TransactionDetails& txd) {
+          txd.maxUsedBlock.clear();
+        });
+      }
+    }
+
+    logger(INFO) << "Memory pool revalidated: " << m_transactions.size() << " transactions kept, " << removed << " removed";
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::replayJournal(const std::string& path) {
+    std::ifstream journal(path, std::ios::binary);
+    if (!journal) {
+      return false;
+    }
+
+    for (;;) {
+      uint8_t type;
+      uint32_t size;
+      if (!journal.read(reinterpret_cast<char*>(&type), sizeof(type)) || !journal.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+        break;
+      }
+
+      BinaryArray payload(std::min(size, JOURNAL_MAX_RECORD_SIZE));
+      if (size > JOURNAL_MAX_RECORD_SIZE || !journal.read(reinterpret_cast<char*>(payload.data()), size)) {
+        // the last record of a crashed node may be incomplete
+        logger(WARNING) << "Memory pool journal ends with a truncated record, ignoring it";
+        break;
+      }
+
+      if (type == JOURNAL_ADD) {
+        TransactionDetails txd;
+        if (!fromBinaryArray(txd, payload)) {
+          logger(WARNING) << "Memory pool journal contains a corrupted record, ignoring the rest";
+          break;
+        }
+
+        std::vector<TransactionExtraField> txExtraFields;
+        parseTransactionExtra(txd.tx.extra, txExtraFields);
+        TransactionExtraTTL ttl;
+        if (!findTransactionExtraFieldByType(txExtraFields, ttl)) {
+          ttl.ttl = 0;
+        }
+
+        Crypto::Hash id = txd.id;
+        Transaction tx = txd.tx;
+        bool keptByBlock = txd.keptByBlock;
+        if (insertTransaction(std::move(txd), ttl.ttl) && !addTransactionInputs(id, tx, keptByBlock)) {
+          removeTransaction(m_transactions.find(id));
+        }
+      } else if (type == JOURNAL_REMOVE && size == sizeof(Crypto::Hash)) {
+        Crypto::Hash id;
+        std::copy(payload.begin(), payload.end(), id.data);
+        auto it = m_transactions.find(id);
+        if (it != m_transactions.end()) {
+          removeTransaction(it);
+        }
+      } else {
+        logger(WARNING) << "Memory pool journal contains an unknown record, ignoring the rest";
+        break;
+      }
+    }
+
+    logger(INFO) << "Memory pool journal replayed: " << m_transactions.size() << " transactions";
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::compactJournal() {
+    std::string path = m_config_folder + "/" + m_currency.txPoolJournalFileName();
+    std::string tempPath = path + ".tmp";
+
+    BinaryArray snapshot;
+    uint64_t records;
+    {
+      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      if (m_journalCompacting) {
+        return true;
+      }
+
+      for (const auto& txd : m_transactions) {
+        BinaryArray record = makeJournalRecord(JOURNAL_ADD, toBinaryArray(txd));
+        snapshot.insert(snapshot.end(), record.begin(), record.end());
+      }
+
+      records = m_transactions.size();
+      m_journalCompacting = true;
+      m_journalBacklog.clear();
+    }
+
+    // the pool keeps journaling to the old file meanwhile, its new records are collected in m_journalBacklog
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size());
+    file.close();
+    bool written = static_cast<bool>(file) && !Tools::sync_file(tempPath);
+
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    m_journalCompacting = false;
+    if (written && !m_journalBacklog.empty()) {
+      file.clear();
+      file.open(tempPath, std::ios::binary | std::ios::app);
+      for (const auto& record : m_journalBacklog) {
+        file.write(reinterpret_cast<const char*>(record.data()), record.size());
+      }
+
+      file.close();
+      written = static_cast<bool>(file) && !Tools::sync_file(tempPath);
+    }
+
+    records += m_journalBacklog.size();
+    m_journalBacklog.clear();
+
+    // closed for the rename, an open file cannot be replaced on Windows
+    m_journal.close();
+    m_journal.clear();
+    if (written && Tools::replace_file(tempPath, path)) {
+      written = false;
+    }
+
+    m_journal.open(path, std::ios::binary | std::ios::app);
+    if (written) {
+      m_journalRecords = records;
+    }
+
+    return written && static_cast<bool>(m_journal);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::writeJournalRecord(uint8_t type, const BinaryArray& payload) {
+    if (!m_journal.is_open()) {
+      return;
+    }
+
+    BinaryArray record = makeJournalRecord(type, payload);
+    m_journal.write(reinterpret_cast<const char*>(record.data()), record.size());
+    m_journal.flush();
+    ++m_journalRecords;
+
+    if (m_journalCompacting) {
+      m_journalBacklog.push_back(std::move(record));
+    }
+  }
 
 #define CURRENT_MEMPOOL_ARCHIVE_VER 1
 
@@ -505,6 +1014,8 @@ namespace CryptoNote {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
 
     if (s.type() == ISerializer::INPUT) {
+      m_template.valid = false;
+      m_readyCache.clear();
       m_transactions.clear();
       readSequence<TransactionDetails>(std::inserter(m_transactions, m_transactions.end()), "transactions", s);
     } else {
@@ -519,6 +1030,17 @@ namespace CryptoNote {
   //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle() {
     m_txCheckInterval.call([this](){ return removeExpiredTransactions(); });
+
+    bool compact;
+    {
+      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      compact = m_journal.is_open() && m_journalRecords > 2 * m_transactions.size() + JOURNAL_COMPACTION_SLACK;
+    }
+
+    // rewritten here rather than on the write that crosses the limit, so no pool or blockchain operation waits for the disk
+    if (compact && !compactJournal()) {
+      logger(ERROR) << "<< TransactionPool.cpp << " << "Failed to compact memory pool journal";
+    }
   }
 
   //---------------------------------------------------------------------------------
@@ -568,12 +1090,39 @@ namespace CryptoNote {
     return true;
   }
 
+  bool tx_memory_pool::insertTransaction(TransactionDetails&& txd, uint64_t ttl) {
+    auto txd_p = m_transactions.insert(std::move(txd));
+    if (!(txd_p.second)) {
+      return false;
+    }
+
+    const TransactionDetails& inserted = *txd_p.first;
+    m_paymentIdIndex.add(inserted.tx);
+    m_timestampIndex.add(inserted.receiveTime, inserted.id);
+    m_poolSize += inserted.blobSize;
+    m_poolFee += inserted.fee;
+
+    if (ttl != 0) {
+      m_ttlIndex.emplace(std::make_pair(inserted.id, ttl));
+    }
+
+    return true;
+  }
+
   tx_memory_pool::tx_container_t::iterator tx_memory_pool::removeTransaction(tx_memory_pool::tx_container_t::iterator i) {
     removeTransactionInputs(i->id, i->tx, i->keptByBlock);
     m_paymentIdIndex.remove(i->tx);
     m_timestampIndex.remove(i->receiveTime, i->id);
     m_ttlIndex.erase(i->id);
-    return m_transactions.erase(i);
+    m_poolSize -= i->blobSize;
+    m_poolFee -= i->fee;
+    templateTransactionRemoved(*i);
+    m_feedNotReady.erase(i->id);
+    recordChange(i->id);
+    Crypto::Hash id = i->id;
+    auto next = m_transactions.erase(i);
+    writeJournalRecord(JOURNAL_REMOVE, BinaryArray(id.data, id.data + sizeof(id.data)));
+    return next;
   }
 
   bool tx_memory_pool::removeTransactionInputs(const Crypto::Hash& tx_id, const Transaction& tx, bool keptByBlock) {
@@ -668,9 +1217,13 @@ namespace CryptoNote {
 
   void tx_memory_pool::buildIndices() {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    m_poolSize = 0;
+    m_poolFee = 0;
     for (auto it = m_transactions.begin(); it != m_transactions.end(); it++) {
       m_paymentIdIndex.add(it->tx);
       m_timestampIndex.add(it->receiveTime, it->id);
+      m_poolSize += it->blobSize;
+      m_poolFee += it->fee;
 
       std::vector<TransactionExtraField> txExtraFields;
       parseTransactionExtra(it->tx.extra, txExtraFields);
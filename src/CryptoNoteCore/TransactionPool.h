@@ -6,6 +6,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -37,6 +41,7 @@
 namespace CryptoNote {
 
   class ISerializer;
+  class BlockTemplate;
 
   class OnceInTimeInterval {
   public:
@@ -77,6 +82,7 @@ namespace CryptoNote {
       CryptoNote::ITransactionValidator& validator,
       CryptoNote::ITimeProvider& timeProvider,
       Logging::ILogger& log);
+    ~tx_memory_pool();
 
     bool addObserver(ITxPoolObserver* observer);
     bool removeObserver(ITxPoolObserver* observer);
@@ -84,12 +90,17 @@ namespace CryptoNote {
     // load/store operations
     bool init(const std::string& config_folder);
     bool deinit();
+    // checks every pooled transaction against the current chain, drops the invalid ones
+    void revalidate();
+    void setMaxSize(uint64_t maxSize);
 
     bool have_tx(const Crypto::Hash &id) const;
-    bool add_tx(const Transaction &tx, const Crypto::Hash &id, uint64_t blobSize, tx_verification_context& tvc, bool keeped_by_block, uint32_t height);
-    bool add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block, uint32_t height);
+    // verifiedInputs is the snapshot block the ring signatures were checked against, if they were
+    bool add_tx(const Transaction &tx, const Crypto::Hash &id, uint64_t blobSize, tx_verification_context& tvc, bool keeped_by_block, uint32_t height, const BlockInfo* verifiedInputs = nullptr);
+    bool add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block, uint32_t height, const BlockInfo* verifiedInputs = nullptr);
     //gets tx and remove it from pool
-    bool take_tx(const Crypto::Hash &id, Transaction &tx, uint64_t& blobSize, uint64_t& fee);
+    // maxUsedBlock is the block the ring signatures were checked against, empty if they were not
+    bool take_tx(const Crypto::Hash &id, Transaction &tx, uint64_t& blobSize, uint64_t& fee, BlockInfo& maxUsedBlock);
 
     bool on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash& top_block_id);
     bool on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash& top_block_id);
@@ -102,7 +113,19 @@ namespace CryptoNote {
 
     void get_transactions(std::list<Transaction>& txs) const;
     void get_difference(const std::vector<Crypto::Hash>& known_tx_ids, std::vector<Crypto::Hash>& new_tx_ids, std::vector<Crypto::Hash>& deleted_tx_ids) const;
+    // position of the change feed, feedId changes whenever the sequence numbers start over
+    void getChangeFeedPosition(uint64_t& feedId, uint64_t& sequence);
+    // transactions added or removed after sequence, split by whether they are now in the pool and ready;
+    // false if the feed no longer reaches back to sequence
+    bool getChangesSince(uint64_t feedId, uint64_t sequence, std::vector<Crypto::Hash>& new_tx_ids, std::vector<Crypto::Hash>& deleted_tx_ids);
     uint64_t get_transactions_count() const;
+    // total blob size of the pooled transactions
+    uint64_t getPoolSize() const;
+    // sum of the fees of the pooled transactions
+    uint64_t getPoolFee() const;
+    uint64_t getEvictedCount() const;
+    // transactions refused because their fee per byte was under the eviction floor of a full pool
+    uint64_t getRejectedCount() const;
     std::string print_pool(bool short_format) const;
     void on_idle();
 
@@ -179,12 +202,28 @@ namespace CryptoNote {
     bool haveSpentInputs(const Transaction& tx) const;
     bool removeTransactionInputs(const Crypto::Hash& id, const Transaction& tx, bool keptByBlock);
 
+    bool insertTransaction(TransactionDetails&& txd, uint64_t ttl);
     tx_container_t::iterator removeTransaction(tx_container_t::iterator i);
     bool removeExpiredTransactions();
+    bool isBelowEvictionFloor(const Crypto::Hash& id, uint64_t blobSize, uint64_t fee) const;
+    // false when keepId itself was dropped because only higher ranked transactions were left to evict
+    bool evictTransactions(const Crypto::Hash& keepId);
     bool is_transaction_ready_to_go(const Transaction& tx, TransactionCheckInfo& txd) const;
+    bool isTransactionReady(const TransactionDetails& txd) const;
+    uint64_t getMaxTotalSize(uint64_t median_size, uint64_t maxCumulativeSize) const;
+    void rebuildTemplate(uint64_t chainVersion, uint64_t median_size, uint64_t maxCumulativeSize);
+    void templateTransactionAdded(const TransactionDetails& txd);
+    void templateTransactionRemoved(const TransactionDetails& txd);
+    void recordChange(const Crypto::Hash& id);
+    void syncChangeFeedWithChain();
 
     void buildIndices();
 
+    // journal of pool admissions and removals, replayed on startup
+    bool replayJournal(const std::string& path);
+    bool compactJournal();
+    void writeJournalRecord(uint8_t type, const BinaryArray& payload);
+
     Tools::ObserverManager<ITxPoolObserver> m_observerManager;
     const CryptoNote::Currency& m_currency;
     OnceInTimeInterval m_txCheckInterval;
@@ -205,5 +244,44 @@ namespace CryptoNote {
     PaymentIdIndex m_paymentIdIndex;
     TimestampTransactionsIndex m_timestampIndex;
     std::unordered_map<Crypto::Hash, uint64_t> m_ttlIndex;
+
+    uint64_t m_maxPoolSize;
+    uint64_t m_poolSize;
+    uint64_t m_poolFee;
+    uint64_t m_evictedCount;
+    uint64_t m_rejectedCount;
+
+    // bumped on every block pushed or popped, outdates readiness and the cached template
+    std::atomic<uint64_t> m_chainVersion;
+    mutable std::unordered_map<Crypto::Hash, bool> m_readyCache;
+    mutable uint64_t m_readyCacheVersion;
+
+    struct CachedTemplate {
+      bool valid = false;
+      // no ready transaction was left out for size or a conflict, so pool changes can be applied in place
+      bool complete = false;
+      uint64_t chainVersion = 0;
+      uint64_t medianSize = 0;
+      uint64_t maxCumulativeSize = 0;
+      uint64_t totalSize = 0;
+      uint64_t fee = 0;
+      std::unique_ptr<BlockTemplate> transactions;
+    };
+
+    CachedTemplate m_template;
+
+    const uint64_t m_feedId;
+    uint64_t m_feedSequence;
+    // ids of the transactions added or removed by the last m_feedChanges.size() changes, oldest first
+    std::deque<Crypto::Hash> m_feedChanges;
+    // pooled transactions not ready for the chain at m_feedChainVersion, a block can flip them without a pool change
+    std::unordered_set<Crypto::Hash> m_feedNotReady;
+    uint64_t m_feedChainVersion;
+
+    std::ofstream m_journal;
+    uint64_t m_journalRecords;
+    // set while compactJournal writes the new file, records journaled meanwhile are kept to be appended to it
+    bool m_journalCompacting;
+    std::vector<BinaryArray> m_journalBacklog;
   };
 }
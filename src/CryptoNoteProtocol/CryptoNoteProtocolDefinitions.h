@@ -198,4 +198,40 @@ namespace CryptoNote
     const static int ID = BC_COMMANDS_POOL_BASE + 8;
     typedef NOTIFY_REQUEST_TX_POOL_request request;
   };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_HEADERS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 9;
+
+    struct request
+    {
+      std::vector<Crypto::Hash> block_ids; /* same layout as NOTIFY_REQUEST_CHAIN, optionally prefixed with the last validated header id */
+
+      void serialize(ISerializer& s) {
+        serializeAsBinary(block_ids, "block_ids", s);
+      }
+    };
+  };
+
+  struct NOTIFY_RESPONSE_HEADERS_request
+  {
+    uint32_t start_height;
+    uint32_t total_height;
+    std::vector<std::string> headers; /* block hashing blobs of the blocks following start_height */
+
+    void serialize(ISerializer& s) {
+      KV_MEMBER(start_height)
+      KV_MEMBER(total_height)
+      KV_MEMBER(headers)
+    }
+  };
+
+  struct NOTIFY_RESPONSE_HEADERS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+    typedef NOTIFY_RESPONSE_HEADERS_request request;
+  };
 }
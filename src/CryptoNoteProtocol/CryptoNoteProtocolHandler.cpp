@@ -8,10 +8,12 @@
 
 #include "CryptoNoteProtocolHandler.h"
 
+#include <ctime>
 #include <future>
 #include <boost/scope_exit.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <System/Dispatcher.h>
+#include <System/RemoteContext.h>
 
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
@@ -53,6 +55,10 @@ CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency &currency, S
   m_stop(false),
   m_observedHeight(0),
   m_peersCount(0),
+  m_headerChainStart(0),
+  m_nextBodyHeight(0),
+  m_bodySpansInFlight(0),
+  m_applyingBlocks(false),
   logger(log, "protocol") {
 
   if (!m_p2p)
@@ -80,6 +86,14 @@ void CryptoNoteProtocolHandler::onConnectionOpened(CryptoNoteConnectionContext &
 
 void CryptoNoteProtocolHandler::onConnectionClosed(CryptoNoteConnectionContext &context)
 {
+  if (context.m_body_span_count != 0)
+  {
+    // hand the bodies this peer was fetching over to the next synchronizing connection
+    m_bodyRetrySpans.emplace_back(context.m_body_span_start, context.m_body_span_count);
+    --m_bodySpansInFlight;
+    context.m_body_span_count = 0;
+  }
+
   bool updated = false;
   {
     std::lock_guard<std::mutex> lock(m_observedHeightMutex);
@@ -118,10 +132,14 @@ bool CryptoNoteProtocolHandler::start_sync(CryptoNoteConnectionContext &context)
     assert(context.m_needed_objects.empty());
     assert(context.m_requested_objects.empty());
 
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    if (context.version >= P2PProtocolVersion::V2)
+    {
+      requestHeaders(context);
+    }
+    else
+    {
+      requestChain(context);
+    }
   }
 
   return true;
@@ -281,6 +299,8 @@ int CryptoNoteProtocolHandler::handleCommand(bool is_notify, int command, const
     HANDLE_NOTIFY(NOTIFY_REQUEST_CHAIN, &CryptoNoteProtocolHandler::handle_request_chain)
     HANDLE_NOTIFY(NOTIFY_RESPONSE_CHAIN_ENTRY, &CryptoNoteProtocolHandler::handle_response_chain_entry)
     HANDLE_NOTIFY(NOTIFY_REQUEST_TX_POOL, &CryptoNoteProtocolHandler::handleRequestTxPool)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_HEADERS, &CryptoNoteProtocolHandler::handle_request_headers)
+    HANDLE_NOTIFY(NOTIFY_RESPONSE_HEADERS, &CryptoNoteProtocolHandler::handle_response_headers)
 
   default:
     handled = false;
@@ -339,10 +359,14 @@ int CryptoNoteProtocolHandler::handle_notify_new_block(int command, NOTIFY_NEW_B
   else if (bvc.m_marked_as_orphaned)
   {
     context.m_state = CryptoNoteConnectionContext::state_synchronizing;
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    if (context.version >= P2PProtocolVersion::V2)
+    {
+      requestHeaders(context);
+    }
+    else
+    {
+      requestChain(context);
+    }
   }
 
   return 1;
@@ -410,6 +434,9 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
   context.m_remote_blockchain_height = arg.current_blockchain_height;
 
+  // bodies of a validated header chain may arrive out of order from several peers
+  bool headersFirst = context.m_body_span_count != 0;
+
   uint64_t count = 0;
   std::vector<Crypto::Hash> block_hashes;
   block_hashes.reserve(arg.blocks.size());
@@ -433,7 +460,7 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
     //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
     auto blockHash = get_block_hash(b);
-    if (count == 2) {
+    if (count == 2 && !headersFirst) {
       if (m_core.have_block(blockHash)) {
         context.m_state = CryptoNoteConnectionContext::state_idle;
         context.m_needed_objects.clear();
@@ -478,6 +505,29 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
     return 1;
   }
 
+  if (headersFirst) {
+    for (uint64_t i = 0; i < parsed_blocks.size(); ++i) {
+      auto heightIt = m_headerHeights.find(block_hashes[i]);
+      if (heightIt != m_headerHeights.end()) {
+        m_downloadedBlocks[heightIt->second] = std::move(parsed_blocks[i]);
+      }
+    }
+
+    context.m_body_span_count = 0;
+    --m_bodySpansInFlight;
+
+    int result = applyDownloadedBlocks(context);
+    if (result != 0) {
+      return result;
+    }
+
+    if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
+      request_missing_objects(context, true);
+    }
+
+    return 1;
+  }
+
   uint32_t height;
   Crypto::Hash top;
   {
@@ -583,6 +633,17 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
 
 bool CryptoNoteProtocolHandler::on_idle()
 {
+  // a peer sitting on its span holds back every body above it, drop it so onConnectionClosed hands the span over
+  time_t now = time(nullptr);
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext &context, uint64_t peerId) {
+    if (context.m_body_span_count != 0 && context.m_state != CryptoNoteConnectionContext::state_shutdown &&
+        now - context.m_body_span_requested > static_cast<time_t>(BLOCKS_SYNCHRONIZING_SPAN_TIMEOUT))
+    {
+      logger(Logging::INFO) << context << "Block bodies from height " << context.m_body_span_start << " not received in time, dropping connection";
+      m_p2p->drop_connection(context);
+    }
+  });
+
   return m_core.on_idle();
 }
 
@@ -614,6 +675,11 @@ int CryptoNoteProtocolHandler::handle_request_chain(int command, NOTIFY_REQUEST_
 
 bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext &context, bool check_having_blocks)
 {
+  if (context.version >= P2PProtocolVersion::V2 && context.m_needed_objects.empty())
+  {
+    return requestMissingBodies(context);
+  }
+
   if (context.m_needed_objects.size())
   {
     //we know objects that we need, request this objects
@@ -636,11 +702,7 @@ bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionCont
   }
   else if (context.m_last_response_height < context.m_remote_blockchain_height - 1)
   { //we have to fetch more objects ids, request blockchain entry
-
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    requestChain(context);
   }
   else
   {
@@ -659,15 +721,220 @@ bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionCont
       return false;
     }
 
-    requestMissingPoolTransactions(context);
+    finishSynchronization(context);
+  }
+  return true;
+}
+
+void CryptoNoteProtocolHandler::finishSynchronization(CryptoNoteConnectionContext &context)
+{
+  requestMissingPoolTransactions(context);
+
+  context.m_state = CryptoNoteConnectionContext::state_normal;
+  logger(Logging::INFO, Logging::BRIGHT_GREEN) << "<< CryptonoteProtocolHandler.cpp << " << context << "Synchronization complete";
+  on_connection_synchronized();
+}
+
+void CryptoNoteProtocolHandler::requestChain(CryptoNoteConnectionContext &context)
+{
+  NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+  r.block_ids = m_core.buildSparseChain();
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
+  post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+}
 
-    context.m_state = CryptoNoteConnectionContext::state_normal;
-    logger(Logging::INFO, Logging::BRIGHT_GREEN) << "<< CryptonoteProtocolHandler.cpp << " << context << "Synchronization complete";
-    on_connection_synchronized();
+void CryptoNoteProtocolHandler::requestHeaders(CryptoNoteConnectionContext &context)
+{
+  NOTIFY_REQUEST_HEADERS::request r = boost::value_initialized<NOTIFY_REQUEST_HEADERS::request>();
+  r.block_ids = m_core.buildSparseChain();
+  if (!m_headerChain.empty())
+  {
+    // continue after the headers we have already validated if the peer knows them
+    r.block_ids.insert(r.block_ids.begin(), m_headerTail.id);
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_HEADERS: m_block_ids.size()=" << r.block_ids.size();
+  post_notify<NOTIFY_REQUEST_HEADERS>(*m_p2p, r, context);
+}
+
+bool CryptoNoteProtocolHandler::requestMissingBodies(CryptoNoteConnectionContext &context)
+{
+  if (requestBodySpan(context))
+  {
+    return true;
   }
+
+  uint32_t knownHeight = m_headerChain.empty() ? get_current_blockchain_height() : m_headerTail.height;
+  if (knownHeight + 1 < context.m_remote_blockchain_height)
+  {
+    requestHeaders(context);
+    return true;
+  }
+
+  completeBodyDownload(context);
   return true;
 }
 
+bool CryptoNoteProtocolHandler::requestBodySpan(CryptoNoteConnectionContext &context)
+{
+  if (context.m_body_span_count != 0)
+  {
+    return true;
+  }
+
+  while (!m_headerChain.empty())
+  {
+    uint32_t start = 0;
+    uint32_t count = 0;
+
+    // spans abandoned by dropped peers go first, never ask for more than the peer has
+    for (auto it = m_bodyRetrySpans.begin(); it != m_bodyRetrySpans.end(); ++it)
+    {
+      if (it->first + it->second <= context.m_remote_blockchain_height)
+      {
+        start = it->first;
+        count = it->second;
+        m_bodyRetrySpans.erase(it);
+        break;
+      }
+    }
+
+    if (count == 0)
+    {
+      uint32_t end = std::min(m_headerChainStart + static_cast<uint32_t>(m_headerChain.size()), context.m_remote_blockchain_height);
+      if (m_nextBodyHeight >= end)
+      {
+        return false;
+      }
+
+      // bodies waiting for a missing span are held in memory, let the peers fetching it catch up first
+      if (m_downloadedBlocks.size() >= BLOCKS_SYNCHRONIZING_BUFFER_MAX_COUNT)
+      {
+        logger(DEBUGGING) << context << "Downloaded block buffer is full, not requesting more bodies";
+        return false;
+      }
+
+      start = m_nextBodyHeight;
+      count = static_cast<uint32_t>(std::min<uint64_t>(end - start, BLOCKS_SYNCHRONIZING_DEFAULT_COUNT));
+      m_nextBodyHeight += count;
+    }
+
+    NOTIFY_REQUEST_GET_OBJECTS::request req;
+    for (uint32_t height = start; height < start + count; ++height)
+    {
+      const Crypto::Hash &id = m_headerChain[height - m_headerChainStart];
+      if (!m_core.have_block(id))
+      {
+        req.blocks.push_back(id);
+        context.m_requested_objects.insert(id);
+      }
+    }
+
+    if (req.blocks.empty())
+    {
+      continue;
+    }
+
+    context.m_body_span_start = start;
+    context.m_body_span_count = count;
+    context.m_body_span_requested = time(nullptr);
+    ++m_bodySpansInFlight;
+
+    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", start height=" << start;
+    post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+    return true;
+  }
+
+  return false;
+}
+
+void CryptoNoteProtocolHandler::completeBodyDownload(CryptoNoteConnectionContext &context)
+{
+  if (get_current_blockchain_height() + 1 >= context.m_remote_blockchain_height)
+  {
+    finishSynchronization(context);
+    return;
+  }
+
+  // the rest of the header chain is being downloaded by other peers, timed sync will wake this connection up again
+  context.m_state = CryptoNoteConnectionContext::state_idle;
+  logger(DEBUGGING) << context << "Connection set to idle state.";
+}
+
+int CryptoNoteProtocolHandler::applyDownloadedBlocks(CryptoNoteConnectionContext &context)
+{
+  if (m_applyingBlocks)
+  {
+    // another connection is already draining the queue and will pick these blocks up
+    return 0;
+  }
+
+  m_applyingBlocks = true;
+  BOOST_SCOPE_EXIT_ALL(this) { m_applyingBlocks = false; };
+
+  std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
+
+  uint32_t height;
+  Crypto::Hash top;
+  while (!m_stop)
+  {
+    m_core.get_blockchain_top(height, top);
+
+    // bodies relayed by other means may already be on the chain
+    while (!m_downloadedBlocks.empty() && m_downloadedBlocks.begin()->first <= height)
+    {
+      m_downloadedBlocks.erase(m_downloadedBlocks.begin());
+    }
+
+    std::vector<parsed_block_entry> ready;
+    for (auto it = m_downloadedBlocks.begin(); it != m_downloadedBlocks.end() && it->first == height + 1 + ready.size(); it = m_downloadedBlocks.erase(it))
+    {
+      ready.push_back(std::move(it->second));
+    }
+
+    if (ready.empty())
+    {
+      break;
+    }
+
+    m_core.pause_mining();
+    BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
+
+    int result = processObjects(context, ready);
+    if (result != 0)
+    {
+      if (context.m_state == CryptoNoteConnectionContext::state_shutdown)
+      {
+        // body matched a validated header yet failed full verification, the header chain can't be trusted
+        logger(Logging::INFO) << context << "Block body failed verification, discarding validated header chain";
+        resetHeaderChain();
+      }
+
+      return result;
+    }
+  }
+
+  m_core.get_blockchain_top(height, top);
+  logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
+
+  if (!m_headerChain.empty() && height >= m_headerTail.height && m_bodySpansInFlight == 0)
+  {
+    resetHeaderChain();
+  }
+
+  return 0;
+}
+
+void CryptoNoteProtocolHandler::resetHeaderChain()
+{
+  m_headerChain.clear();
+  m_headerHeights.clear();
+  m_downloadedBlocks.clear();
+  m_bodyRetrySpans.clear();
+  m_headerChainStart = 0;
+  m_nextBodyHeight = 0;
+}
+
 bool CryptoNoteProtocolHandler::on_connection_synchronized()
 {
   bool val_expected = false;
@@ -766,6 +1033,156 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
   return 1;
 }
 
+int CryptoNoteProtocolHandler::handle_request_headers(int command, NOTIFY_REQUEST_HEADERS::request &arg, CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_HEADERS: m_block_ids.size()=" << arg.block_ids.size();
+
+  if (arg.block_ids.empty() || arg.block_ids.back() != m_core.getBlockIdByHeight(0))
+  {
+    logger(Logging::ERROR) << context << "Failed to handle NOTIFY_REQUEST_HEADERS. block_ids is empty or doesn't end with genesis block ID";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  NOTIFY_RESPONSE_HEADERS::request r;
+  std::vector<Crypto::Hash> blockIds = m_core.findBlockchainSupplement(arg.block_ids, BLOCK_HEADERS_SYNCHRONIZING_DEFAULT_COUNT + 1, r.total_height, r.start_height);
+
+  // the first id is the common block the peer already has
+  for (size_t i = 1; i < blockIds.size(); ++i)
+  {
+    Block block;
+    BinaryArray hashingBlob;
+    if (!m_core.getBlockByHash(blockIds[i], block) || !get_block_hashing_blob(block, hashingBlob))
+    {
+      logger(Logging::ERROR) << context << "Failed to get header of block " << blockIds[i];
+      break;
+    }
+
+    r.headers.push_back(asString(hashingBlob));
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_RESPONSE_HEADERS: m_start_height=" << r.start_height << ", m_total_height=" << r.total_height << ", headers.size()=" << r.headers.size();
+  post_notify<NOTIFY_RESPONSE_HEADERS>(*m_p2p, r, context);
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handle_response_headers(int command, NOTIFY_RESPONSE_HEADERS::request &arg, CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_HEADERS: headers.size()=" << arg.headers.size()
+                         << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height;
+
+  if (context.m_state != CryptoNoteConnectionContext::state_synchronizing)
+  {
+    return 1;
+  }
+
+  if (arg.headers.size() > BLOCK_HEADERS_SYNCHRONIZING_DEFAULT_COUNT || arg.start_height + arg.headers.size() >= std::max<uint64_t>(arg.total_height, 1))
+  {
+    logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_HEADERS, with \r\nm_total_height=" << arg.total_height
+                           << "\r\nm_start_height=" << arg.start_height << "\r\nheaders.size()=" << arg.headers.size() << ", dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  context.m_remote_blockchain_height = arg.total_height;
+  context.m_last_response_height = arg.start_height + static_cast<uint32_t>(arg.headers.size());
+
+  // skip headers another connection has already validated
+  std::vector<BinaryArray> hashingBlobs;
+  for (const std::string &header : arg.headers)
+  {
+    BinaryArray hashingBlob = asBinaryArray(header);
+    if (hashingBlobs.empty())
+    {
+      Crypto::Hash blockId = getObjectHash(hashingBlob);
+      if (m_headerHeights.count(blockId) != 0 || m_core.have_block(blockId))
+      {
+        continue;
+      }
+    }
+
+    hashingBlobs.push_back(std::move(hashingBlob));
+  }
+
+  if (hashingBlobs.empty())
+  {
+    if (!requestBodySpan(context))
+    {
+      completeBodyDownload(context);
+    }
+
+    return 1;
+  }
+
+  BlockHeader firstHeader;
+  if (!get_block_header_from_hashing_blob(hashingBlobs.front(), firstHeader))
+  {
+    logger(Logging::ERROR) << context << "sent unparsable block header, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  BlockHeaderChainTail tail;
+  if (!m_headerChain.empty() && firstHeader.previousBlockHash == m_headerTail.id)
+  {
+    tail = m_headerTail;
+  }
+  else if (!m_headerChain.empty() || !m_core.getBlockHeaderChainTail(firstHeader.previousBlockHash, tail))
+  {
+    // the peer follows another branch than the validated header chain, let block verification sort it out
+    logger(DEBUGGING) << context << "Block headers don't extend the validated header chain, requesting chain entry";
+    requestChain(context);
+    return 1;
+  }
+
+  Crypto::Hash startId = tail.id;
+  bool extendsHeaderChain = !m_headerChain.empty();
+  std::vector<Crypto::Hash> blockIds;
+  bool valid;
+  {
+    // proof of work checks run off the dispatcher thread
+    System::RemoteContext<bool> validation(m_dispatcher, [&] { return m_core.checkBlockHeaders(hashingBlobs, tail, blockIds); });
+    valid = validation.get();
+  }
+
+  if (!valid)
+  {
+    logger(Logging::INFO) << context << "sent invalid block headers, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  if (m_stop || context.m_state != CryptoNoteConnectionContext::state_synchronizing)
+  {
+    return 1;
+  }
+
+  if (extendsHeaderChain != !m_headerChain.empty() || (extendsHeaderChain && m_headerTail.id != startId))
+  {
+    // header chain moved on while we were validating, ask again from its new tail
+    requestHeaders(context);
+    return 1;
+  }
+
+  if (m_headerChain.empty())
+  {
+    m_headerChainStart = tail.height + 1 - static_cast<uint32_t>(blockIds.size());
+    m_nextBodyHeight = m_headerChainStart;
+  }
+
+  for (const Crypto::Hash &blockId : blockIds)
+  {
+    m_headerHeights[blockId] = m_headerChainStart + static_cast<uint32_t>(m_headerChain.size());
+    m_headerChain.push_back(blockId);
+  }
+
+  m_headerTail = std::move(tail);
+  logger(DEBUGGING) << context << "Validated block headers up to height " << m_headerTail.height;
+
+  request_missing_objects(context, false);
+  return 1;
+}
+
 int CryptoNoteProtocolHandler::handleRequestTxPool(int command, NOTIFY_REQUEST_TX_POOL::request &arg,
                                                    CryptoNoteConnectionContext &context)
 {
@@ -7,6 +7,9 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
+#include <map>
+#include <unordered_map>
 
 #include <Common/ObserverManager.h>
 
@@ -83,6 +86,8 @@ namespace CryptoNote
     int handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, CryptoNoteConnectionContext& context);
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, CryptoNoteConnectionContext& context);
     int handleRequestTxPool(int command, NOTIFY_REQUEST_TX_POOL::request& arg, CryptoNoteConnectionContext& context);
+    int handle_request_headers(int command, NOTIFY_REQUEST_HEADERS::request& arg, CryptoNoteConnectionContext& context);
+    int handle_response_headers(int command, NOTIFY_RESPONSE_HEADERS::request& arg, CryptoNoteConnectionContext& context);
 
     //----------------- i_cryptonote_protocol ----------------------------------
     virtual void relay_block(NOTIFY_NEW_BLOCK::request& arg) override;
@@ -95,6 +100,14 @@ namespace CryptoNote
     void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext& context);
     void recalculateMaxObservedHeight(const CryptoNoteConnectionContext& context);
     int processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks);
+    void requestChain(CryptoNoteConnectionContext& context);
+    void requestHeaders(CryptoNoteConnectionContext& context);
+    bool requestMissingBodies(CryptoNoteConnectionContext& context);
+    bool requestBodySpan(CryptoNoteConnectionContext& context);
+    void completeBodyDownload(CryptoNoteConnectionContext& context);
+    int applyDownloadedBlocks(CryptoNoteConnectionContext& context);
+    void resetHeaderChain();
+    void finishSynchronization(CryptoNoteConnectionContext& context);
     Logging::LoggerRef logger;
 
   private:
@@ -113,5 +126,16 @@ namespace CryptoNote
 
     std::atomic<uint64_t> m_peersCount;
     Tools::ObserverManager<ICryptoNoteProtocolObserver> m_observerManager;
+
+    // headers-first synchronization state, shared by all synchronizing connections
+    BlockHeaderChainTail m_headerTail;
+    uint32_t m_headerChainStart;
+    std::vector<Crypto::Hash> m_headerChain;
+    std::unordered_map<Crypto::Hash, uint32_t> m_headerHeights;
+    uint32_t m_nextBodyHeight;
+    uint32_t m_bodySpansInFlight;
+    std::deque<std::pair<uint32_t, uint32_t>> m_bodyRetrySpans;
+    std::map<uint32_t, parsed_block_entry> m_downloadedBlocks;
+    bool m_applyingBlocks;
   };
 }
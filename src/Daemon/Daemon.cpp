@@ -27,6 +27,7 @@
 #include "P2p/NetNodeConfig.h"
 #include "Rpc/RpcServer.h"
 #include "Rpc/RpcServerConfig.h"
+#include "Rpc/WorkServer.h"
 #include "version.h"
 
 #include "Common/ColouredMsg.h"
@@ -34,6 +35,7 @@
 #include <Logging/LoggerManager.h>
 
 #include <algorithm>
+#include <thread>
 
 using Common::JsonValue;
 using namespace CryptoNote;
@@ -55,6 +57,8 @@ namespace
   const command_line::arg_descriptor<bool>        arg_print_genesis_tx = { "print-genesis-tx", "Prints genesis' block tx hex to insert it to config and exits" };
   const command_line::arg_descriptor<std::vector<std::string>> arg_enable_cors = { "enable-cors", "Adds header 'Access-Control-Allow-Origin' to the daemon's RPC responses. Uses the value as domain. Use * for all" };
   const command_line::arg_descriptor<bool>        arg_blockexplorer_on = {"enable-blockexplorer", "Enable blockchain explorer RPC", false};
+  const command_line::arg_descriptor<uint32_t>    arg_stack_size = {"coroutine-stack-size", "Stack size of each network coroutine in KiB (Linux only)", 64};
+  const command_line::arg_descriptor<uint32_t>    arg_max_pooled_stacks = {"max-pooled-stacks", "Idle coroutine stacks kept for reuse (Linux only)", 128};
 }
 
 bool command_line_preprocessor(const boost::program_options::variables_map& vm, LoggerRef& logger);
@@ -112,6 +116,8 @@ int main(int argc, char* argv[]) {
     command_line::add_arg(desc_cmd_sett, arg_print_genesis_tx);
     command_line::add_arg(desc_cmd_sett, arg_enable_cors);
     command_line::add_arg(desc_cmd_sett, arg_blockexplorer_on);
+    command_line::add_arg(desc_cmd_sett, arg_stack_size);
+    command_line::add_arg(desc_cmd_sett, arg_max_pooled_stacks);
 
     RpcServerConfig::initOptions(desc_cmd_sett);
     CoreConfig::initOptions(desc_cmd_sett);
@@ -234,6 +240,11 @@ int main(int argc, char* argv[]) {
     }
 
     System::Dispatcher dispatcher;
+#ifdef __linux__
+    dispatcher.setStackSize(static_cast<size_t>(command_line::get_arg(vm, arg_stack_size)) * 1024);
+    dispatcher.setMaxPooledStacks(command_line::get_arg(vm, arg_max_pooled_stacks));
+#endif
+    ccore.setSignatureWorkers(dispatcher, std::max(std::thread::hardware_concurrency(), 1u));
 
     CryptoNote::CryptoNoteProtocolHandler cprotocol(currency, dispatcher, ccore, nullptr, logManager);
     CryptoNote::NodeServer p2psrv(dispatcher, cprotocol, logManager);
@@ -297,12 +308,29 @@ int main(int argc, char* argv[]) {
       }
     }
  
+    rpcServer.setWorkerThreads(rpcConfig.workerThreads);
+    rpcServer.setMaxBatchSize(rpcConfig.maxBatchSize);
+    rpcServer.setTemplateFeeThreshold(rpcConfig.templateFeeThreshold);
     rpcServer.start(rpcConfig.bindIp, rpcConfig.bindPort);
 	  rpcServer.enableCors(command_line::get_arg(vm, arg_enable_cors));
 
     logger(DEBUGGING) << "Core rpc server started ok";
     std::cout << BrightGreenMsg("Core RPC Server started on: ") << BrightMagentaMsg(rpcConfig.getBindAddress()) << std::endl;
 
+    std::unique_ptr<WorkServer> workServer;
+    if (rpcConfig.workServerPort != 0) {
+      workServer.reset(new WorkServer(dispatcher, logManager, ccore));
+      if (!workServer->setMinerAddress(rpcConfig.workServerAddress)) {
+        logger(ERROR, BRIGHT_RED) << "Work server address " << rpcConfig.workServerAddress << " has wrong format";
+        rpcServer.stop();
+        return 1;
+      }
+
+      workServer->setShareDifficulty(rpcConfig.workServerShareDifficulty);
+      workServer->start(rpcConfig.bindIp, rpcConfig.workServerPort);
+      std::cout << BrightGreenMsg("Work server started on: ") << BrightMagentaMsg(rpcConfig.bindIp + ":" + std::to_string(rpcConfig.workServerPort)) << std::endl;
+    }
+
     DaemonCommandsHandler dch(ccore, p2psrv, logManager, &rpcServer);
 
     // start components
@@ -327,6 +355,9 @@ int main(int argc, char* argv[]) {
     logger(DEBUGGING) << "Stopping core rpc server...";
     std::cout << GreenMsg("Core RPC Server has now stopped.") << std::endl;
     rpcServer.stop();
+    if (workServer) {
+      workServer->stop();
+    }
 
     //deinitialize components
     logger(DEBUGGING) << "Deinitializing core...";
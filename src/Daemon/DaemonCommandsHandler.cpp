@@ -106,6 +106,7 @@ bool DaemonCommandsHandler::status(const std::vector<std::string>& args) {
   statusTable.add_row({"Incoming", std::to_string(resp.incoming_connections_count) + " connections"});
   statusTable.add_row({"Outgoing", std::to_string(resp.outgoing_connections_count) + " connections"});
   statusTable.add_row({"Uptime", uptimeDay + "d " + uptimeHrs + "h " + uptimeMin + "m " + uptimeSec + "s"});
+  statusTable.add_row({"RPC Cache", std::to_string(m_prpc_server->getCacheHits()) + " hits, " + std::to_string(m_prpc_server->getCacheMisses()) + " misses"});
 
   /* format statusTable */
   statusTable.column(0).format().font_align(FontAlign::center).font_color(Color::green);
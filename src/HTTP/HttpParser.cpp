@@ -7,29 +7,55 @@
 #include "HttpParser.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "HttpParserErrorCodes.h"
 
 namespace {
 
-void throwIfNotGood(std::istream& stream) {
-  if (!stream.good()) {
-    if (stream.eof()) {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::END_OF_STREAM));
-    } else {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::STREAM_NOT_GOOD));
-    }
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+const size_t BODY_CHUNK_SIZE = 1024 * 1024;
+const char HEAD_TERMINATOR[] = "\r\n\r\n";
+
+void throwParserError(CryptoNote::error::HttpParserErrorCodes code) {
+  throw std::system_error(make_error_code(code));
+}
+
+Common::StringView trim(Common::StringView value) {
+  Common::StringView::Size begin = 0;
+  Common::StringView::Size end = value.getSize();
+  while (begin < end && (value[begin] == ' ' || value[begin] == '\t')) {
+    ++begin;
   }
+
+  while (end > begin && (value[end - 1] == ' ' || value[end - 1] == '\t')) {
+    --end;
+  }
+
+  return value.range(begin, end);
+}
+
+std::string toLower(Common::StringView value) {
+  std::string result(value.getData(), value.getSize());
+  std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+  return result;
 }
 
 }
 
 namespace CryptoNote {
 
+HttpParser::HttpParser(Reader reader, size_t maxMessageSize, size_t maxHeadSize) :
+  reader(std::move(reader)), maxMessageSize(maxMessageSize), maxHeadSize(maxHeadSize), bufferBegin(0), bufferEnd(0), scannedEnd(0) {
+}
+
 HttpResponse::HTTP_STATUS HttpParser::parseResponseStatusFromString(const std::string& status) {
   if (status == "200 OK" || status == "200 Ok") return CryptoNote::HttpResponse::STATUS_200;
+  else if (status.substr(0, 4) == "204 ") return CryptoNote::HttpResponse::STATUS_204;
   else if (status.substr(0, 4) == "401 ") return CryptoNote::HttpResponse::STATUS_401;
   else if (status == "404 Not Found") return CryptoNote::HttpResponse::STATUS_404;
+  else if (status.substr(0, 4) == "413 ") return CryptoNote::HttpResponse::STATUS_413;
+  else if (status.substr(0, 4) == "431 ") return CryptoNote::HttpResponse::STATUS_431;
   else if (status == "500 Internal Server Error") return CryptoNote::HttpResponse::STATUS_500;
   else throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL),
       "Unknown HTTP status code is given");
@@ -38,177 +64,193 @@ HttpResponse::HTTP_STATUS HttpParser::parseResponseStatusFromString(const std::s
 }
 
 
-void HttpParser::receiveRequest(std::istream& stream, HttpRequest& request) {
-  readWord(stream, request.method);
-  readWord(stream, request.url);
+bool HttpParser::receiveRequest(HttpRequest& request) {
+  Common::StringView head;
+  if (!readHead(head)) {
+    return false;
+  }
 
-  std::string httpVersion;
-  readWord(stream, httpVersion);
+  MessageHead messageHead;
+  parseHead(head, messageHead);
 
-  readHeaders(stream, request.headers);
+  Common::StringView line = messageHead.startLine;
+  Common::StringView::Size methodEnd = line.find(' ');
+  if (methodEnd == Common::StringView::INVALID) {
+    throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+  }
 
-  std::string body;
-  uint64_t bodyLen = getBodyLen(request.headers);
-  if (bodyLen) {
-    readBody(stream, request.body, bodyLen);
+  Common::StringView target = line.unhead(methodEnd + 1);
+  Common::StringView::Size urlEnd = target.find(' ');
+  if (urlEnd == Common::StringView::INVALID) {
+    throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
   }
-}
 
+  request.method.assign(line.getData(), methodEnd);
+  request.url.assign(target.getData(), urlEnd);
+  request.headers.clear();
+  for (const auto& header : messageHead.headers) {
+    request.headers[toLower(header.first)].assign(header.second.getData(), header.second.getSize());
+  }
 
-void HttpParser::receiveResponse(std::istream& stream, HttpResponse& response) {
-  std::string httpVersion;
-  readWord(stream, httpVersion);
-  
-  std::string status;
-  char c;
-  
-  stream.get(c);
-  while (stream.good() && c != '\r') { //Till the end
-    status += c;
-    stream.get(c);
+  bufferBegin += head.getSize();
+  request.body.clear();
+  uint64_t bodyLen = getBodyLen(request.headers);
+  if (bodyLen) {
+    readBody(request.body, bodyLen);
   }
 
-  throwIfNotGood(stream);
+  return true;
+}
 
-  if (c == '\r') {
-    stream.get(c);
-    if (c != '\n') {
-      throw std::runtime_error("Parser error: '\\n' symbol is expected");
-    }
+void HttpParser::receiveResponse(HttpResponse& response) {
+  Common::StringView head;
+  if (!readHead(head)) {
+    throwParserError(error::HttpParserErrorCodes::END_OF_STREAM);
   }
 
-  response.setStatus(parseResponseStatusFromString(status));
-  
-  std::string name;
-  std::string value;
+  MessageHead messageHead;
+  parseHead(head, messageHead);
 
-  while (readHeader(stream, name, value)) {
-    response.addHeader(name, value);
-    name.clear();
-    value.clear();
+  Common::StringView::Size versionEnd = messageHead.startLine.find(' ');
+  if (versionEnd == Common::StringView::INVALID) {
+    throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
   }
 
-  response.addHeader(name, value);
-  auto headers = response.getHeaders();
-  uint64_t length = 0;
-  auto it = headers.find("content-length");
-  if (it != headers.end()) {
-    length = std::stoul(it->second);
+  response.setStatus(parseResponseStatusFromString(std::string(messageHead.startLine.unhead(versionEnd + 1))));
+  for (const auto& header : messageHead.headers) {
+    response.addHeader(toLower(header.first), std::string(header.second));
   }
-  
+
+  bufferBegin += head.getSize();
   std::string body;
+  uint64_t length = getBodyLen(response.getHeaders());
   if (length) {
-    readBody(stream, body, length);
+    readBody(body, length);
   }
 
-  response.setBody(body);
+  response.setBody(std::move(body));
 }
 
+bool HttpParser::hasBufferedData() const {
+  return bufferBegin != bufferEnd;
+}
 
-void HttpParser::readWord(std::istream& stream, std::string& word) {
-  char c;
+void HttpParser::parseHead(Common::StringView head, MessageHead& result) {
+  result.headers.clear();
+  bool startLine = true;
+  while (!head.isEmpty()) {
+    Common::StringView::Size lineEnd = head.find('\n');
+    if (lineEnd == Common::StringView::INVALID || lineEnd == 0 || head[lineEnd - 1] != '\r') {
+      throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
 
-  stream.get(c);
-  while (stream.good() && c != ' ' && c != '\r') {
-    word += c;
-    stream.get(c);
-  }
+    Common::StringView line = head.head(lineEnd - 1);
+    head = head.unhead(lineEnd + 1);
+    if (startLine) {
+      result.startLine = line;
+      startLine = false;
+    } else if (!line.isEmpty()) {
+      Common::StringView::Size colon = line.find(':');
+      if (colon == Common::StringView::INVALID) {
+        throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+      }
 
-  throwIfNotGood(stream);
+      if (colon == 0) {
+        throwParserError(error::HttpParserErrorCodes::EMPTY_HEADER);
+      }
 
-  if (c == '\r') {
-    stream.get(c);
-    if (c != '\n') {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+      result.headers.emplace_back(line.head(colon), trim(line.unhead(colon + 1)));
     }
   }
 }
 
-void HttpParser::readHeaders(std::istream& stream, HttpRequest::Headers& headers) {
-  std::string name;
-  std::string value;
-
-  while (readHeader(stream, name, value)) {
-    headers[name] = value; //use insert
-    name.clear();
-    value.clear();
-  }
-
-  headers[name] = value; //use insert
-}
-
-bool HttpParser::readHeader(std::istream& stream, std::string& name, std::string& value) {
-  char c;
-  bool isName = true;
-
-  stream.get(c);
-  while (stream.good() && c != '\r') {
-    if (c == ':') {
-      if (stream.peek() == ' ') {
-        stream.get(c);
-      }
-
-      if (name.empty()) {
-        throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::EMPTY_HEADER));
+bool HttpParser::readHead(Common::StringView& head) {
+  for (;;) {
+    // Resume the terminator search where the previous attempt stopped
+    const char* data = buffer.data() + bufferBegin;
+    size_t size = bufferEnd - bufferBegin;
+    size_t from = scannedEnd > 3 ? scannedEnd - 3 : 0;
+    const char* end = std::search(data + from, data + size, HEAD_TERMINATOR, HEAD_TERMINATOR + 4);
+    if (end != data + size) {
+      if (static_cast<size_t>(end - data) + 4 > maxHeadSize) {
+        throwParserError(error::HttpParserErrorCodes::HEAD_TOO_LARGE);
       }
 
-      if (isName) {
-        isName = false;
-        stream.get(c);
-        continue;
-      }
+      scannedEnd = 0;
+      head = Common::StringView(data, end - data + 4);
+      return true;
     }
 
-    if (isName) {
-      name += c;
-      stream.get(c);
-    } else {
-      value += c;
-      stream.get(c);
+    scannedEnd = size;
+    if (size >= maxHeadSize) {
+      throwParserError(error::HttpParserErrorCodes::HEAD_TOO_LARGE);
     }
-  }
 
-  throwIfNotGood(stream);
+    if (!fillBuffer()) {
+      if (size == 0) {
+        return false;
+      }
 
-  stream.get(c);
-  if (c != '\n') {
-    throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+      throwParserError(error::HttpParserErrorCodes::END_OF_STREAM);
+    }
   }
+}
 
-  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-
-  c = stream.peek();
-  if (c == '\r') {
-    stream.get(c).get(c);
-    if (c != '\n') {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
-    }
+bool HttpParser::fillBuffer() {
+  if (bufferBegin == bufferEnd) {
+    bufferBegin = 0;
+    bufferEnd = 0;
+  } else if (bufferBegin != 0 && buffer.size() - bufferEnd < READ_CHUNK_SIZE) {
+    std::memmove(buffer.data(), buffer.data() + bufferBegin, bufferEnd - bufferBegin);
+    bufferEnd -= bufferBegin;
+    bufferBegin = 0;
+  }
 
-    return false; //no more headers
+  if (buffer.size() - bufferEnd < READ_CHUNK_SIZE) {
+    buffer.resize(bufferEnd + READ_CHUNK_SIZE);
   }
 
-  return true;
+  size_t read = reader(buffer.data() + bufferEnd, buffer.size() - bufferEnd);
+  bufferEnd += read;
+  return read != 0;
 }
 
-uint64_t HttpParser::getBodyLen(const HttpRequest::Headers& headers) {
+uint64_t HttpParser::getBodyLen(const std::map<std::string, std::string>& headers) const {
   auto it = headers.find("content-length");
-  if (it != headers.end()) {
-    uint64_t bytes = std::stoul(it->second);
-    return bytes;
+  if (it == headers.end()) {
+    return 0;
   }
 
-  return 0;
+  const std::string& value = it->second;
+  if (value.empty() || value.size() > 19 || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+    throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+  }
+
+  uint64_t bytes = std::stoull(value);
+  if (bytes > maxMessageSize) {
+    throwParserError(error::HttpParserErrorCodes::BODY_TOO_LARGE);
+  }
+
+  return bytes;
 }
 
-void HttpParser::readBody(std::istream& stream, std::string& body, const uint64_t bodyLen) {
-  uint64_t read = 0;
+void HttpParser::readBody(std::string& body, const uint64_t bodyLen) {
+  // Whatever is already buffered is copied once, the rest is received straight into the body.
+  // The body grows a chunk at a time, so a peer announcing a large Content-Length pins no more than it sends.
+  size_t received = static_cast<size_t>(std::min<uint64_t>(bodyLen, bufferEnd - bufferBegin));
+  body.assign(buffer.data() + bufferBegin, received);
+  bufferBegin += received;
+  while (received < bodyLen) {
+    size_t chunk = static_cast<size_t>(std::min<uint64_t>(bodyLen - received, BODY_CHUNK_SIZE));
+    body.resize(received + chunk);
+    size_t read = reader(&body[received], chunk);
+    if (read == 0) {
+      throwParserError(error::HttpParserErrorCodes::END_OF_STREAM);
+    }
 
-  while (stream.good() && read < bodyLen) {
-    body += stream.get();
-    ++read;
+    received += read;
+    body.resize(received);
   }
-
-  throwIfNotGood(stream);
 }
 
 }
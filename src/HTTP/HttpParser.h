@@ -7,28 +7,58 @@
 #ifndef HTTPPARSER_H_
 #define HTTPPARSER_H_
 
-#include <iostream>
+#include <functional>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
+#include "Common/StringView.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 
 namespace CryptoNote {
 
-//Blocking HttpParser
+//Blocking HttpParser working on its own receive buffer.
+//Bytes are pulled from the transport in large chunks and kept between messages, so pipelined
+//requests on a keep-alive connection are parsed without further reads.
 class HttpParser {
 public:
-  HttpParser() {};
+  //Reads up to 'size' bytes into 'data', returns 0 at the end of stream
+  typedef std::function<size_t(char* data, size_t size)> Reader;
 
-  void receiveRequest(std::istream& stream, HttpRequest& request);
-  void receiveResponse(std::istream& stream, HttpResponse& response);
+  struct MessageHead {
+    Common::StringView startLine;
+    std::vector<std::pair<Common::StringView, Common::StringView>> headers;
+  };
+
+  //Limits of the body and of the head, checked separately
+  static const size_t DEFAULT_MAX_MESSAGE_SIZE = 128 * 1024 * 1024;
+  static const size_t DEFAULT_MAX_HEAD_SIZE = 16 * 1024;
+
+  //The body limit only bounds what a peer may send, memory grows with the bytes actually received
+  explicit HttpParser(Reader reader, size_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE, size_t maxHeadSize = DEFAULT_MAX_HEAD_SIZE);
+
+  //Returns false if the stream ended cleanly before the next request
+  bool receiveRequest(HttpRequest& request);
+  void receiveResponse(HttpResponse& response);
+  bool hasBufferedData() const;
+
+  //Splits a message head, terminated by an empty line, into views of 'head'
+  static void parseHead(Common::StringView head, MessageHead& result);
   static HttpResponse::HTTP_STATUS parseResponseStatusFromString(const std::string& status);
 private:
-  void readWord(std::istream& stream, std::string& word);
-  void readHeaders(std::istream& stream, HttpRequest::Headers &headers);
-  bool readHeader(std::istream& stream, std::string& name, std::string& value);
-  uint64_t getBodyLen(const HttpRequest::Headers& headers);
-  void readBody(std::istream& stream, std::string& body, const uint64_t bodyLen);
+  bool readHead(Common::StringView& head);
+  bool fillBuffer();
+  uint64_t getBodyLen(const std::map<std::string, std::string>& headers) const;
+  void readBody(std::string& body, uint64_t bodyLen);
+
+  Reader reader;
+  size_t maxMessageSize;
+  size_t maxHeadSize;
+  std::vector<char> buffer;
+  size_t bufferBegin;
+  size_t bufferEnd;
+  size_t scannedEnd;
 };
 
 } //namespace CryptoNote
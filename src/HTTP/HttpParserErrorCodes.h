@@ -16,7 +16,9 @@ enum HttpParserErrorCodes {
   STREAM_NOT_GOOD = 1,
   END_OF_STREAM,
   UNEXPECTED_SYMBOL,
-  EMPTY_HEADER
+  EMPTY_HEADER,
+  HEAD_TOO_LARGE,
+  BODY_TOO_LARGE
 };
 
 // custom category:
@@ -38,6 +40,8 @@ public:
       case END_OF_STREAM: return "The stream is ended";
       case UNEXPECTED_SYMBOL: return "Unexpected symbol";
       case EMPTY_HEADER: return "The header name is empty";
+      case HEAD_TOO_LARGE: return "The message head exceeds the size limit";
+      case BODY_TOO_LARGE: return "The message body exceeds the size limit";
       default: return "Unknown error";
     }
   }
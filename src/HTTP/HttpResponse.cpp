@@ -14,10 +14,16 @@ const char* getStatusString(CryptoNote::HttpResponse::HTTP_STATUS status) {
   switch (status) {
   case CryptoNote::HttpResponse::STATUS_200:
     return "200 OK";
+  case CryptoNote::HttpResponse::STATUS_204:
+    return "204 No Content";
   case CryptoNote::HttpResponse::STATUS_401:
     return "401 Unauthorized";
   case CryptoNote::HttpResponse::STATUS_404:
     return "404 Not Found";
+  case CryptoNote::HttpResponse::STATUS_413:
+    return "413 Payload Too Large";
+  case CryptoNote::HttpResponse::STATUS_431:
+    return "431 Request Header Fields Too Large";
   case CryptoNote::HttpResponse::STATUS_500:
     return "500 Internal Server Error";
   default:
@@ -33,6 +39,10 @@ const char* getErrorBody(CryptoNote::HttpResponse::HTTP_STATUS status) {
     return "Authorization required\n";
   case CryptoNote::HttpResponse::STATUS_404:
     return "Requested url is not found\n";
+  case CryptoNote::HttpResponse::STATUS_413:
+    return "Request body is too large\n";
+  case CryptoNote::HttpResponse::STATUS_431:
+    return "Request header is too large\n";
   case CryptoNote::HttpResponse::STATUS_500:
     return "Internal server error is occurred\n";
   default:
@@ -55,7 +65,9 @@ HttpResponse::HttpResponse() {
 void HttpResponse::setStatus(HTTP_STATUS s) {
   status = s;
 
-  if (status != HttpResponse::STATUS_200) {
+  if (status == HttpResponse::STATUS_204) {
+    setBody(std::string());
+  } else if (status != HttpResponse::STATUS_200) {
     setBody(getErrorBody(status));
   }
 }
@@ -65,7 +77,11 @@ void HttpResponse::addHeader(const std::string& name, const std::string& value)
 }
 
 void HttpResponse::setBody(const std::string& b) {
-  body = b;
+  setBody(std::string(b));
+}
+
+void HttpResponse::setBody(std::string&& b) {
+  body = std::move(b);
   if (!body.empty()) {
     headers["Content-Length"] = std::to_string(body.size());
   } else {
@@ -16,8 +16,11 @@ namespace CryptoNote {
   public:
     enum HTTP_STATUS {
       STATUS_200,
+      STATUS_204,
       STATUS_401,
       STATUS_404,
+      STATUS_413,
+      STATUS_431,
       STATUS_500
     };
 
@@ -26,6 +29,7 @@ namespace CryptoNote {
     void setStatus(HTTP_STATUS s);
     void addHeader(const std::string& name, const std::string& value);
     void setBody(const std::string& b);
+    void setBody(std::string&& b);
 
     const std::map<std::string, std::string>& getHeaders() const { return headers; }
     HTTP_STATUS getStatus() const { return status; }
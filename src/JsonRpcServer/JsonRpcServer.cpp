@@ -10,6 +10,7 @@
 #include <future>
 #include <system_error>
 #include <memory>
+#include <chrono>
 #include <sstream>
 #include "HTTP/HttpParserErrorCodes.h"
 
@@ -60,7 +61,11 @@ void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNot
         return;
       }
 
-      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse);
+      if (jsonRpcRequest.isArray()) {
+        processJsonRpcBatch(jsonRpcRequest, jsonRpcResponse);
+      } else {
+        processJsonRpcCall(jsonRpcRequest, jsonRpcResponse);
+      }
 
       std::ostringstream jsonOutputStream;
       jsonOutputStream << jsonRpcResponse;
@@ -79,6 +84,40 @@ void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNot
   }
 }
 
+void JsonRpcServer::processJsonRpcBatch(const Common::JsonValue& req, Common::JsonValue& resp) {
+  using Common::JsonValue;
+
+  size_t size = req.size();
+  if (size == 0 || size > config.rpcMaxBatchSize) {
+    resp.insert("jsonrpc", "2.0");
+    resp.insert("id", nullptr);
+    makeGenericErrorReponse(resp, size == 0 ? "Empty batch" : "Batch is too large", -32600);
+    return;
+  }
+
+  // wallet handlers are not thread safe, calls are answered one after another in request order
+  resp = JsonValue(JsonValue::ARRAY);
+  for (size_t i = 0; i < size; ++i) {
+    processJsonRpcCall(req[i], resp.pushBack(JsonValue(JsonValue::OBJECT)));
+  }
+}
+
+void JsonRpcServer::processJsonRpcCall(const Common::JsonValue& req, Common::JsonValue& resp) {
+  auto start = std::chrono::steady_clock::now();
+  processJsonRpcRequest(req, resp);
+
+  // calls rejected before reaching a handler share one route, so clients cannot grow the metrics without bound
+  bool failed = resp.contains("error");
+  bool matched = req.isObject() && req.contains("method") && req("method").isString();
+  if (matched && failed) {
+    const Common::JsonValue& code = resp("error")("code");
+    matched = !code.isInteger() || (code.getInteger() != -32601 && code.getInteger() != -32604 && code.getInteger() != -3600);
+  }
+
+  std::string route = matched ? "json_rpc." + req("method").getString() : "json_rpc.unmatched";
+  m_metrics.record(route, std::chrono::steady_clock::now() - start, 0, 0, failed);
+}
+
 void JsonRpcServer::prepareJsonResponse(const Common::JsonValue& req, Common::JsonValue& resp) {
   using Common::JsonValue;
 
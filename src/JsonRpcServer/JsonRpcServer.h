@@ -53,6 +53,8 @@ protected:
 private:
   // HttpServer
   virtual void processRequest(const CryptoNote::HttpRequest& request, CryptoNote::HttpResponse& response) override;
+  void processJsonRpcBatch(const Common::JsonValue& req, Common::JsonValue& resp);
+  void processJsonRpcCall(const Common::JsonValue& req, Common::JsonValue& resp);
 
   System::Dispatcher& system;
   System::Event& stopEvent;
@@ -6,10 +6,12 @@
 
 #include "Miner.h"
 
+#include <cstring>
 #include <functional>
 
 #include "crypto/crypto.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
 
 #include <System/InterruptedException.h>
 
@@ -19,6 +21,7 @@ Miner::Miner(System::Dispatcher& dispatcher, Logging::ILogger& logger) :
   m_dispatcher(dispatcher),
   m_miningStopped(dispatcher),
   m_state(MiningState::MINING_STOPPED),
+  m_nonce(0),
   m_logger(logger, "Miner") {
 }
 
@@ -27,6 +30,25 @@ Miner::~Miner() {
 }
 
 Block Miner::mine(const BlockMiningParameters& blockMiningParameters, uint64_t threadCount) {
+  const Block& blockTemplate = blockMiningParameters.blockTemplate;
+
+  // the nonce is the last field of the header, which starts the hashing blob
+  BlobMiningParameters blobMiningParameters;
+  BinaryArray header;
+  if (!toBinaryArray(static_cast<const BlockHeader&>(blockTemplate), header) || !get_block_hashing_blob(blockTemplate, blobMiningParameters.hashingBlob)) {
+    throw std::runtime_error("Couldn't build the hashing blob of the block template");
+  }
+
+  blobMiningParameters.nonceOffset = header.size() - sizeof(blockTemplate.nonce);
+  blobMiningParameters.majorVersion = blockTemplate.majorVersion;
+  blobMiningParameters.difficulty = blockMiningParameters.difficulty;
+
+  Block block = blockTemplate;
+  block.nonce = mine(blobMiningParameters, threadCount);
+  return block;
+}
+
+uint32_t Miner::mine(const BlobMiningParameters& blobMiningParameters, uint64_t threadCount) {
   if (threadCount == 0) {
     throw std::runtime_error("Miner requires at least one thread");
   }
@@ -38,7 +60,7 @@ Block Miner::mine(const BlockMiningParameters& blockMiningParameters, uint64_t t
   m_state = MiningState::MINING_IN_PROGRESS;
   m_miningStopped.clear();
 
-  runWorkers(blockMiningParameters, threadCount);
+  runWorkers(blobMiningParameters, threadCount);
 
   assert(m_state != MiningState::MINING_IN_PROGRESS);
   if (m_state == MiningState::MINING_STOPPED) {
@@ -47,7 +69,7 @@ Block Miner::mine(const BlockMiningParameters& blockMiningParameters, uint64_t t
   }
 
   assert(m_state == MiningState::BLOCK_FOUND);
-  return m_block;
+  return m_nonce;
 }
 
 void Miner::stop() {
@@ -59,20 +81,20 @@ void Miner::stop() {
   }
 }
 
-void Miner::runWorkers(BlockMiningParameters blockMiningParameters, uint64_t threadCount) {
+void Miner::runWorkers(const BlobMiningParameters& blobMiningParameters, uint64_t threadCount) {
   assert(threadCount > 0);
 
-  m_logger(Logging::INFO) << "Starting mining for difficulty " << blockMiningParameters.difficulty;
+  m_logger(Logging::INFO) << "Starting mining for difficulty " << blobMiningParameters.difficulty;
 
   try {
-    blockMiningParameters.blockTemplate.nonce = Crypto::rand<uint32_t>();
+    uint32_t startNonce = Crypto::rand<uint32_t>();
 
     for (uint64_t i = 0; i < threadCount; ++i) {
       m_workers.push_back(std::unique_ptr<System::RemoteContext<void>> (
-        new System::RemoteContext<void>(m_dispatcher, std::bind(&Miner::workerFunc, this, blockMiningParameters.blockTemplate, blockMiningParameters.difficulty, threadCount)))
+        new System::RemoteContext<void>(m_dispatcher, std::bind(&Miner::workerFunc, this, std::cref(blobMiningParameters), startNonce, static_cast<uint32_t>(threadCount))))
       );
 
-      blockMiningParameters.blockTemplate.nonce++;
+      startNonce++;
     }
 
     m_workers.clear();
@@ -85,33 +107,34 @@ void Miner::runWorkers(BlockMiningParameters blockMiningParameters, uint64_t thr
   m_miningStopped.set();
 }
 
-void Miner::workerFunc(const Block& blockTemplate, difficulty_type difficulty, uint32_t nonceStep) {
+void Miner::workerFunc(const BlobMiningParameters& blobMiningParameters, uint32_t startNonce, uint32_t nonceStep) {
   try {
-    Block block = blockTemplate;
+    // only the nonce changes between hashes, so the blob is built once and patched in place
+    BinaryArray blob = blobMiningParameters.hashingBlob;
     Crypto::cn_context cryptoContext;
 
-    while (m_state == MiningState::MINING_IN_PROGRESS) {
+    for (uint32_t nonce = startNonce; m_state == MiningState::MINING_IN_PROGRESS; nonce += nonceStep) {
+      std::memcpy(blob.data() + blobMiningParameters.nonceOffset, &nonce, sizeof(nonce));
+
       Crypto::Hash hash;
-      if (!get_block_longhash(cryptoContext, block, hash)) {
+      if (!get_block_longhash(cryptoContext, blobMiningParameters.majorVersion, blob, hash)) {
         //error occured
         m_logger(Logging::DEBUGGING) << "calculating long hash error occured";
         m_state = MiningState::MINING_STOPPED;
         return;
       }
 
-      if (check_hash(hash, difficulty)) {
-        m_logger(Logging::INFO) << "Found block for difficulty " << difficulty;
+      if (check_hash(hash, blobMiningParameters.difficulty)) {
+        m_logger(Logging::INFO) << "Found block for difficulty " << blobMiningParameters.difficulty;
 
         if (!setStateBlockFound()) {
           m_logger(Logging::DEBUGGING) << "block is already found or mining stopped";
           return;
         }
 
-        m_block = block;
+        m_nonce = nonce;
         return;
       }
-
-      block.nonce += nonceStep;
     }
   } catch (std::exception& e) {
     m_logger(Logging::ERROR) << "Miner got error: " << e.what();
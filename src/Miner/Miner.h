@@ -25,12 +25,21 @@ struct BlockMiningParameters {
   difficulty_type difficulty;
 };
 
+// nonce search over a prebuilt hashing blob, as handed out by a work server
+struct BlobMiningParameters {
+  BinaryArray hashingBlob;
+  size_t nonceOffset;
+  uint8_t majorVersion;
+  difficulty_type difficulty;
+};
+
 class Miner {
 public:
   Miner(System::Dispatcher& dispatcher, Logging::ILogger& logger);
   ~Miner();
 
   Block mine(const BlockMiningParameters& blockMiningParameters, uint64_t threadCount);
+  uint32_t mine(const BlobMiningParameters& blobMiningParameters, uint64_t threadCount);
 
   //NOTE! this is blocking method
   void stop();
@@ -44,12 +53,12 @@ private:
 
   std::vector<std::unique_ptr<System::RemoteContext<void>>>  m_workers;
 
-  Block m_block;
+  uint32_t m_nonce;
 
   Logging::LoggerRef m_logger;
 
-  void runWorkers(BlockMiningParameters blockMiningParameters, uint64_t threadCount);
-  void workerFunc(const Block& blockTemplate, difficulty_type difficulty, uint32_t nonceStep);
+  void runWorkers(const BlobMiningParameters& blobMiningParameters, uint64_t threadCount);
+  void workerFunc(const BlobMiningParameters& blobMiningParameters, uint32_t startNonce, uint32_t nonceStep);
   bool setStateBlockFound();
 };
 
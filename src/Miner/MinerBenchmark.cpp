@@ -0,0 +1,201 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "MinerBenchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+
+using namespace CryptoNote;
+
+namespace Miner {
+
+namespace {
+
+struct HashVariant {
+  uint8_t majorVersion;
+  const char* name;
+};
+
+// get_block_longhash picks the hash function by block major version
+const HashVariant HASH_VARIANTS[] = {
+  { BLOCK_MAJOR_VERSION_1, "cn/v1" },
+  { BLOCK_MAJOR_VERSION_2, "cn-fast/v2" },
+  { BLOCK_MAJOR_VERSION_3, "conceal/v3" },
+};
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t index = static_cast<size_t>(fraction * (sorted.size() - 1));
+  return sorted[index];
+}
+
+std::string formatMilliseconds(uint32_t microseconds) {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(2) << microseconds / 1000.0;
+  return stream.str();
+}
+
+}
+
+MinerBenchmark::MinerBenchmark(const CryptoNote::MiningConfig& config, Logging::ILogger& logger) :
+  m_config(config),
+  m_logger(logger, "MinerBenchmark") {
+}
+
+void MinerBenchmark::run() {
+  std::vector<uint64_t> threadCounts = m_config.benchmarkThreads;
+  std::sort(threadCounts.begin(), threadCounts.end());
+  threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+  m_logger(Logging::INFO) << "Benchmarking " << threadCounts.size() << " thread counts for " << m_config.benchmarkDuration << " seconds each";
+
+  std::cout << std::left << std::setw(12) << "variant" << std::setw(8) << "memory" << std::right << std::setw(8) << "threads"
+            << std::setw(12) << "hashes/s" << std::setw(10) << "scaling" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+            << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::endl;
+
+  for (const HashVariant& variant : HASH_VARIANTS) {
+    for (bool hugePages : { false, true }) {
+      // scaling is relative to one thread, measured even when not requested
+      double singleThreadRate = 0;
+
+      for (uint64_t threadCount : threadCounts) {
+        Result baseline;
+        bool measured = singleThreadRate != 0 || threadCount == 1 || measure(variant.majorVersion, 1, hugePages, baseline);
+        if (measured && singleThreadRate == 0 && threadCount != 1) {
+          singleThreadRate = baseline.hashes / baseline.seconds;
+        }
+
+        Result result;
+        if (!measured || !measure(variant.majorVersion, threadCount, hugePages, result)) {
+          std::cout << std::left << std::setw(12) << variant.name << std::setw(8) << "huge" << "not available, reserve huge pages with vm.nr_hugepages" << std::endl;
+          break;
+        }
+
+        double rate = result.hashes / result.seconds;
+        if (threadCount == 1) {
+          singleThreadRate = rate;
+        }
+
+        std::sort(result.latencies.begin(), result.latencies.end());
+        double scaling = singleThreadRate > 0 ? rate / (singleThreadRate * threadCount) * 100 : 0;
+
+        std::cout << std::left << std::setw(12) << variant.name << std::setw(8) << (hugePages ? "huge" : "normal") << std::right
+                  << std::setw(8) << threadCount << std::setw(12) << std::fixed << std::setprecision(1) << rate
+                  << std::setw(9) << std::setprecision(0) << scaling << "%"
+                  << std::setw(10) << formatMilliseconds(percentile(result.latencies, 0.5))
+                  << std::setw(10) << formatMilliseconds(percentile(result.latencies, 0.9))
+                  << std::setw(10) << formatMilliseconds(percentile(result.latencies, 0.99))
+                  << std::setw(10) << formatMilliseconds(result.latencies.empty() ? 0 : result.latencies.back()) << std::endl;
+      }
+    }
+  }
+}
+
+bool MinerBenchmark::measure(uint8_t majorVersion, uint64_t threadCount, bool hugePages, Result& result) {
+  const BinaryArray hashingBlob = makeHashingBlob(majorVersion);
+  BlockHeader header;
+  get_block_header_from_hashing_blob(hashingBlob, header);
+  const size_t nonceOffset = toBinaryArray(header).size() - sizeof(header.nonce);
+
+  std::vector<std::vector<uint32_t>> latencies(threadCount);
+  std::vector<uint64_t> hashes(threadCount, 0);
+  std::atomic<uint64_t> ready(0);
+  std::atomic<bool> failed(false);
+  std::atomic<bool> started(false);
+  std::atomic<bool> stopped(false);
+
+  std::vector<std::thread> threads;
+  for (uint64_t i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&, i] {
+      Crypto::cn_context context(hugePages ? Crypto::cn_scratchpad_memory::huge_pages : Crypto::cn_scratchpad_memory::normal);
+      if (hugePages && !context.has_huge_pages()) {
+        failed = true;
+      }
+
+      BinaryArray blob = hashingBlob;
+      uint32_t nonce = static_cast<uint32_t>(i);
+      ++ready;
+      while (!started) {
+        std::this_thread::yield();
+      }
+
+      while (!stopped && !failed) {
+        std::memcpy(blob.data() + nonceOffset, &nonce, sizeof(nonce));
+
+        auto start = std::chrono::steady_clock::now();
+        Crypto::Hash hash;
+        get_block_longhash(context, majorVersion, blob, hash);
+        auto duration = std::chrono::steady_clock::now() - start;
+
+        latencies[i].push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+        ++hashes[i];
+        nonce += static_cast<uint32_t>(threadCount);
+      }
+    });
+  }
+
+  // every thread has its scratchpad before the clock starts
+  while (ready != threadCount) {
+    std::this_thread::yield();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  started = true;
+  if (!failed) {
+    std::this_thread::sleep_for(std::chrono::seconds(m_config.benchmarkDuration));
+  }
+
+  stopped = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (failed) {
+    return false;
+  }
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.hashes = 0;
+  result.latencies.clear();
+  for (uint64_t i = 0; i < threadCount; ++i) {
+    result.hashes += hashes[i];
+    result.latencies.insert(result.latencies.end(), latencies[i].begin(), latencies[i].end());
+  }
+
+  return true;
+}
+
+BinaryArray MinerBenchmark::makeHashingBlob(uint8_t majorVersion) {
+  Block block;
+  block.majorVersion = majorVersion;
+  block.minorVersion = 0;
+  block.timestamp = static_cast<uint64_t>(time(nullptr));
+  block.previousBlockHash = Crypto::rand<Crypto::Hash>();
+  block.nonce = 0;
+  block.baseTransaction.version = TRANSACTION_VERSION_1;
+  block.baseTransaction.unlockTime = 0;
+
+  BinaryArray blob;
+  get_block_hashing_blob(block, blob);
+  return blob;
+}
+
+} //namespace Miner
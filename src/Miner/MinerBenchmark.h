@@ -0,0 +1,41 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CryptoNote.h"
+#include "Logging/LoggerRef.h"
+#include "MiningConfig.h"
+
+namespace Miner {
+
+// Hashes synthetic block templates without a daemon, for every hash variant, thread count and
+// scratchpad memory mode, and prints throughput, scaling and per-hash latency.
+class MinerBenchmark {
+public:
+  MinerBenchmark(const CryptoNote::MiningConfig& config, Logging::ILogger& logger);
+
+  void run();
+
+private:
+  struct Result {
+    uint64_t hashes;
+    double seconds;
+    // per-hash latencies of all threads, in microseconds
+    std::vector<uint32_t> latencies;
+  };
+
+  CryptoNote::MiningConfig m_config;
+  Logging::LoggerRef m_logger;
+
+  // false if huge pages were requested but could not be allocated
+  bool measure(uint8_t majorVersion, uint64_t threadCount, bool hugePages, Result& result);
+  static CryptoNote::BinaryArray makeHashingBlob(uint8_t majorVersion);
+};
+
+} //namespace Miner
@@ -11,6 +11,8 @@ namespace Miner {
 enum class MinerEventType: uint8_t {
   BLOCK_MINED,
   BLOCKCHAIN_UPDATED,
+  JOB_RECEIVED,
+  WORK_SERVER_DISCONNECTED,
 };
 
 struct MinerEvent {
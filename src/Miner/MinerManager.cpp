@@ -37,6 +37,18 @@ MinerEvent BlockchainUpdatedEvent() {
   return event;
 }
 
+MinerEvent JobReceivedEvent() {
+  MinerEvent event;
+  event.type = MinerEventType::JOB_RECEIVED;
+  return event;
+}
+
+MinerEvent WorkServerDisconnectedEvent() {
+  MinerEvent event;
+  event.type = MinerEventType::WORK_SERVER_DISCONNECTED;
+  return event;
+}
+
 }
 
 MinerManager::MinerManager(System::Dispatcher& dispatcher, const CryptoNote::MiningConfig& config, Logging::ILogger& logger) :
@@ -48,6 +60,8 @@ MinerManager::MinerManager(System::Dispatcher& dispatcher, const CryptoNote::Min
   m_blockchainMonitor(dispatcher, m_config.daemonHost, m_config.daemonPort, m_config.scanPeriod, logger),
   m_eventOccurred(dispatcher),
   m_httpEvent(dispatcher),
+  m_workClient(dispatcher, logger),
+  m_foundNonce(0),
   m_lastBlockTimestamp(0) {
 
   m_httpEvent.set();
@@ -59,6 +73,12 @@ MinerManager::~MinerManager() {
 void MinerManager::start() {
   m_logger(Logging::DEBUGGING) << "starting";
 
+  if (m_config.workServerPort != 0) {
+    loginToWorkServer();
+    workEventLoop();
+    return;
+  }
+
   BlockMiningParameters params;
   for (;;) {
     m_logger(Logging::INFO) << "requesting mining parameters";
@@ -130,6 +150,49 @@ void MinerManager::eventLoop() {
   }
 }
 
+void MinerManager::workEventLoop() {
+  for (;;) {
+    m_logger(Logging::DEBUGGING) << "waiting for event";
+    MinerEvent event = waitEvent();
+
+    switch (event.type) {
+      case MinerEventType::BLOCK_MINED: {
+        m_logger(Logging::DEBUGGING) << "got BLOCK_MINED event";
+        try {
+          m_workClient.submit(m_foundJobId, m_foundNonce);
+        } catch (std::exception& e) {
+          m_logger(Logging::WARNING) << "Couldn't submit share: " << e.what();
+        }
+
+        // a newer job may already be mined if it arrived while the share was found
+        if (m_foundJobId == m_job.job_id) {
+          startWork(m_job);
+        }
+        break;
+      }
+
+      case MinerEventType::JOB_RECEIVED: {
+        m_logger(Logging::DEBUGGING) << "got JOB_RECEIVED event";
+        stopMining();
+        startWork(m_receivedJob);
+        startJobMonitoring();
+        break;
+      }
+
+      case MinerEventType::WORK_SERVER_DISCONNECTED: {
+        m_logger(Logging::DEBUGGING) << "got WORK_SERVER_DISCONNECTED event";
+        stopMining();
+        loginToWorkServer();
+        break;
+      }
+
+      default:
+        assert(false);
+        return;
+    }
+  }
+}
+
 MinerEvent MinerManager::waitEvent() {
   while(m_events.empty()) {
     m_eventOccurred.wait();
@@ -179,6 +242,53 @@ void MinerManager::stopBlockchainMonitoring() {
   m_blockchainMonitor.stop();
 }
 
+void MinerManager::loginToWorkServer() {
+  for (;;) {
+    m_logger(Logging::INFO) << "logging in to work server";
+
+    try {
+      CryptoNote::WORK_JOB job = m_workClient.login(m_config.workServerHost, m_config.workServerPort, m_config.miningAddress);
+      startWork(job);
+      startJobMonitoring();
+      return;
+    } catch (std::exception& e) {
+      m_logger(Logging::WARNING) << "Couldn't log in to work server: " << e.what();
+      System::Timer timer(m_dispatcher);
+      timer.sleep(std::chrono::seconds(m_config.scanPeriod));
+    }
+  }
+}
+
+void MinerManager::startWork(const CryptoNote::WORK_JOB& job) {
+  m_job = job;
+  BlobMiningParameters params = WorkClient::makeMiningParameters(job);
+
+  std::string jobId = job.job_id;
+  m_contextGroup.spawn([this, params, jobId] () {
+    try {
+      m_foundNonce = m_miner.mine(params, m_config.threadCount);
+      m_foundJobId = jobId;
+      pushEvent(BlockMinedEvent());
+    } catch (System::InterruptedException&) {
+    } catch (std::exception& e) {
+      m_logger(Logging::ERROR) << "Miner context unexpectedly finished: " << e.what();
+    }
+  });
+}
+
+void MinerManager::startJobMonitoring() {
+  m_contextGroup.spawn([this] () {
+    try {
+      m_receivedJob = m_workClient.waitJob();
+      pushEvent(JobReceivedEvent());
+    } catch (System::InterruptedException&) {
+    } catch (std::exception& e) {
+      m_logger(Logging::WARNING) << "Lost work server connection: " << e.what();
+      pushEvent(WorkServerDisconnectedEvent());
+    }
+  });
+}
+
 bool MinerManager::submitBlock(const Block& minedBlock, const std::string& daemonHost, uint16_t daemonPort) {
   try {
     HttpClient client(m_dispatcher, daemonHost, daemonPort);
@@ -16,6 +16,7 @@
 #include "Miner.h"
 #include "MinerEvent.h"
 #include "MiningConfig.h"
+#include "WorkClient.h"
 
 namespace System {
 class Dispatcher;
@@ -44,9 +45,16 @@ private:
 
   CryptoNote::Block m_minedBlock;
 
+  WorkClient m_workClient;
+  CryptoNote::WORK_JOB m_job;
+  CryptoNote::WORK_JOB m_receivedJob;
+  std::string m_foundJobId;
+  uint32_t m_foundNonce;
+
   uint64_t m_lastBlockTimestamp;
 
   void eventLoop();
+  void workEventLoop();
   MinerEvent waitEvent();
   void pushEvent(MinerEvent&& event);
 
@@ -56,6 +64,10 @@ private:
   void startBlockchainMonitoring();
   void stopBlockchainMonitoring();
 
+  void loginToWorkServer();
+  void startWork(const CryptoNote::WORK_JOB& job);
+  void startJobMonitoring();
+
   bool submitBlock(const CryptoNote::Block& minedBlock, const std::string& daemonHost, uint16_t daemonPort);
   CryptoNote::BlockMiningParameters requestMiningParameters(System::Dispatcher& dispatcher, const std::string& daemonHost, uint16_t daemonPort, const std::string& miningAddress);
 
@@ -26,6 +26,7 @@ namespace {
 const uint64_t DEFAULT_SCANT_PERIOD = 30;
 const char* DEFAULT_DAEMON_HOST = "127.0.0.1";
 const uint64_t CONCURRENCY_LEVEL = std::thread::hardware_concurrency();
+const uint64_t DEFAULT_BENCHMARK_DURATION = 5;
 
 po::options_description cmdOptions;
 
@@ -50,22 +51,46 @@ void parseDaemonAddress(const std::string& daemonAddress, std::string& daemonHos
   }
 }
 
+std::vector<uint64_t> parseThreadCounts(const std::string& threads) {
+  std::vector<std::string> splittedThreads;
+  boost::algorithm::split(splittedThreads, threads, boost::algorithm::is_any_of(","));
+
+  std::vector<uint64_t> threadCounts;
+  for (const std::string& count : splittedThreads) {
+    try {
+      threadCounts.push_back(boost::lexical_cast<uint64_t>(count));
+    } catch (std::exception&) {
+      throw std::runtime_error("Wrong --benchmark-threads format");
+    }
+
+    if (threadCounts.back() == 0) {
+      throw std::runtime_error("--benchmark-threads values must not be zero");
+    }
+  }
+
+  return threadCounts;
 }
 
-MiningConfig::MiningConfig(): help(false) {
+}
+
+MiningConfig::MiningConfig(): workServerPort(0), help(false), benchmark(false), benchmarkDuration(DEFAULT_BENCHMARK_DURATION) {
   cmdOptions.add_options()
       ("help,h", "produce this help message and exit")
       ("address", po::value<std::string>(), "Valid cryptonote miner's address")
       ("daemon-host", po::value<std::string>()->default_value(DEFAULT_DAEMON_HOST), "Daemon host")
       ("daemon-rpc-port", po::value<uint16_t>()->default_value(static_cast<uint16_t>(RPC_DEFAULT_PORT)), "Daemon's RPC port")
       ("daemon-address", po::value<std::string>(), "Daemon host:port. If you use this option you must not use --daemon-host and --daemon-port options")
+      ("work-server", po::value<std::string>(), "Daemon work server host:port. Jobs are taken from it instead of the daemon RPC, --address only names the worker")
       ("threads", po::value<uint64_t>()->default_value(CONCURRENCY_LEVEL), "Mining threads count. Must not be greater than you concurrency level. Default value is your hardware concurrency level")
       ("scan-time", po::value<uint64_t>()->default_value(DEFAULT_SCANT_PERIOD), "Blockchain polling interval (seconds). How often miner will check blockchain for updates")
       ("log-level", po::value<int>()->default_value(1), "Log level. Must be 0..5")
       ("limit", po::value<uint64_t>()->default_value(0), "Mine exact quantity of blocks. 0 means no limit")
       ("first-block-timestamp", po::value<uint64_t>()->default_value(0), "Set timestamp to the first mined block. 0 means leave timestamp unchanged")
       ("block-timestamp-interval", po::value<int64_t>()->default_value(0), "Timestamp step for each subsequent block. May be set only if --first-block-timestamp has been set."
-                                                         " If not set blocks' timestamps remain unchanged");
+                                                         " If not set blocks' timestamps remain unchanged")
+      ("benchmark", "Hash synthetic block templates for every hash variant and exit. No daemon is needed")
+      ("benchmark-threads", po::value<std::string>()->default_value("1," + std::to_string(CONCURRENCY_LEVEL)), "Comma separated thread counts to benchmark")
+      ("benchmark-duration", po::value<uint64_t>()->default_value(DEFAULT_BENCHMARK_DURATION), "Seconds to hash for each benchmark measurement");
 }
 
 void MiningConfig::parse(int argc, char** argv) {
@@ -78,11 +103,31 @@ void MiningConfig::parse(int argc, char** argv) {
     return;
   }
 
-  if (options.count("address") == 0) {
+  logLevel = static_cast<uint8_t>(options["log-level"].as<int>());
+  if (logLevel > static_cast<uint8_t>(Logging::TRACE)) {
+    throw std::runtime_error("--log-level value is too big");
+  }
+
+  if (options.count("benchmark") != 0) {
+    benchmark = true;
+    benchmarkThreads = parseThreadCounts(options["benchmark-threads"].as<std::string>());
+    benchmarkDuration = options["benchmark-duration"].as<uint64_t>();
+    if (benchmarkDuration == 0) {
+      throw std::runtime_error("--benchmark-duration must not be zero");
+    }
+
+    return;
+  }
+
+  if (!options["work-server"].empty()) {
+    parseDaemonAddress(options["work-server"].as<std::string>(), workServerHost, workServerPort);
+  }
+
+  if (options.count("address") == 0 && workServerPort == 0) {
     throw std::runtime_error("Specify --address option");
   }
 
-  miningAddress = options["address"].as<std::string>();
+  miningAddress = options.count("address") != 0 ? options["address"].as<std::string>() : "miner";
 
   if (!options["daemon-address"].empty()) {
     if (!options["daemon-host"].defaulted() || !options["daemon-rpc-port"].defaulted()) {
@@ -105,11 +150,6 @@ void MiningConfig::parse(int argc, char** argv) {
     throw std::runtime_error("--scan-time must not be zero");
   }
 
-  logLevel = static_cast<uint8_t>(options["log-level"].as<int>());
-  if (logLevel > static_cast<uint8_t>(Logging::TRACE)) {
-    throw std::runtime_error("--log-level value is too big");
-  }
-
   blocksLimit = options["limit"].as<uint64_t>();
 
   if (!options["block-timestamp-interval"].defaulted() && options["first-block-timestamp"].defaulted()) {
@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace CryptoNote {
 
@@ -20,6 +21,8 @@ struct MiningConfig {
   std::string miningAddress;
   std::string daemonHost;
   uint16_t daemonPort;
+  std::string workServerHost;
+  uint16_t workServerPort; // 0 when mining through getblocktemplate
   uint64_t threadCount;
   uint64_t scanPeriod;
   uint8_t logLevel;
@@ -27,6 +30,9 @@ struct MiningConfig {
   uint64_t firstBlockTimestamp;
   int64_t blockTimestampInterval;
   bool help;
+  bool benchmark;
+  std::vector<uint64_t> benchmarkThreads;
+  uint64_t benchmarkDuration; // seconds per measurement
 };
 
 } //namespace CryptoNote
@@ -0,0 +1,144 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "WorkClient.h"
+
+#include <System/Ipv4Address.h>
+#include <System/Ipv4Resolver.h>
+#include <System/TcpConnector.h>
+
+#include "Common/StringTools.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "Serialization/SerializationTools.h"
+
+using namespace CryptoNote;
+
+namespace Miner {
+
+namespace {
+
+const size_t MAX_MESSAGE_SIZE = 64 * 1024;
+
+}
+
+WorkClient::WorkClient(System::Dispatcher& dispatcher, Logging::ILogger& logger) :
+  m_dispatcher(dispatcher),
+  m_logger(logger, "WorkClient"),
+  m_nextId(1) {
+}
+
+WORK_JOB WorkClient::login(const std::string& host, uint16_t port, const std::string& login) {
+  m_buffer.clear();
+  m_connection = System::TcpConnector(m_dispatcher).connect(System::Ipv4Resolver(m_dispatcher).resolve(host), port);
+
+  COMMAND_WORK_LOGIN::request request;
+  request.login = login;
+  request.agent = "miner";
+
+  int64_t id = m_nextId;
+  writeMessage(WORK_METHOD_LOGIN, storeToJsonValue(request));
+
+  for (;;) {
+    Common::JsonValue message = readMessage();
+    if (!message.contains("id") || !message("id").isInteger() || message("id").getInteger() != id) {
+      continue;
+    }
+
+    if (message.contains("error") && !message("error").isNil()) {
+      throw std::runtime_error("Work server refused login: " + message("error")("message").getString());
+    }
+
+    COMMAND_WORK_LOGIN::response response;
+    loadFromJsonValue(response, message("result"));
+    if (response.status != "OK") {
+      throw std::runtime_error("Work server responded with wrong status: " + response.status);
+    }
+
+    m_logger(Logging::INFO) << "Logged in to work server " << host << ":" << port << ", session " << response.id;
+    return response.job;
+  }
+}
+
+WORK_JOB WorkClient::waitJob() {
+  for (;;) {
+    Common::JsonValue message = readMessage();
+    if (message.contains("method")) {
+      if (message("method").getString() == WORK_METHOD_JOB) {
+        WORK_JOB job;
+        loadFromJsonValue(job, message("params"));
+        return job;
+      }
+
+      continue;
+    }
+
+    if (message.contains("error") && !message("error").isNil()) {
+      m_logger(Logging::WARNING) << "Share rejected: " << message("error")("message").getString();
+    } else {
+      m_logger(Logging::INFO) << "Share accepted";
+    }
+  }
+}
+
+void WorkClient::submit(const std::string& jobId, uint32_t nonce) {
+  COMMAND_WORK_SUBMIT::request request;
+  request.job_id = jobId;
+  request.nonce = Common::podToHex(nonce);
+  writeMessage(WORK_METHOD_SUBMIT, storeToJsonValue(request));
+}
+
+BlobMiningParameters WorkClient::makeMiningParameters(const WORK_JOB& job) {
+  BlobMiningParameters params;
+  BlockHeader header;
+  if (!Common::fromHex(job.blob, params.hashingBlob) || !get_block_header_from_hashing_blob(params.hashingBlob, header)) {
+    throw std::runtime_error("Couldn't parse the job blob");
+  }
+
+  // the nonce is the last field of the header, which starts the hashing blob
+  params.nonceOffset = toBinaryArray(header).size() - sizeof(header.nonce);
+  params.majorVersion = header.majorVersion;
+  params.difficulty = job.difficulty;
+  return params;
+}
+
+Common::JsonValue WorkClient::readMessage() {
+  for (;;) {
+    size_t lineEnd = m_buffer.find('\n');
+    if (lineEnd != std::string::npos) {
+      std::string line = m_buffer.substr(0, lineEnd);
+      m_buffer.erase(0, lineEnd + 1);
+      return Common::JsonValue::fromString(line);
+    }
+
+    if (m_buffer.size() > MAX_MESSAGE_SIZE) {
+      throw std::runtime_error("Work server sent an oversized message");
+    }
+
+    uint8_t chunk[4096];
+    size_t size = static_cast<size_t>(m_connection.read(chunk, sizeof(chunk)));
+    if (size == 0) {
+      throw std::runtime_error("Work server closed the connection");
+    }
+
+    m_buffer.append(reinterpret_cast<const char*>(chunk), size);
+  }
+}
+
+void WorkClient::writeMessage(const std::string& method, const Common::JsonValue& params) {
+  Common::JsonValue message(Common::JsonValue::OBJECT);
+  message.insert("jsonrpc", std::string("2.0"));
+  message.insert("id", static_cast<Common::JsonValue::Integer>(m_nextId++));
+  message.insert("method", method);
+  message.insert("params", params);
+
+  std::string data = message.toString() + "\n";
+  size_t offset = 0;
+  while (offset < data.size()) {
+    offset += m_connection.write(reinterpret_cast<const uint8_t*>(data.data()) + offset, data.size() - offset);
+  }
+}
+
+} //namespace Miner
@@ -0,0 +1,44 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+
+#include <System/Dispatcher.h>
+#include <System/TcpConnection.h>
+
+#include "Common/JsonValue.h"
+#include "Logging/LoggerRef.h"
+#include "Miner.h"
+#include "Rpc/WorkServerCommandsDefinitions.h"
+
+namespace Miner {
+
+// Client of the daemon work server. Jobs arrive as notifications, found nonces are submitted
+// without waiting for the answer, which is logged when it arrives.
+class WorkClient {
+public:
+  WorkClient(System::Dispatcher& dispatcher, Logging::ILogger& logger);
+
+  CryptoNote::WORK_JOB login(const std::string& host, uint16_t port, const std::string& login);
+  // returns the next job notification, answers to submitted shares are logged on the way
+  CryptoNote::WORK_JOB waitJob();
+  void submit(const std::string& jobId, uint32_t nonce);
+
+  static CryptoNote::BlobMiningParameters makeMiningParameters(const CryptoNote::WORK_JOB& job);
+
+private:
+  System::Dispatcher& m_dispatcher;
+  Logging::LoggerRef m_logger;
+  System::TcpConnection m_connection;
+  std::string m_buffer;
+  int64_t m_nextId;
+
+  Common::JsonValue readMessage();
+  void writeMessage(const std::string& method, const Common::JsonValue& params);
+};
+
+} //namespace Miner
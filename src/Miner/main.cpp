@@ -10,6 +10,7 @@
 #include "Logging/ConsoleLogger.h"
 #include "Logging/LoggerRef.h"
 
+#include "MinerBenchmark.h"
 #include "MinerManager.h"
 
 #include <System/Dispatcher.h>
@@ -28,6 +29,11 @@ int main(int argc, char** argv) {
     Logging::ConsoleLogger consoleLogger(static_cast<Logging::Level>(config.logLevel));
     loggerGroup.addLogger(consoleLogger);
 
+    if (config.benchmark) {
+      Miner::MinerBenchmark(config, loggerGroup).run();
+      return 0;
+    }
+
     System::Dispatcher dispatcher;
     Miner::MinerManager app(dispatcher, config, loggerGroup);
 
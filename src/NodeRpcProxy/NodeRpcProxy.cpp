@@ -15,8 +15,7 @@
 #include <HTTP/HttpResponse.h>
 #include <System/ContextGroup.h>
 #include <System/Dispatcher.h>
-#include <System/Event.h>
-#include <System/EventLock.h>
+#include <System/InterruptedException.h>
 #include <System/Timer.h>
 #include <CryptoNoteCore/TransactionApi.h>
 
@@ -53,6 +52,8 @@ std::error_code interpretResponseStatus(const std::string& status) {
 NodeRpcProxy::NodeRpcProxy(const std::string& nodeHost, unsigned short nodePort) :
     m_rpcTimeout(10000),
     m_pullInterval(5000),
+    m_longPollTimeout(30000),
+    m_connectionCount(4),
     m_nodeHost(nodeHost),
     m_nodePort(nodePort),
     m_lastLocalBlockTimestamp(0),
@@ -71,6 +72,10 @@ void NodeRpcProxy::resetInternalState() {
   m_networkHeight.store(0, std::memory_order_relaxed);
   m_lastKnowHash = CryptoNote::NULL_HASH;
   m_knownTxs.clear();
+  m_poolTxs.clear();
+  m_poolFeedId = 0;
+  m_poolSequence = 0;
+  m_poolFeedSupported = true;
 }
 
 void NodeRpcProxy::init(const INode::Callback& callback) {
@@ -105,6 +110,8 @@ bool NodeRpcProxy::shutdown() {
 
   m_dispatcher->remoteSpawn([this]() {
     m_stop = true;
+    // Wake up the status loop, it may wait for the node for a long time
+    m_pullContextGroup->interrupt();
     // Run all spawned contexts
     m_dispatcher->yield();
   });
@@ -123,11 +130,10 @@ void NodeRpcProxy::workerThread(const INode::Callback& initialized_callback) {
     m_dispatcher = &dispatcher;
     ContextGroup contextGroup(dispatcher);
     m_context_group = &contextGroup;
-    HttpClient httpClient(dispatcher, m_nodeHost, m_nodePort);
-    m_httpClient = &httpClient;
-    Event httpEvent(dispatcher);
-    m_httpEvent = &httpEvent;
-    m_httpEvent->set();
+    ContextGroup pullContextGroup(dispatcher);
+    m_pullContextGroup = &pullContextGroup;
+    HttpClientPool httpPool(dispatcher, m_nodeHost, m_nodePort, m_connectionCount);
+    m_httpPool = &httpPool;
 
     {
       std::lock_guard<std::mutex> lock(m_mutex);
@@ -138,16 +144,24 @@ void NodeRpcProxy::workerThread(const INode::Callback& initialized_callback) {
 
     initialized_callback(std::error_code());
 
-    contextGroup.spawn([this]() {
+    pullContextGroup.spawn([this]() {
       Timer pullTimer(*m_dispatcher);
+      // Long poll requests hold their own connection, so regular requests are not blocked behind them
+      HttpClient waitClient(*m_dispatcher, m_nodeHost, m_nodePort);
+      COMMAND_RPC_WAIT_FOR_CHANGES::response changes = AUTO_VAL_INIT(changes);
       while (!m_stop) {
         updateNodeStatus();
-        if (!m_stop) {
-          pullTimer.sleep(std::chrono::milliseconds(m_pullInterval));
+        // Nodes without /wait_for_changes are polled
+        if (!waitForChanges(waitClient, changes) && !m_stop) {
+          try {
+            pullTimer.sleep(std::chrono::milliseconds(m_pullInterval));
+          } catch (InterruptedException&) {
+          }
         }
       }
     });
 
+    pullContextGroup.wait();
     contextGroup.wait();
     // Make sure all remote spawns are executed
     m_dispatcher->yield();
@@ -156,8 +170,8 @@ void NodeRpcProxy::workerThread(const INode::Callback& initialized_callback) {
 
   m_dispatcher = nullptr;
   m_context_group = nullptr;
-  m_httpClient = nullptr;
-  m_httpEvent = nullptr;
+  m_pullContextGroup = nullptr;
+  m_httpPool = nullptr;
   m_connected = false;
   m_rpcProxyObserverManager.notify(&INodeRpcProxyObserver::connectionStatusUpdated, m_connected);
 }
@@ -170,6 +184,21 @@ void NodeRpcProxy::updateNodeStatus() {
   }
 }
 
+bool NodeRpcProxy::waitForChanges(HttpClient& client, COMMAND_RPC_WAIT_FOR_CHANGES::response& changes) {
+  CryptoNote::COMMAND_RPC_WAIT_FOR_CHANGES::request req = AUTO_VAL_INIT(req);
+  req.tail_block_id = changes.tail_block_id;
+  req.pool_version = changes.pool_version;
+  req.timeout = static_cast<uint32_t>(m_longPollTimeout);
+
+  try {
+    invokeJsonCommand(client, "/wait_for_changes", req, changes);
+  } catch (const std::exception&) {
+    return false;
+  }
+
+  return !interpretResponseStatus(changes.status);
+}
+
 bool NodeRpcProxy::updatePoolStatus() {
   std::vector<Crypto::Hash> knownTxs = getKnownTxsVector();
   Crypto::Hash tailBlock = m_lastKnowHash;
@@ -231,8 +260,8 @@ void NodeRpcProxy::updateBlockchainStatus() {
     updatePeerCount(getInfoResp.incoming_connections_count + getInfoResp.outgoing_connections_count);
   }
 
-  if (m_connected != m_httpClient->isConnected()) {
-    m_connected = m_httpClient->isConnected();
+  if (m_connected != m_httpPool->isConnected()) {
+    m_connected = m_httpPool->isConnected();
     m_rpcProxyObserverManager.notify(&INodeRpcProxyObserver::connectionStatusUpdated, m_connected);
   }
 }
@@ -489,7 +518,7 @@ std::error_code NodeRpcProxy::doGetNewBlocks(std::vector<Crypto::Hash>& knownBlo
   CryptoNote::COMMAND_RPC_GET_BLOCKS_FAST::response rsp = AUTO_VAL_INIT(rsp);
   req.block_ids = std::move(knownBlockIds);
 
-  std::error_code ec = binaryCommand("/getblocks.bin", req, rsp);
+  std::error_code ec = binaryCommand("/getblocks.bin", req, rsp, HttpClientPool::PRIORITY_BULK);
   if (!ec) {
     newBlocks = std::move(rsp.blocks);
     startHeight = static_cast<uint32_t>(rsp.start_height);
@@ -504,7 +533,7 @@ std::error_code NodeRpcProxy::doGetTransactionOutsGlobalIndices(const Crypto::Ha
   CryptoNote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response rsp = AUTO_VAL_INIT(rsp);
   req.txid = transactionHash;
 
-  std::error_code ec = binaryCommand("/get_o_indexes.bin", req, rsp);
+  std::error_code ec = binaryCommand("/get_o_indexes.bin", req, rsp, HttpClientPool::PRIORITY_BULK);
   if (!ec) {
     outsGlobalIndices.clear();
     for (auto idx : rsp.o_indexes) {
@@ -523,7 +552,7 @@ std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash>&
   req.blockIds = knownBlockIds;
   req.timestamp = timestamp;
 
-  std::error_code ec = binaryCommand("/queryblockslite.bin", req, rsp);
+  std::error_code ec = binaryCommand("/queryblockslite.bin", req, rsp, HttpClientPool::PRIORITY_BULK);
   if (ec) {
     return ec;
   }
@@ -558,11 +587,49 @@ std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash>&
 
 std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(std::vector<Crypto::Hash>&& knownPoolTxIds, Crypto::Hash knownBlockId, bool& isBcActual,
         std::vector<std::unique_ptr<ITransactionReader>>& newTxs, std::vector<Crypto::Hash>& deletedTxIds) {
+  if (m_poolFeedSupported && m_poolFeedId != 0) {
+    CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_SINCE::request req = AUTO_VAL_INIT(req);
+    CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_SINCE::response rsp = AUTO_VAL_INIT(rsp);
+
+    req.tailBlockId = knownBlockId;
+    req.poolFeedId = m_poolFeedId;
+    req.poolSequence = m_poolSequence;
+
+    std::error_code ec = binaryCommand("/get_pool_changes_since.bin", req, rsp);
+    if (ec) {
+      return ec;
+    }
+
+    if (rsp.isSequenceActual) {
+      // a concurrent request may have applied a newer delta already
+      if (rsp.poolFeedId == m_poolFeedId && rsp.poolSequence >= m_poolSequence) {
+        for (const auto& hash : rsp.deletedTxsIds) {
+          m_poolTxs.erase(hash);
+        }
+
+        for (auto& tpi : rsp.addedTxs) {
+          m_poolTxs[tpi.txHash] = std::move(tpi.txPrefix);
+        }
+
+        m_poolSequence = rsp.poolSequence;
+      }
+
+      isBcActual = rsp.isTailBlockActual;
+      getPoolDifference(knownPoolTxIds, newTxs, deletedTxIds);
+      return ec;
+    }
+
+    m_poolFeedId = 0;
+  }
+
   CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_LITE::request req = AUTO_VAL_INIT(req);
   CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_LITE::response rsp = AUTO_VAL_INIT(rsp);
 
   req.tailBlockId = knownBlockId;
-  req.knownTxsIds = knownPoolTxIds;
+  // without a change feed the node diffs our ids, with it the whole pool is fetched once to seed m_poolTxs
+  if (!m_poolFeedSupported) {
+    req.knownTxsIds = knownPoolTxIds;
+  }
 
   std::error_code ec = binaryCommand("/get_pool_changes_lite.bin", req, rsp);
 
@@ -572,15 +639,46 @@ std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(std::vector<Crypto::H
 
   isBcActual = rsp.isTailBlockActual;
 
-  deletedTxIds = std::move(rsp.deletedTxsIds);
+  if (!m_poolFeedSupported) {
+    deletedTxIds = std::move(rsp.deletedTxsIds);
+
+    for (const auto& tpi : rsp.addedTxs) {
+      newTxs.push_back(createTransactionPrefix(tpi.txPrefix, tpi.txHash));
+    }
+
+    return ec;
+  }
 
-  for (const auto& tpi : rsp.addedTxs) {
-    newTxs.push_back(createTransactionPrefix(tpi.txPrefix, tpi.txHash));
+  m_poolTxs.clear();
+  for (auto& tpi : rsp.addedTxs) {
+    m_poolTxs.emplace(tpi.txHash, std::move(tpi.txPrefix));
   }
 
+  // nodes without the change feed leave the position at zero
+  m_poolFeedSupported = rsp.poolFeedId != 0;
+  m_poolFeedId = rsp.poolFeedId;
+  m_poolSequence = rsp.poolSequence;
+
+  getPoolDifference(knownPoolTxIds, newTxs, deletedTxIds);
   return ec;
 }
 
+void NodeRpcProxy::getPoolDifference(const std::vector<Crypto::Hash>& knownPoolTxIds, std::vector<std::unique_ptr<ITransactionReader>>& newTxs,
+        std::vector<Crypto::Hash>& deletedTxIds) {
+  std::unordered_set<Crypto::Hash> knownTxs(knownPoolTxIds.begin(), knownPoolTxIds.end());
+  for (const auto& tx : m_poolTxs) {
+    if (knownTxs.count(tx.first) == 0) {
+      newTxs.push_back(createTransactionPrefix(tx.second, tx.first));
+    }
+  }
+
+  for (const auto& hash : knownTxs) {
+    if (m_poolTxs.count(hash) == 0) {
+      deletedTxIds.push_back(hash);
+    }
+  }
+}
+
 void NodeRpcProxy::scheduleRequest(std::function<std::error_code()>&& procedure, const Callback& callback) {
   // callback is located on stack, so copy it inside binder
   class Wrapper {
@@ -610,8 +708,8 @@ void NodeRpcProxy::scheduleRequest(std::function<std::error_code()>&& procedure,
           callback(std::make_error_code(std::errc::operation_canceled));
         } else {
           std::error_code ec = procedure();
-          if (m_connected != m_httpClient->isConnected()) {
-            m_connected = m_httpClient->isConnected();
+          if (m_connected != m_httpPool->isConnected()) {
+            m_connected = m_httpPool->isConnected();
             m_rpcProxyObserverManager.notify(&INodeRpcProxyObserver::connectionStatusUpdated, m_connected);
           }
           callback(m_stop ? std::make_error_code(std::errc::operation_canceled) : ec);
@@ -621,12 +719,12 @@ void NodeRpcProxy::scheduleRequest(std::function<std::error_code()>&& procedure,
 }
 
 template <typename Request, typename Response>
-std::error_code NodeRpcProxy::binaryCommand(const std::string& url, const Request& req, Response& res) {
+std::error_code NodeRpcProxy::binaryCommand(const std::string& url, const Request& req, Response& res, HttpClientPool::Priority priority) {
   std::error_code ec;
 
   try {
-    EventLock eventLock(*m_httpEvent);
-    invokeBinaryCommand(*m_httpClient, url, req, res);
+    HttpClientPool::Lease lease(*m_httpPool, priority);
+    invokeBinaryCommand(lease.client(), url, req, res);
     ec = interpretResponseStatus(res.status);
   } catch (const ConnectException&) {
     ec = make_error_code(error::CONNECT_ERROR);
@@ -638,12 +736,12 @@ std::error_code NodeRpcProxy::binaryCommand(const std::string& url, const Reques
 }
 
 template <typename Request, typename Response>
-std::error_code NodeRpcProxy::jsonCommand(const std::string& url, const Request& req, Response& res) {
+std::error_code NodeRpcProxy::jsonCommand(const std::string& url, const Request& req, Response& res, HttpClientPool::Priority priority) {
   std::error_code ec;
 
   try {
-    EventLock eventLock(*m_httpEvent);
-    invokeJsonCommand(*m_httpClient, url, req, res);
+    HttpClientPool::Lease lease(*m_httpPool, priority);
+    invokeJsonCommand(lease.client(), url, req, res);
     ec = interpretResponseStatus(res.status);
   } catch (const ConnectException&) {
     ec = make_error_code(error::CONNECT_ERROR);
@@ -655,11 +753,11 @@ std::error_code NodeRpcProxy::jsonCommand(const std::string& url, const Request&
 }
 
 template <typename Request, typename Response>
-std::error_code NodeRpcProxy::jsonRpcCommand(const std::string& method, const Request& req, Response& res) {
+std::error_code NodeRpcProxy::jsonRpcCommand(const std::string& method, const Request& req, Response& res, HttpClientPool::Priority priority) {
   std::error_code ec = make_error_code(error::INTERNAL_NODE_ERROR);
 
   try {
-    EventLock eventLock(*m_httpEvent);
+    HttpClientPool::Lease lease(*m_httpPool, priority);
 
     JsonRpc::JsonRpcRequest jsReq;
 
@@ -672,7 +770,7 @@ std::error_code NodeRpcProxy::jsonRpcCommand(const std::string& method, const Re
     httpReq.setUrl("/json_rpc");
     httpReq.setBody(jsReq.getBody());
 
-    m_httpClient->request(httpReq, httpRes);
+    lease.client().request(httpReq, httpRes);
 
     JsonRpc::JsonRpcResponse jsRes;
 
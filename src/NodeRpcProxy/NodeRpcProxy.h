@@ -15,11 +15,11 @@
 
 #include "Common/ObserverManager.h"
 #include "INode.h"
+#include "Rpc/HttpClientPool.h"
 
 namespace System {
   class ContextGroup;
   class Dispatcher;
-  class Event;
 }
 
 namespace CryptoNote {
@@ -72,6 +72,10 @@ public:
   unsigned int rpcTimeout() const { return m_rpcTimeout; }
   void rpcTimeout(unsigned int val) { m_rpcTimeout = val; }
 
+  // Number of connections to the node, takes effect on init()
+  size_t connectionCount() const { return m_connectionCount; }
+  void connectionCount(size_t val) { m_connectionCount = val; }
+
 private:
   void resetInternalState();
   void workerThread(const Callback& initialized_callback);
@@ -79,6 +83,7 @@ private:
   std::vector<Crypto::Hash> getKnownTxsVector() const;
   void pullNodeStatusAndScheduleTheNext();
   void updateNodeStatus();
+  bool waitForChanges(HttpClient& client, COMMAND_RPC_WAIT_FOR_CHANGES::response& changes);
   void updateBlockchainStatus();
   bool updatePoolStatus();
   void updatePeerCount(uint64_t peerCount);
@@ -95,14 +100,16 @@ private:
     std::vector<CryptoNote::BlockShortEntry>& newBlocks, uint32_t& startHeight);
   std::error_code doGetPoolSymmetricDifference(std::vector<Crypto::Hash>&& knownPoolTxIds, Crypto::Hash knownBlockId, bool& isBcActual,
           std::vector<std::unique_ptr<ITransactionReader>>& newTxs, std::vector<Crypto::Hash>& deletedTxIds);
+  void getPoolDifference(const std::vector<Crypto::Hash>& knownPoolTxIds, std::vector<std::unique_ptr<ITransactionReader>>& newTxs,
+          std::vector<Crypto::Hash>& deletedTxIds);
 
   void scheduleRequest(std::function<std::error_code()>&& procedure, const Callback& callback);
   template <typename Request, typename Response>
-  std::error_code binaryCommand(const std::string& url, const Request& req, Response& res);
+  std::error_code binaryCommand(const std::string& url, const Request& req, Response& res, HttpClientPool::Priority priority = HttpClientPool::PRIORITY_HIGH);
   template <typename Request, typename Response>
-  std::error_code jsonCommand(const std::string& url, const Request& req, Response& res);
+  std::error_code jsonCommand(const std::string& url, const Request& req, Response& res, HttpClientPool::Priority priority = HttpClientPool::PRIORITY_HIGH);
   template <typename Request, typename Response>
-  std::error_code jsonRpcCommand(const std::string& method, const Request& req, Response& res);
+  std::error_code jsonRpcCommand(const std::string& method, const Request& req, Response& res, HttpClientPool::Priority priority = HttpClientPool::PRIORITY_HIGH);
 
   enum State {
     STATE_NOT_INITIALIZED,
@@ -117,16 +124,19 @@ private:
   std::thread m_workerThread;
   System::Dispatcher* m_dispatcher = nullptr;
   System::ContextGroup* m_context_group = nullptr;
+  System::ContextGroup* m_pullContextGroup = nullptr;
   Tools::ObserverManager<CryptoNote::INodeObserver> m_observerManager;
   Tools::ObserverManager<CryptoNote::INodeRpcProxyObserver> m_rpcProxyObserverManager;
 
   const std::string m_nodeHost;
   const unsigned short m_nodePort;
   unsigned int m_rpcTimeout;
-  HttpClient* m_httpClient = nullptr;
-  System::Event* m_httpEvent = nullptr;
+  size_t m_connectionCount;
+  HttpClientPool* m_httpPool = nullptr;
 
   uint64_t m_pullInterval;
+  // how long the node may hold a /wait_for_changes request
+  uint64_t m_longPollTimeout;
 
   // Internal state
   bool m_stop = false;
@@ -139,6 +149,12 @@ private:
   std::atomic<uint64_t> m_lastLocalBlockTimestamp;
   std::unordered_set<Crypto::Hash> m_knownTxs;
 
+  // copy of the node's ready pool, kept current through /get_pool_changes_since.bin
+  std::unordered_map<Crypto::Hash, TransactionPrefix> m_poolTxs;
+  uint64_t m_poolFeedId;
+  uint64_t m_poolSequence;
+  bool m_poolFeedSupported;
+
   bool m_connected;
 };
 
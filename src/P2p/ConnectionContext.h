@@ -39,6 +39,9 @@ struct CryptoNoteConnectionContext {
   std::unordered_set<Crypto::Hash> m_requested_objects;
   uint32_t m_remote_blockchain_height = 0;
   uint32_t m_last_response_height = 0;
+  uint32_t m_body_span_start = 0; // headers-first sync: first height of the bodies requested from this peer
+  uint32_t m_body_span_count = 0;
+  time_t m_body_span_requested = 0;
 };
 
 inline std::string get_protocol_state_string(CryptoNoteConnectionContext::state s) {
@@ -72,8 +72,7 @@ public:
   template <typename T>
   static bool decode(const BinaryArray& buf, T& value) {
     try {
-      Common::MemoryInputStream stream(buf.data(), buf.size());
-      KVBinaryInputStreamSerializer serializer(stream);
+      KVBinaryInputStreamSerializer serializer(buf.data(), buf.size());
       serialize(value, serializer);
     } catch (std::exception&) {
       return false;
@@ -343,6 +343,16 @@ namespace CryptoNote
     }
   }
 
+  //-----------------------------------------------------------------------------------
+  void NodeServer::drop_connection(const CryptoNoteConnectionContext& context)
+  {
+    auto it = m_connections.find(context.m_connection_id);
+    if (it != m_connections.end() && it->second.context != nullptr) {
+      it->second.m_state = CryptoNoteConnectionContext::state_shutdown;
+      safeInterrupt(it->second);
+    }
+  }
+
   //-----------------------------------------------------------------------------------
   void NodeServer::externalRelayNotifyToAll(int command, const BinaryArray& data_buff, const boost::uuids::uuid* excludeConnection) {
     m_dispatcher.remoteSpawn([this, command, data_buff] {
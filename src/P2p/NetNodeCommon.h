@@ -20,6 +20,7 @@ namespace CryptoNote {
     virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNote::CryptoNoteConnectionContext& context) = 0;
     virtual uint64_t get_connections_count()=0;
     virtual void for_each_connection(std::function<void(CryptoNote::CryptoNoteConnectionContext&, uint64_t)> f) = 0;
+    virtual void drop_connection(const CryptoNote::CryptoNoteConnectionContext& context) = 0;
     // can be called from external threads
     virtual void externalRelayNotifyToAll(int command, const BinaryArray& data_buff, const boost::uuids::uuid* excludeConnection) = 0;
   };
@@ -28,6 +29,7 @@ namespace CryptoNote {
     virtual void relay_notify_to_all(int command, const BinaryArray& data_buff, const boost::uuids::uuid* excludeConnection) override {}
     virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNote::CryptoNoteConnectionContext& context) override { return true; }
     virtual void for_each_connection(std::function<void(CryptoNote::CryptoNoteConnectionContext&, uint64_t)> f) override {}
+    virtual void drop_connection(const CryptoNote::CryptoNoteConnectionContext& context) override {}
     virtual uint64_t get_connections_count() override { return 0; }   
     virtual void externalRelayNotifyToAll(int command, const BinaryArray& data_buff, const boost::uuids::uuid* excludeConnection) override {}
   };
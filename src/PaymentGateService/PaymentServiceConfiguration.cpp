@@ -29,6 +29,7 @@ Configuration::Configuration() {
   bindPort = 0;
   rpcPassword = "";
   legacySecurity = false;
+  rpcMaxBatchSize = 0;
 }
 
 void Configuration::initOptions(boost::program_options::options_description& desc) {
@@ -38,6 +39,7 @@ void Configuration::initOptions(boost::program_options::options_description& des
       ("rpc-password", po::value<std::string>(), "Specify the password to access the rpc server.")
       ("rpc-legacy-security", "Enable legacy mode (no password for RPC). WARNING: INSECURE. USE ONLY AS A LAST RESORT.")
       ("rpc-user", po::value<std::string>()->default_value(""), "username to use the payment service. If authorization is not required, leave it empty")
+      ("rpc-max-batch-size", po::value<uint32_t>()->default_value(100), "maximum number of calls in a JSON-RPC batch request")
       ("container-file,w", po::value<std::string>(), "container file")
       ("container-password,p", po::value<std::string>(), "container password")
       ("generate-container,g", "generate new container file with one wallet and exit")
@@ -93,6 +95,10 @@ void Configuration::init(const boost::program_options::variables_map& options) {
     bindPort = options["bind-port"].as<uint16_t>();
   }
 
+  if (options.count("rpc-max-batch-size") != 0 && (!options["rpc-max-batch-size"].defaulted() || rpcMaxBatchSize == 0)) {
+    rpcMaxBatchSize = options["rpc-max-batch-size"].as<uint32_t>();
+  }
+
   if (options.count("rpc-user") != 0 && !options["rpc-user"].defaulted()) {
     rpcUser = options["rpc-user"].as<std::string>();
   }
@@ -30,6 +30,7 @@ struct Configuration {
   std::string rpcUser;
   std::string rpcPassword;
   bool legacySecurity;
+  uint32_t rpcMaxBatchSize;
 
   std::string containerFile;
   std::string containerPassword;
@@ -0,0 +1,34 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ContextSwitch.h"
+#include <stdint.h>
+#include <string.h>
+
+void contextTrampoline(void);
+
+void* makeContext(void* stack, size_t size, void (*procedure)(void*), void* argument) {
+  uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+#if defined(__x86_64__)
+  // mxcsr and x87 control word, r15, r14, r13, r12, rbx, rbp, return address; see ContextSwitch.S
+  uint64_t* frame = (uint64_t*)(top - 80);
+  memset(frame, 0, 80);
+  ((uint32_t*)frame)[0] = 0x1F80;
+  ((uint16_t*)frame)[2] = 0x037F;
+  frame[3] = (uint64_t)(uintptr_t)procedure;
+  frame[4] = (uint64_t)(uintptr_t)argument;
+  frame[7] = (uint64_t)(uintptr_t)contextTrampoline;
+#elif defined(__aarch64__)
+  // x19-x28, x29, x30, d8-d15 and padding; see ContextSwitch.S
+  uint64_t* frame = (uint64_t*)(top - 176);
+  memset(frame, 0, 176);
+  frame[0] = (uint64_t)(uintptr_t)argument;
+  frame[1] = (uint64_t)(uintptr_t)procedure;
+  frame[11] = (uint64_t)(uintptr_t)contextTrampoline;
+#else
+#error "Context switching is not implemented for this architecture"
+#endif
+  return frame;
+}
@@ -0,0 +1,24 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Saves the callee-saved registers on the current stack, stores the stack pointer to *from and resumes the context in to.
+// Unlike swapcontext, no signal mask is saved or restored, so a switch never enters the kernel.
+void switchContext(void** from, void* to);
+
+// Prepares a context on the given stack that calls procedure(argument) when first switched to.
+// The procedure must never return.
+void* makeContext(void* stack, size_t size, void (*procedure)(void*), void* argument);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,26 +16,24 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Dispatcher.h"
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/timerfd.h>
 #include <fcntl.h>
 #include <string.h>
-#include <ucontext.h>
 #include <unistd.h>
+#include "ContextSwitch.h"
 #include "ErrorMessage.h"
 
 namespace System {
 
 namespace {
 
-struct ContextMakingData {
-  Dispatcher* dispatcher;
-  void* ucontext;
-};
-
 class MutextGuard {
 public:
   MutextGuard(pthread_mutex_t& _mutex) : mutex(_mutex) {
@@ -55,7 +53,26 @@ private:
 
 static_assert(Dispatcher::SIZEOF_PTHREAD_MUTEX_T == sizeof(pthread_mutex_t), "invalid pthread mutex size");
 
-const uint64_t STACK_SIZE = 64 * 1024;
+const size_t DEFAULT_STACK_SIZE = 64 * 1024;
+const size_t MIN_STACK_SIZE = 16 * 1024;
+const size_t DEFAULT_MAX_POOLED_STACKS = 128;
+const int MAX_EPOLL_EVENTS = 64;
+const uint64_t TIMER_TICK_NANOSECONDS = 1000000;
+const uint64_t NO_TIMER_TICK = std::numeric_limits<uint64_t>::max();
+
+size_t pageSize() {
+  static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+uint64_t monotonicNanoseconds() {
+  timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == -1) {
+    throw std::runtime_error("clock_gettime failed, " + lastErrorMessage());
+  }
+
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
 
 };
 
@@ -65,46 +82,76 @@ Dispatcher::Dispatcher() {
   if (epoll == -1) {
     message = "epoll_create1 failed, " + lastErrorMessage();
   } else {
-    mainContext.ucontext = new ucontext_t;
-    if (getcontext(reinterpret_cast<ucontext_t*>(mainContext.ucontext)) == -1) {
-      message = "getcontext failed, " + lastErrorMessage();
+    mainContext.ucontext = nullptr;
+    remoteSpawnEvent = eventfd(0, O_NONBLOCK);
+    if(remoteSpawnEvent == -1) {
+      message = "eventfd failed, " + lastErrorMessage();
     } else {
-      remoteSpawnEvent = eventfd(0, O_NONBLOCK);
-      if(remoteSpawnEvent == -1) {
-        message = "eventfd failed, " + lastErrorMessage();
-      } else {
-        remoteSpawnEventContext.writeContext = nullptr;
-        remoteSpawnEventContext.readContext = nullptr;
+      remoteSpawnEventContext.writeContext = nullptr;
+      remoteSpawnEventContext.readContext = nullptr;
+      remoteSpawnEventContext.readyEvents = 0;
 
-        epoll_event remoteSpawnEventEpollEvent;
-        remoteSpawnEventEpollEvent.events = EPOLLIN;
-        remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
+      epoll_event remoteSpawnEventEpollEvent;
+      remoteSpawnEventEpollEvent.events = EPOLLIN;
+      remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
 
-        if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
-          message = "epoll_ctl failed, " + lastErrorMessage();
+      if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
+        message = "epoll_ctl failed, " + lastErrorMessage();
+      } else {
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (timer == -1) {
+          message = "timerfd_create failed, " + lastErrorMessage();
         } else {
-          *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
-
-          mainContext.interrupted = false;
-          mainContext.group = &contextGroup;
-          mainContext.groupPrev = nullptr;
-          mainContext.groupNext = nullptr;
-          mainContext.inExecutionQueue = false;
-          contextGroup.firstContext = nullptr;
-          contextGroup.lastContext = nullptr;
-          contextGroup.firstWaiter = nullptr;
-          contextGroup.lastWaiter = nullptr;
-          currentContext = &mainContext;
-          firstResumingContext = nullptr;
-          firstReusableContext = nullptr;
-          runningContextCount = 0;
-          return;
-        }
+          timerEventContext.writeContext = nullptr;
+          timerEventContext.readContext = nullptr;
+          timerEventContext.readyEvents = 0;
+
+          epoll_event timerEvent;
+          timerEvent.events = EPOLLIN;
+          timerEvent.data.ptr = &timerEventContext;
+
+          if (epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &timerEvent) == -1) {
+            message = "epoll_ctl failed, " + lastErrorMessage();
+          } else {
+            *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
+
+            mainContext.interrupted = false;
+            mainContext.group = &contextGroup;
+            mainContext.groupPrev = nullptr;
+            mainContext.groupNext = nullptr;
+            mainContext.inExecutionQueue = false;
+            contextGroup.firstContext = nullptr;
+            contextGroup.lastContext = nullptr;
+            contextGroup.firstWaiter = nullptr;
+            contextGroup.lastWaiter = nullptr;
+            currentContext = &mainContext;
+            firstResumingContext = nullptr;
+            firstReusableContext = nullptr;
+            retiredContext = nullptr;
+            runningContextCount = 0;
+            stackSize = DEFAULT_STACK_SIZE;
+            maxPooledStacks = DEFAULT_MAX_POOLED_STACKS;
+            stackCount = 0;
+            pooledStackCount = 0;
+            timerTick = 0;
+            armedTimerTick = NO_TIMER_TICK;
+            timerCount = 0;
+            for (auto& level : timerWheel) {
+              std::fill(std::begin(level), std::end(level), nullptr);
+            }
+
+            return;
+          }
 
-        auto result = close(remoteSpawnEvent);
-        if (result) {}
-        assert(result == 0);
+          auto result = close(timer);
+          if (result) {}
+          assert(result == 0);
+        }
       }
+
+      auto result = close(remoteSpawnEvent);
+      if (result) {}
+      assert(result == 0);
     }
 
     auto result = close(epoll);
@@ -125,22 +172,13 @@ Dispatcher::~Dispatcher() {
   assert(contextGroup.firstWaiter == nullptr);
   assert(firstResumingContext == nullptr);
   assert(runningContextCount == 0);
-  while (firstReusableContext != nullptr) {
-    auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-    auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
-    firstReusableContext = firstReusableContext->next;
-    delete[] stackPtr;
-    delete ucontext;
-  }
+  releaseRetiredContext();
+  releasePooledStacks(0);
 
-  while (!timers.empty()) {
-    int result = ::close(timers.top());
-    if (result) {}
-    assert(result == 0);
-    timers.pop();
-  }
-
-  auto result = close(epoll);
+  assert(timerCount == 0);
+  auto result = close(timer);
+  assert(result == 0);
+  result = close(epoll);
   if (result) {}
   assert(result == 0);
   result = close(remoteSpawnEvent);
@@ -150,22 +188,8 @@ Dispatcher::~Dispatcher() {
 }
 
 void Dispatcher::clear() {
-  while (firstReusableContext != nullptr) {
-    auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-    auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
-    firstReusableContext = firstReusableContext->next;
-    delete[] stackPtr;
-    delete ucontext;
-  }
-
-  while (!timers.empty()) {
-    int result = ::close(timers.top());
-    if (result == -1) {
-      throw std::runtime_error("Dispatcher::clear, close failed, "  + lastErrorMessage());
-    }
-
-    timers.pop();
-  }
+  releaseRetiredContext();
+  releasePooledStacks(0);
 }
 
 void Dispatcher::dispatch() {
@@ -181,38 +205,14 @@ void Dispatcher::dispatch() {
       break;
     }
 
-    epoll_event event;
-    int count = epoll_wait(epoll, &event, 1, -1);
-    if (count == 1) {
-      ContextPair *contextPair = static_cast<ContextPair*>(event.data.ptr);
-      if(((event.events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
-        uint64_t buf;
-        auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
-        if(transferred == -1) {
-            throw std::runtime_error("Dispatcher::dispatch, read(remoteSpawnEvent) failed, " + lastErrorMessage());
-        }
-
-        MutextGuard guard(*reinterpret_cast<pthread_mutex_t*>(this->mutex));
-        while (!remoteSpawningProcedures.empty()) {
-          spawn(std::move(remoteSpawningProcedures.front()));
-          remoteSpawningProcedures.pop();
-        }
-
-        continue;
+    epoll_event events[MAX_EPOLL_EVENTS];
+    int count = epoll_wait(epoll, events, MAX_EPOLL_EVENTS, -1);
+    if (count != -1) {
+      for (int i = 0; i < count; ++i) {
+        processEvent(static_cast<ContextPair*>(events[i].data.ptr), events[i].events);
       }
 
-      if ((event.events & EPOLLOUT) != 0) {
-        context = contextPair->writeContext->context;
-        contextPair->writeContext->events = event.events;
-      } else if ((event.events & EPOLLIN) != 0) {
-        context = contextPair->readContext->context;
-        contextPair->readContext->events = event.events;
-      } else {
-        continue;
-      }
-
-      assert(context != nullptr);
-      break;
+      continue;
     }
 
     if (errno != EINTR) {
@@ -221,10 +221,11 @@ void Dispatcher::dispatch() {
   }
 
   if (context != currentContext) {
-    ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext->ucontext);
+    NativeContext* oldContext = currentContext;
     currentContext = context;
-    if (swapcontext(oldContext, static_cast<ucontext_t *>(context->ucontext)) == -1) {
-      throw std::runtime_error("Dispatcher::dispatch, swapcontext failed, " + lastErrorMessage());
+    switchContext(&oldContext->ucontext, context->ucontext);
+    if (retiredContext != nullptr) {
+      releaseRetiredContext();
     }
   }
 }
@@ -309,52 +310,70 @@ void Dispatcher::spawn(std::function<void()>&& procedure) {
   pushContext(context);
 }
 
+void Dispatcher::processEvent(ContextPair* contextPair, uint32_t events) {
+  if (contextPair == &remoteSpawnEventContext) {
+    uint64_t buf;
+    auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
+    if(transferred == -1) {
+        throw std::runtime_error("Dispatcher::dispatch, read(remoteSpawnEvent) failed, " + lastErrorMessage());
+    }
+
+    MutextGuard guard(*reinterpret_cast<pthread_mutex_t*>(this->mutex));
+    while (!remoteSpawningProcedures.empty()) {
+      spawn(std::move(remoteSpawningProcedures.front()));
+      remoteSpawningProcedures.pop();
+    }
+
+    return;
+  }
+
+  if (contextPair == &timerEventContext) {
+    uint64_t expirations;
+    if (read(timer, &expirations, sizeof expirations) == -1 && errno != EAGAIN) {
+      throw std::runtime_error("Dispatcher::dispatch, read(timer) failed, " + lastErrorMessage());
+    }
+
+    armedTimerTick = NO_TIMER_TICK;
+    advanceTimers(monotonicNanoseconds() / TIMER_TICK_NANOSECONDS);
+    armTimer(nextTimerTick());
+    return;
+  }
+
+  // Edge-triggered sources report each transition once, so the readiness is
+  // remembered even when nobody is waiting on that direction yet.
+  contextPair->readyEvents |= events;
+  if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0 && contextPair->writeContext != nullptr) {
+    OperationContext* operation = contextPair->writeContext;
+    if (operation->context != nullptr) {
+      operation->context->interruptProcedure = nullptr;
+    }
+
+    operation->events = events;
+    pushContext(operation->context);
+  }
+
+  if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) != 0 && contextPair->readContext != nullptr) {
+    OperationContext* operation = contextPair->readContext;
+    if (operation->context != nullptr) {
+      operation->context->interruptProcedure = nullptr;
+    }
+
+    operation->events = events;
+    pushContext(operation->context);
+  }
+}
+
 void Dispatcher::yield() {
   for(;;){
-    epoll_event events[16];
-    int count = epoll_wait(epoll, events, 16, 0);
+    epoll_event events[MAX_EPOLL_EVENTS];
+    int count = epoll_wait(epoll, events, MAX_EPOLL_EVENTS, 0);
     if (count == 0) {
       break;
     }
 
     if(count > 0) {
       for(int i = 0; i < count; ++i) {
-        ContextPair *contextPair = static_cast<ContextPair*>(events[i].data.ptr);
-        if(((events[i].events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
-          uint64_t buf;
-          auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
-          if(transferred == -1) {
-            throw std::runtime_error("Dispatcher::dispatch, read(remoteSpawnEvent) failed, " + lastErrorMessage());
-          }
-
-          MutextGuard guard(*reinterpret_cast<pthread_mutex_t*>(this->mutex));
-          while (!remoteSpawningProcedures.empty()) {
-            spawn(std::move(remoteSpawningProcedures.front()));
-            remoteSpawningProcedures.pop();
-          }
-
-          continue;
-        }
-
-        if ((events[i].events & EPOLLOUT) != 0) {
-          if (contextPair->writeContext != nullptr) {
-            if (contextPair->writeContext->context != nullptr) {
-              contextPair->writeContext->context->interruptProcedure = nullptr;
-            }
-            pushContext(contextPair->writeContext->context);
-            contextPair->writeContext->events = events[i].events;
-          }
-        } else if ((events[i].events & EPOLLIN) != 0) {
-          if (contextPair->readContext != nullptr) {
-            if (contextPair->readContext->context != nullptr) {
-              contextPair->readContext->context->interruptProcedure = nullptr;
-            }
-            pushContext(contextPair->readContext->context);
-            contextPair->readContext->events = events[i].events;
-          }
-        } else {
-          continue;
-        }
+        processEvent(static_cast<ContextPair*>(events[i].data.ptr), events[i].events);
       }
     } else {
       if (errno != EINTR) {
@@ -375,74 +394,246 @@ int Dispatcher::getEpoll() const {
 
 NativeContext& Dispatcher::getReusableContext() {
   if(firstReusableContext == nullptr) {
-    ucontext_t* newlyCreatedContext = new ucontext_t;
-    if (getcontext(newlyCreatedContext) == -1) { //makecontext precondition
-      throw std::runtime_error("Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage());
+    // The lowest page stays inaccessible, so an overflow faults instead of corrupting the heap.
+    // Pages above it are committed by the kernel only when the coroutine first touches them.
+    size_t mappingSize = stackSize + pageSize();
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Dispatcher::getReusableContext, mmap failed, " + lastErrorMessage());
     }
 
-    auto stackPointer = new uint8_t[STACK_SIZE];
-    newlyCreatedContext->uc_stack.ss_sp = stackPointer;
-    newlyCreatedContext->uc_stack.ss_size = STACK_SIZE;
-
-    ContextMakingData makingContextData {this, newlyCreatedContext};
-    makecontext(newlyCreatedContext, (void(*)())contextProcedureStatic, 1, reinterpret_cast<int*>(&makingContextData));
-
-    ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext->ucontext);
-    if (swapcontext(oldContext, newlyCreatedContext) == -1) {
-      throw std::runtime_error("Dispatcher::getReusableContext, swapcontext failed, " + lastErrorMessage());
+    if (mprotect(mapping, pageSize(), PROT_NONE) == -1) {
+      std::string message = "Dispatcher::getReusableContext, mprotect failed, " + lastErrorMessage();
+      munmap(mapping, mappingSize);
+      throw std::runtime_error(message);
     }
 
+    void* newlyCreatedContext = makeContext(static_cast<uint8_t*>(mapping) + pageSize(), stackSize, contextProcedureStatic, this);
+    switchContext(&currentContext->ucontext, newlyCreatedContext);
     assert(firstReusableContext != nullptr);
-    assert(firstReusableContext->ucontext == newlyCreatedContext);
-    firstReusableContext->stackPtr = stackPointer;
+    assert(firstReusableContext->ucontext != nullptr);
+    firstReusableContext->stackPtr = mapping;
+    firstReusableContext->stackSize = mappingSize;
+    ++stackCount;
+    ++pooledStackCount;
   };
 
   NativeContext* context = firstReusableContext;
   firstReusableContext = firstReusableContext-> next;
+  --pooledStackCount;
   return *context;
 }
 
 void Dispatcher::pushReusableContext(NativeContext& context) {
-  context.next = firstReusableContext;
-  firstReusableContext = &context;
   --runningContextCount;
+  if (pooledStackCount < maxPooledStacks && context.stackSize == stackSize + pageSize()) {
+    context.next = firstReusableContext;
+    firstReusableContext = &context;
+    ++pooledStackCount;
+  } else if (&context != currentContext) {
+    releaseStack(context);
+  } else {
+    // Still running on this stack, it is unmapped right after the next context switch.
+    assert(retiredContext == nullptr);
+    retiredContext = &context;
+  }
+}
+
+void Dispatcher::setStackSize(size_t size) {
+  size = std::max(size, MIN_STACK_SIZE);
+  stackSize = (size + pageSize() - 1) / pageSize() * pageSize();
+  releasePooledStacks(0);
 }
 
-int Dispatcher::getTimer() {
-  int timer;
-  if (timers.empty()) {
-    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-    epoll_event timerEvent;
-    timerEvent.events = EPOLLONESHOT;
-    timerEvent.data.ptr = nullptr;
+void Dispatcher::setMaxPooledStacks(size_t count) {
+  maxPooledStacks = count;
+  releasePooledStacks(maxPooledStacks);
+}
+
+size_t Dispatcher::getLiveStackCount() const {
+  return stackCount - pooledStackCount;
+}
+
+size_t Dispatcher::getPooledStackCount() const {
+  return pooledStackCount;
+}
+
+void Dispatcher::releasePooledStacks(size_t keep) {
+  while (pooledStackCount > keep) {
+    NativeContext* context = firstReusableContext;
+    firstReusableContext = firstReusableContext->next;
+    --pooledStackCount;
+    releaseStack(*context);
+  }
+}
 
-    if (epoll_ctl(getEpoll(), EPOLL_CTL_ADD, timer, &timerEvent) == -1) {
-      throw std::runtime_error("Dispatcher::getTimer, epoll_ctl failed, "  + lastErrorMessage());
+void Dispatcher::releaseStack(NativeContext& context) {
+  // The context itself lives on the stack being unmapped.
+  void* mapping = context.stackPtr;
+  size_t mappingSize = context.stackSize;
+  int result = munmap(mapping, mappingSize);
+  if (result) {}
+  assert(result == 0);
+  --stackCount;
+}
+
+void Dispatcher::releaseRetiredContext() {
+  if (retiredContext != nullptr) {
+    assert(retiredContext != currentContext);
+    NativeContext* context = retiredContext;
+    retiredContext = nullptr;
+    releaseStack(*context);
+  }
+}
+
+void Dispatcher::addTimer(TimerContext& timerContext, std::chrono::nanoseconds duration) {
+  uint64_t now = monotonicNanoseconds();
+  if (timerCount == 0) {
+    // Nothing is scheduled, so the wheel can jump to the present instead of stepping through idle ticks.
+    timerTick = now / TIMER_TICK_NANOSECONDS;
+  }
+
+  uint64_t expireNanoseconds = duration.count() > 0 ? now + static_cast<uint64_t>(duration.count()) : now;
+  timerContext.expireTick = std::max(expireNanoseconds / TIMER_TICK_NANOSECONDS + 1, timerTick + 1);
+  uint64_t tick = insertTimer(timerContext);
+  ++timerCount;
+  if (tick < armedTimerTick) {
+    armTimer(tick);
+  }
+}
+
+void Dispatcher::removeTimer(TimerContext& timerContext) {
+  assert(timerContext.prevLink != nullptr);
+  *timerContext.prevLink = timerContext.next;
+  if (timerContext.next != nullptr) {
+    timerContext.next->prevLink = timerContext.prevLink;
+  }
+
+  timerContext.next = nullptr;
+  timerContext.prevLink = nullptr;
+  --timerCount;
+}
+
+// Places the timer into the wheel relative to timerTick and returns the tick at which its slot is visited next.
+uint64_t Dispatcher::insertTimer(TimerContext& timerContext) {
+  assert(timerContext.expireTick >= timerTick);
+  uint64_t expireTick = timerContext.expireTick;
+  uint64_t maxDelay = (uint64_t(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+  if (expireTick - timerTick > maxDelay) {
+    // Parked in the last level, it is reinserted when that slot cascades.
+    expireTick = timerTick + maxDelay;
+  }
+
+  unsigned level = 0;
+  while (level + 1 < TIMER_WHEEL_LEVELS && expireTick - timerTick >= (uint64_t(1) << (TIMER_WHEEL_BITS * (level + 1)))) {
+    ++level;
+  }
+
+  unsigned shift = TIMER_WHEEL_BITS * level;
+  TimerContext** head = &timerWheel[level][(expireTick >> shift) & (TIMER_WHEEL_SLOTS - 1)];
+  timerContext.next = *head;
+  timerContext.prevLink = head;
+  if (*head != nullptr) {
+    (*head)->prevLink = &timerContext.next;
+  }
+
+  *head = &timerContext;
+  return (expireTick >> shift) << shift;
+}
+
+void Dispatcher::cascadeTimers(unsigned level) {
+  unsigned shift = TIMER_WHEEL_BITS * level;
+  uint64_t slot = (timerTick >> shift) & (TIMER_WHEEL_SLOTS - 1);
+  if (slot == 0 && level + 1 < TIMER_WHEEL_LEVELS) {
+    cascadeTimers(level + 1);
+  }
+
+  TimerContext* timerContext = timerWheel[level][slot];
+  timerWheel[level][slot] = nullptr;
+  while (timerContext != nullptr) {
+    TimerContext* next = timerContext->next;
+    insertTimer(*timerContext);
+    timerContext = next;
+  }
+}
+
+void Dispatcher::advanceTimers(uint64_t tick) {
+  while (timerTick < tick) {
+    if (timerCount == 0) {
+      timerTick = tick;
+      break;
+    }
+
+    ++timerTick;
+    if ((timerTick & (TIMER_WHEEL_SLOTS - 1)) == 0) {
+      cascadeTimers(1);
+    }
+
+    TimerContext* timerContext = timerWheel[0][timerTick & (TIMER_WHEEL_SLOTS - 1)];
+    timerWheel[0][timerTick & (TIMER_WHEEL_SLOTS - 1)] = nullptr;
+    while (timerContext != nullptr) {
+      TimerContext* next = timerContext->next;
+      assert(timerContext->expireTick == timerTick);
+      timerContext->next = nullptr;
+      timerContext->prevLink = nullptr;
+      --timerCount;
+      timerContext->context->interruptProcedure = nullptr;
+      pushContext(timerContext->context);
+      timerContext = next;
     }
-  } else {
-    timer = timers.top();
-    timers.pop();
   }
+}
 
-  return timer;
+uint64_t Dispatcher::nextTimerTick() const {
+  uint64_t tick = NO_TIMER_TICK;
+  if (timerCount == 0) {
+    return tick;
+  }
+
+  for (unsigned level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+    unsigned shift = TIMER_WHEEL_BITS * level;
+    for (uint64_t index = (timerTick >> shift) + 1; index <= (timerTick >> shift) + TIMER_WHEEL_SLOTS; ++index) {
+      if (timerWheel[level][index & (TIMER_WHEEL_SLOTS - 1)] != nullptr) {
+        tick = std::min(tick, index << shift);
+        break;
+      }
+    }
+  }
+
+  return tick;
 }
 
-void Dispatcher::pushTimer(int timer) {
-  timers.push(timer);
+void Dispatcher::armTimer(uint64_t tick) {
+  if (tick == armedTimerTick) {
+    return;
+  }
+
+  itimerspec expires;
+  expires.it_interval.tv_sec = expires.it_interval.tv_nsec = 0;
+  if (tick == NO_TIMER_TICK) {
+    expires.it_value.tv_sec = expires.it_value.tv_nsec = 0;
+  } else {
+    expires.it_value.tv_sec = tick / 1000;
+    expires.it_value.tv_nsec = (tick % 1000) * TIMER_TICK_NANOSECONDS;
+  }
+
+  if (timerfd_settime(timer, TFD_TIMER_ABSTIME, &expires, NULL) == -1) {
+    throw std::runtime_error("Dispatcher::armTimer, timerfd_settime failed, " + lastErrorMessage());
+  }
+
+  armedTimerTick = tick;
 }
 
-void Dispatcher::contextProcedure(void* ucontext) {
+void Dispatcher::contextProcedure() {
   assert(firstReusableContext == nullptr);
   NativeContext context;
-  context.ucontext = ucontext;
+  context.ucontext = nullptr;
   context.interrupted = false;
   context.next = nullptr;
   context.inExecutionQueue = false;
   firstReusableContext = &context;
-  ucontext_t* oldContext = static_cast<ucontext_t*>(context.ucontext);
-  if (swapcontext(oldContext, static_cast<ucontext_t*>(currentContext->ucontext)) == -1) {
-    throw std::runtime_error("Dispatcher::contextProcedure, swapcontext failed, " + lastErrorMessage());
-  }
+  switchContext(&context.ucontext, currentContext->ucontext);
+  releaseRetiredContext();
 
   for (;;) {
     ++runningContextCount;
@@ -492,8 +683,7 @@ void Dispatcher::contextProcedure(void* ucontext) {
 };
 
 void Dispatcher::contextProcedureStatic(void *context) {
-  ContextMakingData* makingContextData = reinterpret_cast<ContextMakingData*>(context);
-  makingContextData->dispatcher->contextProcedure(makingContextData->ucontext);
+  static_cast<Dispatcher*>(context)->contextProcedure();
 }
 
 }
\ No newline at end of file
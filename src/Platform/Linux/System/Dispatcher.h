@@ -17,10 +17,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <queue>
-#include <stack>
 #ifndef __GLIBC__
 #include <bits/reg.h>
 #endif
@@ -32,6 +33,7 @@ struct NativeContextGroup;
 struct NativeContext {
   void* ucontext;
   void* stackPtr;
+  size_t stackSize;
   bool interrupted;
   bool inExecutionQueue;
   NativeContext* next;
@@ -55,9 +57,18 @@ struct OperationContext {
   uint32_t events;
 };
 
+struct TimerContext {
+  NativeContext* context;
+  bool interrupted;
+  uint64_t expireTick;
+  TimerContext* next;
+  TimerContext** prevLink;
+};
+
 struct ContextPair {
   OperationContext *readContext;
   OperationContext *writeContext;
+  uint32_t readyEvents; // readiness latched from edge-triggered notifications
 };
 
 class Dispatcher {
@@ -80,8 +91,15 @@ public:
   int getEpoll() const;
   NativeContext& getReusableContext();
   void pushReusableContext(NativeContext&);
-  int getTimer();
-  void pushTimer(int timer);
+  void addTimer(TimerContext& timerContext, std::chrono::nanoseconds duration);
+  void removeTimer(TimerContext& timerContext);
+
+  // Coroutine stacks are mmap'ed with a guard page below them; idle ones are kept for reuse up to maxPooledStacks.
+  // Changing the stack size drops the pooled stacks; live ones are released when they finish.
+  void setStackSize(size_t size);
+  void setMaxPooledStacks(size_t count);
+  size_t getLiveStackCount() const;
+  size_t getPooledStackCount() const;
 
 #ifdef __x86_64__
 # if __WORDSIZE == 64
@@ -94,13 +112,32 @@ public:
 #endif
 
 private:
+  // Hierarchical timer wheel with millisecond ticks, driven by a single timerfd.
+  static const unsigned TIMER_WHEEL_BITS = 8;
+  static const unsigned TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+  static const unsigned TIMER_WHEEL_LEVELS = 4;
+
   void spawn(std::function<void()>&& procedure);
+  void processEvent(ContextPair* contextPair, uint32_t events);
+  uint64_t insertTimer(TimerContext& timerContext);
+  void cascadeTimers(unsigned level);
+  void advanceTimers(uint64_t tick);
+  uint64_t nextTimerTick() const;
+  void armTimer(uint64_t tick);
+  void releasePooledStacks(size_t keep);
+  void releaseStack(NativeContext& context);
+  void releaseRetiredContext();
   int epoll;
   alignas(void*) uint8_t mutex[SIZEOF_PTHREAD_MUTEX_T];
   int remoteSpawnEvent;
   ContextPair remoteSpawnEventContext;
   std::queue<std::function<void()>> remoteSpawningProcedures;
-  std::stack<int> timers;
+  int timer;
+  ContextPair timerEventContext;
+  uint64_t timerTick;
+  uint64_t armedTimerTick;
+  uint64_t timerCount;
+  TimerContext* timerWheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
 
   NativeContext mainContext;
   NativeContextGroup contextGroup;
@@ -108,9 +145,14 @@ private:
   NativeContext* firstResumingContext;
   NativeContext* lastResumingContext;
   NativeContext* firstReusableContext;
+  NativeContext* retiredContext;
   uint64_t runningContextCount;
+  size_t stackSize;
+  size_t maxPooledStacks;
+  size_t stackCount;
+  size_t pooledStackCount;
 
-  void contextProcedure(void* ucontext);
+  void contextProcedure();
   static void contextProcedureStatic(void* context);
 };
 
@@ -28,6 +28,13 @@
 
 namespace System {
 
+namespace {
+
+const uint32_t READ_EVENTS = EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+const uint32_t WRITE_EVENTS = EPOLLOUT | EPOLLERR | EPOLLHUP;
+
+}
+
 TcpConnection::TcpConnection() : dispatcher(nullptr) {
 }
 
@@ -38,6 +45,7 @@ TcpConnection::TcpConnection(TcpConnection&& other) : dispatcher(other.dispatche
     connection = other.connection;
     contextPair = other.contextPair;
     other.dispatcher = nullptr;
+    updateRegistration();
   }
 }
 
@@ -67,6 +75,7 @@ TcpConnection& TcpConnection::operator=(TcpConnection&& other) {
     connection = other.connection;
     contextPair = other.contextPair;
     other.dispatcher = nullptr;
+    updateRegistration();
   }
 
   return *this;
@@ -79,85 +88,25 @@ uint64_t TcpConnection::read(uint8_t* data, uint64_t size) {
     throw InterruptedException();
   }
 
-  std::string message;
-  ssize_t transferred = ::recv(connection, (void *)data, size, 0);
-  if (transferred == -1) {
-    if (errno != EAGAIN) {
-      message = "recv failed, " + lastErrorMessage();
-    } else {
-      epoll_event connectionEvent;
-      OperationContext operationContext;
-      operationContext.interrupted = false;
-      operationContext.context = dispatcher->getCurrentContext();
-      contextPair.readContext = &operationContext;
-      connectionEvent.data.ptr = &contextPair;
-
-      if(contextPair.writeContext != nullptr) {
-        connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
-      } else {
-        connectionEvent.events = EPOLLIN | EPOLLONESHOT;
+  for (;;) {
+    // The socket is registered edge-triggered, so recv is only worth trying
+    // when an edge arrived since the last time it reported EAGAIN.
+    if ((contextPair.readyEvents & READ_EVENTS) != 0) {
+      ssize_t transferred = ::recv(connection, (void *)data, size, 0);
+      if (transferred != -1) {
+        assert(transferred <= static_cast<ssize_t>(size));
+        return transferred;
       }
 
-      if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-        message = "epoll_ctl failed, " + lastErrorMessage();
-      } else {
-        dispatcher->getCurrentContext()->interruptProcedure = [&]() {
-            assert(dispatcher != nullptr);
-            assert(contextPair.readContext != nullptr);
-            epoll_event connectionEvent;
-            connectionEvent.events = 0;
-            connectionEvent.data.ptr = nullptr;
-
-            if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-              throw std::runtime_error("TcpConnection::stop, epoll_ctl failed, " + lastErrorMessage());
-            }
-
-            contextPair.readContext->interrupted = true;
-            dispatcher->pushContext(contextPair.readContext->context);
-        };
-
-        dispatcher->dispatch();
-        dispatcher->getCurrentContext()->interruptProcedure = nullptr;
-        assert(dispatcher != nullptr);
-        assert(operationContext.context == dispatcher->getCurrentContext());
-        assert(contextPair.readContext == &operationContext);
-
-        if (operationContext.interrupted) {
-          contextPair.readContext = nullptr;
-          throw InterruptedException();
-        }
-
-        contextPair.readContext = nullptr;
-        if(contextPair.writeContext != nullptr) { //write is presented, rearm
-          epoll_event connectionEvent;
-          connectionEvent.events = EPOLLOUT | EPOLLONESHOT;
-          connectionEvent.data.ptr = &contextPair;
-
-          if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-            message = "epoll_ctl failed, " + lastErrorMessage();
-            throw std::runtime_error("TcpConnection::read");
-          }
-        }
-
-        if((operationContext.events & (EPOLLERR | EPOLLHUP)) != 0) {
-          throw std::runtime_error("TcpConnection::read");
-        }
-
-        ssize_t transferred = ::recv(connection, (void *)data, size, 0);
-        if (transferred == -1) {
-          message = "recv failed, " + lastErrorMessage();
-        } else {
-          assert(transferred <= static_cast<ssize_t>(size));
-          return transferred;
-        }
+      if (errno != EAGAIN) {
+        throw std::runtime_error("TcpConnection::read, recv failed, " + lastErrorMessage());
       }
+
+      contextPair.readyEvents &= ~(EPOLLIN | EPOLLRDHUP);
     }
 
-    throw std::runtime_error("TcpConnection::read, "+ message);
+    waitForEvents(contextPair.readContext);
   }
-
-  assert(transferred <= static_cast<ssize_t>(size));
-  return transferred;
 }
 
 std::uint64_t TcpConnection::write(const uint8_t* data, uint64_t size) {
@@ -167,7 +116,6 @@ std::uint64_t TcpConnection::write(const uint8_t* data, uint64_t size) {
     throw InterruptedException();
   }
 
-  std::string message;
   if(size == 0) {
     if(shutdown(connection, SHUT_WR) == -1) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + lastErrorMessage());
@@ -176,84 +124,23 @@ std::uint64_t TcpConnection::write(const uint8_t* data, uint64_t size) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
-  if (transferred == -1) {
-    if (errno != EAGAIN) {
-      message = "send failed, " + lastErrorMessage();
-    } else {
-      epoll_event connectionEvent;
-      OperationContext operationContext;
-      operationContext.interrupted = false;
-      operationContext.context = dispatcher->getCurrentContext();
-      contextPair.writeContext = &operationContext;
-      connectionEvent.data.ptr = &contextPair;
-
-      if(contextPair.readContext != nullptr) {
-        connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
-      } else {
-        connectionEvent.events = EPOLLOUT | EPOLLONESHOT;
+  for (;;) {
+    if ((contextPair.readyEvents & WRITE_EVENTS) != 0) {
+      ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
+      if (transferred != -1) {
+        assert(transferred <= static_cast<ssize_t>(size));
+        return transferred;
       }
 
-      if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-        message = "epoll_ctl failed, " + lastErrorMessage();
-      } else {
-        dispatcher->getCurrentContext()->interruptProcedure = [&]() {
-            assert(dispatcher != nullptr);
-            assert(contextPair.writeContext != nullptr);
-            epoll_event connectionEvent;
-            connectionEvent.events = 0;
-            connectionEvent.data.ptr = nullptr;
-
-            if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-              throw std::runtime_error("TcpConnection::stop, epoll_ctl failed, " + lastErrorMessage());
-            }
-
-            contextPair.writeContext->interrupted = true;
-            dispatcher->pushContext(contextPair.writeContext->context);
-        };
-
-        dispatcher->dispatch();
-        dispatcher->getCurrentContext()->interruptProcedure = nullptr;
-        assert(dispatcher != nullptr);
-        assert(operationContext.context == dispatcher->getCurrentContext());
-        assert(contextPair.writeContext == &operationContext);
-
-        if (operationContext.interrupted) {
-          contextPair.writeContext = nullptr;
-          throw InterruptedException();
-        }
-
-        contextPair.writeContext = nullptr;
-        if(contextPair.readContext != nullptr) { //read is presented, rearm
-          epoll_event connectionEvent;
-          connectionEvent.events = EPOLLIN | EPOLLONESHOT;
-          connectionEvent.data.ptr = &contextPair;
-
-          if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-            message = "epoll_ctl failed, " + lastErrorMessage();
-            throw std::runtime_error("TcpConnection::write, " + message);
-          }
-        }
-
-        if((operationContext.events & (EPOLLERR | EPOLLHUP)) != 0) {
-          throw std::runtime_error("TcpConnection::write, events & (EPOLLERR | EPOLLHUP) != 0");
-        }
-
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
-        if (transferred == -1) {
-          message = "send failed, "  + lastErrorMessage();
-        } else {
-          assert(transferred <= static_cast<ssize_t>(size));
-          return transferred;
-        }
+      if (errno != EAGAIN) {
+        throw std::runtime_error("TcpConnection::write, send failed, " + lastErrorMessage());
       }
+
+      contextPair.readyEvents &= ~EPOLLOUT;
     }
 
-    throw std::runtime_error("TcpConnection::write, " + message);
+    waitForEvents(contextPair.writeContext);
   }
-
-  assert(transferred <= static_cast<ssize_t>(size));
-  return transferred;
 }
 
 std::pair<Ipv4Address, uint16_t> TcpConnection::getPeerAddressAndPort() const {
@@ -270,13 +157,50 @@ std::pair<Ipv4Address, uint16_t> TcpConnection::getPeerAddressAndPort() const {
 TcpConnection::TcpConnection(Dispatcher& dispatcher, int socket) : dispatcher(&dispatcher), connection(socket) {
   contextPair.readContext = nullptr;
   contextPair.writeContext = nullptr;
+  contextPair.readyEvents = EPOLLIN | EPOLLOUT;
   epoll_event connectionEvent;
-  connectionEvent.events = EPOLLONESHOT;
-  connectionEvent.data.ptr = nullptr;
+  connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  connectionEvent.data.ptr = &contextPair;
 
   if (epoll_ctl(dispatcher.getEpoll(), EPOLL_CTL_ADD, socket, &connectionEvent) == -1) {
     throw std::runtime_error("TcpConnection::TcpConnection, epoll_ctl failed, " + lastErrorMessage());
   }
 }
 
+void TcpConnection::updateRegistration() {
+  epoll_event connectionEvent;
+  connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  connectionEvent.data.ptr = &contextPair;
+
+  if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
+    throw std::runtime_error("TcpConnection::updateRegistration, epoll_ctl failed, " + lastErrorMessage());
+  }
+}
+
+void TcpConnection::waitForEvents(OperationContext*& operation) {
+  OperationContext operationContext;
+  operationContext.interrupted = false;
+  operationContext.context = dispatcher->getCurrentContext();
+  operationContext.events = 0;
+  operation = &operationContext;
+
+  dispatcher->getCurrentContext()->interruptProcedure = [&]() {
+    assert(dispatcher != nullptr);
+    assert(operation != nullptr);
+    operation->interrupted = true;
+    dispatcher->pushContext(operation->context);
+  };
+
+  dispatcher->dispatch();
+  dispatcher->getCurrentContext()->interruptProcedure = nullptr;
+  assert(dispatcher != nullptr);
+  assert(operationContext.context == dispatcher->getCurrentContext());
+  assert(operation == &operationContext);
+  operation = nullptr;
+
+  if (operationContext.interrupted) {
+    throw InterruptedException();
+  }
+}
+
 }
@@ -36,6 +36,8 @@ private:
   ContextPair contextPair;
 
   TcpConnection(Dispatcher& dispatcher, int socket);
+  void updateRegistration();
+  void waitForEvents(OperationContext*& operation);
 };
 
 }
@@ -96,6 +96,7 @@ TcpConnection TcpConnector::connect(const Ipv4Address& address, uint16_t port) {
 
             contextPair.readContext = nullptr;
             contextPair.writeContext = &connectorContext;
+            contextPair.readyEvents = 0;
 
             epoll_event connectEvent;
             connectEvent.events = EPOLLOUT | EPOLLRDHUP | EPOLLERR | EPOLLONESHOT;
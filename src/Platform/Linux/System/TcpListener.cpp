@@ -121,6 +121,7 @@ TcpConnection TcpListener::accept() {
 
   contextPair.writeContext = nullptr;
   contextPair.readContext = &listenerContext;
+  contextPair.readyEvents = 0;
 
   epoll_event listenEvent;
   listenEvent.events = EPOLLIN | EPOLLONESHOT;
@@ -134,12 +134,50 @@ struct COMMAND_RPC_GET_POOL_CHANGES_LITE {
     bool isTailBlockActual;
     std::vector<TransactionPrefixInfo> addedTxs;          // Added transactions blobs
     std::vector<Crypto::Hash> deletedTxsIds; // IDs of not found transactions
+    uint64_t poolFeedId;   // change feed position the difference was taken at, for /get_pool_changes_since.bin
+    uint64_t poolSequence;
     std::string status;
 
     void serialize(ISerializer &s) {
       KV_MEMBER(isTailBlockActual)
       KV_MEMBER(addedTxs)
       serializeAsBinary(deletedTxsIds, "deletedTxsIds", s);
+      KV_MEMBER(poolFeedId)
+      KV_MEMBER(poolSequence)
+      KV_MEMBER(status)
+    }
+  };
+};
+
+struct COMMAND_RPC_GET_POOL_CHANGES_SINCE {
+  struct request {
+    Crypto::Hash tailBlockId;
+    uint64_t poolFeedId;
+    uint64_t poolSequence;
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(tailBlockId)
+      KV_MEMBER(poolFeedId)
+      KV_MEMBER(poolSequence)
+    }
+  };
+
+  struct response {
+    bool isTailBlockActual;
+    bool isSequenceActual;                   // false if the client has to resync with /get_pool_changes_lite.bin
+    std::vector<TransactionPrefixInfo> addedTxs;          // Transactions added since the sequence and still in the pool
+    std::vector<Crypto::Hash> deletedTxsIds; // IDs of transactions removed since the sequence
+    uint64_t poolFeedId;
+    uint64_t poolSequence;
+    std::string status;
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(isTailBlockActual)
+      KV_MEMBER(isSequenceActual)
+      KV_MEMBER(addedTxs)
+      serializeAsBinary(deletedTxsIds, "deletedTxsIds", s);
+      KV_MEMBER(poolFeedId)
+      KV_MEMBER(poolSequence)
       KV_MEMBER(status)
     }
   };
@@ -254,6 +292,36 @@ struct COMMAND_RPC_START_MINING {
   };
 };
 //-----------------------------------------------
+// Long poll: answers as soon as the chain tip or the pool version differs from the ones
+// sent by the client, or when the timeout expires
+struct COMMAND_RPC_WAIT_FOR_CHANGES {
+  struct request {
+    std::string tail_block_id;
+    uint64_t pool_version;
+    uint32_t timeout; // milliseconds
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(tail_block_id)
+      KV_MEMBER(pool_version)
+      KV_MEMBER(timeout)
+    }
+  };
+
+  struct response {
+    std::string tail_block_id;
+    uint32_t height;
+    uint64_t pool_version;
+    std::string status;
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(tail_block_id)
+      KV_MEMBER(height)
+      KV_MEMBER(pool_version)
+      KV_MEMBER(status)
+    }
+  };
+};
+//-----------------------------------------------
 struct COMMAND_RPC_GET_INFO {
   typedef EMPTY_STRUCT request;
 
@@ -376,10 +444,12 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
   struct request {
     uint64_t reserve_size; //max 255 bytes
     std::string wallet_address;
+    std::string longpollid; // if set, wait until the template differs from the one this id was returned with
 
     void serialize(ISerializer &s) {
       KV_MEMBER(reserve_size)
       KV_MEMBER(wallet_address)
+      KV_MEMBER(longpollid)
     }
   };
 
@@ -388,6 +458,7 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
     uint32_t height;
     uint64_t reserved_offset;
     std::string blocktemplate_blob;
+    std::string longpollid;
     std::string status;
 
     void serialize(ISerializer &s) {
@@ -395,6 +466,7 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
       KV_MEMBER(height)
       KV_MEMBER(reserved_offset)
       KV_MEMBER(blocktemplate_blob)
+      KV_MEMBER(longpollid)
       KV_MEMBER(status)
     }
   };
@@ -17,7 +17,8 @@
 
 #include "HttpClient.h"
 
-#include <HTTP/HttpParser.h>
+#include <sstream>
+
 #include <System/Ipv4Resolver.h>
 #include <System/Ipv4Address.h>
 #include <System/TcpConnector.h>
@@ -40,11 +41,15 @@ void HttpClient::request(const HttpRequest &req, HttpResponse &res) {
   }
 
   try {
-    std::iostream stream(m_streamBuf.get());
-    HttpParser parser;
+    std::ostringstream stream;
     stream << req;
-    stream.flush();
-    parser.receiveResponse(stream, res);
+    const std::string data = stream.str();
+    size_t offset = 0;
+    while (offset < data.size()) {
+      offset += m_connection.write(reinterpret_cast<const uint8_t*>(data.data()) + offset, data.size() - offset);
+    }
+
+    m_parser->receiveResponse(res);
   } catch (const std::exception &) {
     disconnect();
     throw;
@@ -55,7 +60,9 @@ void HttpClient::connect() {
   try {
     auto ipAddr = System::Ipv4Resolver(m_dispatcher).resolve(m_address);
     m_connection = System::TcpConnector(m_dispatcher).connect(ipAddr, m_port);
-    m_streamBuf.reset(new System::TcpStreambuf(m_connection));
+    m_parser.reset(new HttpParser([this](char* data, size_t size) {
+      return m_connection.read(reinterpret_cast<uint8_t*>(data), size);
+    }));
     m_connected = true;
   } catch (const std::exception& e) {
     throw ConnectException(e.what());
@@ -67,7 +74,7 @@ bool HttpClient::isConnected() const {
 }
 
 void HttpClient::disconnect() {
-  m_streamBuf.reset();
+  m_parser.reset();
   try {
     m_connection.write(nullptr, 0); //Socket shutdown.
   } catch (std::exception&) {
@@ -20,10 +20,10 @@
 #include <memory>
 
 #include <Common/Base64.h>
+#include <HTTP/HttpParser.h>
 #include <HTTP/HttpRequest.h>
 #include <HTTP/HttpResponse.h>
 #include <System/TcpConnection.h>
-#include <System/TcpStream.h>
 #include "JsonRpc.h"
 
 #include "Serialization/SerializationTools.h"
@@ -41,11 +41,12 @@ public:
   HttpClient(System::Dispatcher& dispatcher, const std::string& address, uint16_t port);
   ~HttpClient();
   void request(const HttpRequest& req, HttpResponse& res);
-  
+  // Opens the connection ahead of the first request, throws ConnectException
+  void connect();
+
   bool isConnected() const;
 
 private:
-  void connect();
   void disconnect();
 
   const std::string m_address;
@@ -54,7 +55,7 @@ private:
   bool m_connected = false;
   System::Dispatcher& m_dispatcher;
   System::TcpConnection m_connection;
-  std::unique_ptr<System::TcpStreambuf> m_streamBuf;
+  std::unique_ptr<HttpParser> m_parser;
 };
 
 template <typename Request, typename Response>
@@ -0,0 +1,101 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "HttpClientPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace CryptoNote {
+
+namespace {
+
+const std::chrono::milliseconds MIN_CONNECT_BACKOFF(250);
+const std::chrono::milliseconds MAX_CONNECT_BACKOFF(30000);
+
+}
+
+HttpClientPool::Lease::Lease(HttpClientPool& pool, Priority priority) : m_pool(pool), m_client(pool.acquire(priority)) {
+}
+
+HttpClientPool::Lease::~Lease() {
+  m_pool.release(m_client);
+}
+
+HttpClientPool::HttpClientPool(System::Dispatcher& dispatcher, const std::string& address, uint16_t port, size_t size) :
+  m_connections(std::max<size_t>(size, 1)), m_busyCount(0), m_released(dispatcher), m_connected(true), m_backoff(0) {
+  for (Connection& connection : m_connections) {
+    connection.client.reset(new HttpClient(dispatcher, address, port));
+    connection.busy = false;
+  }
+}
+
+bool HttpClientPool::isConnected() const {
+  return m_connected;
+}
+
+HttpClient* HttpClientPool::acquire(Priority priority) {
+  // the last connection is kept for high priority requests
+  size_t reserved = priority == PRIORITY_BULK && m_connections.size() > 1 ? 1 : 0;
+  while (m_connections.size() - m_busyCount <= reserved) {
+    m_released.wait();
+  }
+
+  // prefer an open connection
+  Connection* connection = nullptr;
+  for (Connection& candidate : m_connections) {
+    if (!candidate.busy && (connection == nullptr || candidate.client->isConnected())) {
+      connection = &candidate;
+      if (candidate.client->isConnected()) {
+        break;
+      }
+    }
+  }
+
+  assert(connection != nullptr);
+  if (!connection->client->isConnected()) {
+    if (std::chrono::steady_clock::now() < m_nextConnect) {
+      m_connected = false;
+      throw ConnectException("Node is unreachable, next attempt is delayed");
+    }
+
+    // the connection is taken while connecting, the context yields
+    connection->busy = true;
+    ++m_busyCount;
+    try {
+      connection->client->connect();
+    } catch (ConnectException&) {
+      m_backoff = std::min(std::max(m_backoff * 2, MIN_CONNECT_BACKOFF), MAX_CONNECT_BACKOFF);
+      m_nextConnect = std::chrono::steady_clock::now() + m_backoff;
+      release(connection->client.get());
+      throw;
+    }
+
+    m_backoff = std::chrono::milliseconds(0);
+    return connection->client.get();
+  }
+
+  connection->busy = true;
+  ++m_busyCount;
+  return connection->client.get();
+}
+
+void HttpClientPool::release(HttpClient* client) {
+  for (Connection& connection : m_connections) {
+    if (connection.client.get() == client) {
+      assert(connection.busy);
+      connection.busy = false;
+      --m_busyCount;
+      break;
+    }
+  }
+
+  m_connected = client->isConnected();
+  // wake up all waiters, each one checks for a free connection again
+  m_released.set();
+  m_released.clear();
+}
+
+}
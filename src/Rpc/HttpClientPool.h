@@ -0,0 +1,71 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <System/Event.h>
+
+#include "HttpClient.h"
+
+namespace CryptoNote {
+
+// Keep-alive connections to one node, checked out for the duration of a request. Bulk requests
+// never take the last free connection, so short latency sensitive requests do not queue behind
+// a long sync request. Failed connects are retried with exponential backoff.
+class HttpClientPool {
+public:
+  enum Priority {
+    PRIORITY_HIGH,
+    PRIORITY_BULK
+  };
+
+  class Lease {
+  public:
+    // Suspends the calling context until a connection is free. Throws ConnectException if the
+    // connection cannot be opened or the node is in backoff.
+    Lease(HttpClientPool& pool, Priority priority);
+    Lease(const Lease&) = delete;
+    ~Lease();
+
+    Lease& operator=(const Lease&) = delete;
+
+    HttpClient& client() { return *m_client; }
+
+  private:
+    HttpClientPool& m_pool;
+    HttpClient* m_client;
+  };
+
+  HttpClientPool(System::Dispatcher& dispatcher, const std::string& address, uint16_t port, size_t size);
+  HttpClientPool(const HttpClientPool&) = delete;
+
+  HttpClientPool& operator=(const HttpClientPool&) = delete;
+
+  // State of the connection used by the last finished request
+  bool isConnected() const;
+
+private:
+  struct Connection {
+    std::unique_ptr<HttpClient> client;
+    bool busy;
+  };
+
+  HttpClient* acquire(Priority priority);
+  void release(HttpClient* client);
+
+  std::vector<Connection> m_connections;
+  size_t m_busyCount;
+  System::Event m_released;
+  bool m_connected;
+  std::chrono::milliseconds m_backoff;
+  std::chrono::steady_clock::time_point m_nextConnect;
+};
+
+}
@@ -22,10 +22,13 @@
 
 #include <Common/Base64.h>
 #include <HTTP/HttpParser.h>
+#include <HTTP/HttpParserErrorCodes.h>
 #include <System/InterruptedException.h>
-#include <System/TcpStream.h>
 #include <System/Ipv4Address.h>
 
+#include <chrono>
+#include <sstream>
+
 using namespace Logging;
 
 namespace {
@@ -35,6 +38,32 @@ namespace {
 		response.addHeader("Content-Type", "text/plain");
 		response.setBody("Authorization required");
 	}
+
+	// a request over the parser limits is answered with 413 or 431 before the connection is closed
+	bool fillTooLargeResponse(const std::system_error& error, CryptoNote::HttpResponse& response) {
+		if (error.code().category() != CryptoNote::error::HttpParserErrorCategory::INSTANCE) {
+			return false;
+		}
+
+		if (error.code().value() == CryptoNote::error::HttpParserErrorCodes::BODY_TOO_LARGE) {
+			response.setStatus(CryptoNote::HttpResponse::STATUS_413);
+		} else if (error.code().value() == CryptoNote::error::HttpParserErrorCodes::HEAD_TOO_LARGE) {
+			response.setStatus(CryptoNote::HttpResponse::STATUS_431);
+		} else {
+			return false;
+		}
+
+		response.addHeader("content-type", "text/plain");
+		response.addHeader("Connection", "close");
+		return true;
+	}
+
+	void writeAll(System::TcpConnection& connection, const std::string& data) {
+		size_t offset = 0;
+		while (offset < data.size()) {
+			offset += connection.write(reinterpret_cast<const uint8_t*>(data.data()) + offset, data.size() - offset);
+		}
+	}
 }
 
 namespace CryptoNote {
@@ -75,8 +104,10 @@ void HttpServer::acceptLoop() {
     }
 
     m_connections.insert(&connection);
+    m_metrics.connectionOpened();
     BOOST_SCOPE_EXIT_ALL(this, &connection) { 
-      m_connections.erase(&connection); };
+      m_connections.erase(&connection);
+      m_metrics.connectionClosed(); };
 
 	workingContextGroup.spawn(std::bind(&HttpServer::acceptLoop, this));
 
@@ -90,9 +121,10 @@ void HttpServer::acceptLoop() {
 
     logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
 
-    System::TcpStreambuf streambuf(connection);
-    std::iostream stream(&streambuf);
-    HttpParser parser;
+    // Requests are parsed straight from the socket; pipelined requests stay buffered in the parser
+    HttpParser parser([&connection](char* data, size_t size) {
+      return connection.read(reinterpret_cast<uint8_t*>(data), size);
+    });
 
     for (;;) {
       HttpRequest req;
@@ -100,21 +132,41 @@ void HttpServer::acceptLoop() {
 	  resp.addHeader("Access-Control-Allow-Origin", "*");
 	  resp.addHeader("content-type", "application/json");
 	
-      parser.receiveRequest(stream, req);
-				if (authenticate(req)) {
-					processRequest(req, resp);
-				}
-				else {
+      try {
+        if (!parser.receiveRequest(req)) {
+          break;
+        }
+      } catch (std::system_error& e) {
+        if (!fillTooLargeResponse(e, resp)) {
+          throw;
+        }
+
+        logger(DEBUGGING) << "Rejecting request from " << addr.first.toDottedDecimal() << ":" << addr.second << ": " << e.what();
+        std::ostringstream stream;
+        stream << resp;
+        writeAll(connection, stream.str());
+        break;
+      }
+
+				if (!authenticate(req)) {
 					logger(WARNING) << "Authorization required " << addr.first.toDottedDecimal() << ":" << addr.second;
 					fillUnauthorizedResponse(resp);
+				} else if (req.getUrl() == "/metrics") {
+					std::string metrics;
+					writeMetrics(metrics);
+					resp.addHeader("content-type", "text/plain; version=0.0.4");
+					resp.setBody(metrics);
+				} else {
+					auto start = std::chrono::steady_clock::now();
+					processRequest(req, resp);
+					// unknown urls share one route, so clients cannot grow the metrics without bound
+					const std::string& route = resp.getStatus() == HttpResponse::STATUS_404 ? "unmatched" : req.getUrl();
+					m_metrics.record(route, std::chrono::steady_clock::now() - start, req.getBody().size(), resp.getBody().size(), resp.getStatus() != HttpResponse::STATUS_200);
 				}
 
+      std::ostringstream stream;
       stream << resp;
-      stream.flush();
-
-      if (stream.peek() == std::iostream::traits_type::eof()) {
-        break;
-      }
+      writeAll(connection, stream.str());
     }
 
     logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
@@ -144,6 +196,10 @@ bool HttpServer::authenticate(const HttpRequest& request) const {
 	return true;
 }
 
+void HttpServer::writeMetrics(std::string& out) {
+  m_metrics.write("rpc_", out);
+}
+
 uint64_t HttpServer::get_connections_count() const {
 	return m_connections.size();
 }
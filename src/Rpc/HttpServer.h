@@ -31,6 +31,8 @@
 
 #include <Logging/LoggerRef.h>
 
+#include "RpcMetrics.h"
+
 namespace CryptoNote {
 
 class HttpServer {
@@ -47,7 +49,11 @@ public:
 
 protected:
 
+  // Body of the /metrics route, in the Prometheus text format
+  virtual void writeMetrics(std::string& out);
+
   System::Dispatcher& m_dispatcher;
+  RpcMetrics m_metrics;
 
 private:
 
@@ -22,6 +22,7 @@
 #include <functional>
 
 #include "CoreRpcServerCommandsDefinitions.h"
+#include <Common/JsonDocument.h>
 #include <Common/JsonValue.h>
 #include "Serialization/ISerializer.h"
 #include "Serialization/SerializationTools.h"
@@ -68,42 +69,36 @@ typedef boost::optional<Common::JsonValue> OptionalPassword;
 class JsonRpcRequest {
 public:
   
-  JsonRpcRequest() : psReq(Common::JsonValue::OBJECT) {}
+  JsonRpcRequest() {
+    psReq.setObject(psReq.getRoot());
+  }
 
   bool parseRequest(const std::string& requestBody) {
     try {
-      psReq = Common::JsonValue::fromString(requestBody);
+      psReq.parse(requestBody);
     } catch (std::exception&) {
       throw JsonRpcError(errParseError);
     }
 
-    if (!psReq.contains("method")) {
-      throw JsonRpcError(errInvalidRequest);
-    }
-
-    method = psReq("method").getString();
-
-    if (psReq.contains("id")) {
-      id = psReq("id");
-    }
-
-	  if (psReq.contains("password")) {
-		  password = psReq("password");
-    }
+    return readRequest();
+  }
 
-    return true;
+  // Takes a single call of a batch request
+  bool parseRequest(const Common::JsonNode& request) {
+    psReq.assign(psReq.getRoot(), request);
+    return readRequest();
   }
 
   template <typename T>
   bool loadParams(T& v) const {
-    loadFromJsonValue(v, psReq.contains("params") ? 
-      psReq("params") : Common::JsonValue(Common::JsonValue::NIL));
+    const Common::JsonNode* params = psReq.getRoot().find("params");
+    loadFromJsonNode(v, params != nullptr ? *params : Common::JsonNode());
     return true;
   }
 
   template <typename T>
   bool setParams(const T& v) {
-    psReq.set("params", storeToJsonValue(v));
+    storeToJsonNode(v, psReq, psReq.set(psReq.getRoot(), "params"));
     return true;
   }
 
@@ -123,15 +118,40 @@ public:
     return id;
   }
 
+  Common::JsonValue getParams() const {
+    const Common::JsonNode* params = psReq.getRoot().find("params");
+    return params != nullptr ? Common::JsonDocument::toJsonValue(*params) : Common::JsonValue(Common::JsonValue::NIL);
+  }
+
   std::string getBody() {
-    psReq.set("jsonrpc", std::string("2.0"));
-    psReq.set("method", method);
+    psReq.setString(psReq.set(psReq.getRoot(), "jsonrpc"), "2.0");
+    psReq.setString(psReq.set(psReq.getRoot(), "method"), method);
     return psReq.toString();
   }
 
 private:
 
-  Common::JsonValue psReq;
+  bool readRequest() {
+    const Common::JsonNode& root = psReq.getRoot();
+    const Common::JsonNode* methodNode = root.isObject() ? root.find("method") : nullptr;
+    if (methodNode == nullptr) {
+      throw JsonRpcError(errInvalidRequest);
+    }
+
+    method = std::string(methodNode->getString());
+
+    if (const Common::JsonNode* idNode = root.find("id")) {
+      id = Common::JsonDocument::toJsonValue(*idNode);
+    }
+
+    if (const Common::JsonNode* passwordNode = root.find("password")) {
+      password = Common::JsonDocument::toJsonValue(*passwordNode);
+    }
+
+    return true;
+  }
+
+  Common::JsonDocument psReq;
   OptionalId id;
   OptionalPassword password;
   std::string method;
@@ -141,58 +161,80 @@ private:
 class JsonRpcResponse {
 public:
 
-  JsonRpcResponse() : psResp(Common::JsonValue::OBJECT) {}
+  JsonRpcResponse() {
+    psResp.setObject(psResp.getRoot());
+  }
 
   void parse(const std::string& responseBody) {
     try {
-      psResp = Common::JsonValue::fromString(responseBody);
+      psResp.parse(responseBody);
     } catch (std::exception&) {
       throw JsonRpcError(errParseError);
     }
+
+    if (!psResp.getRoot().isObject()) {
+      throw JsonRpcError(errParseError);
+    }
   }
 
   void setId(const OptionalId& id) {
-    if (id.is_initialized()) {
-      psResp.insert("id", id.get());
+    if (id.is_initialized() && psResp.getRoot().find("id") == nullptr) {
+      psResp.assign(psResp.insert(psResp.getRoot(), "id"), id.get());
     }
   }
 
   void setError(const JsonRpcError& err) {
-    psResp.set("error", storeToJsonValue(err));
+    storeToJsonNode(err, psResp, psResp.set(psResp.getRoot(), "error"));
   }
 
   bool getError(JsonRpcError& err) const {
-    if (!psResp.contains("error")) {
+    const Common::JsonNode* error = psResp.getRoot().find("error");
+    if (error == nullptr) {
       return false;
     }
 
-    loadFromJsonValue(err, psResp("error"));
+    loadFromJsonNode(err, *error);
     return true;
   }
 
   std::string getBody() {
-    psResp.set("jsonrpc", std::string("2.0"));
+    psResp.setString(psResp.set(psResp.getRoot(), "jsonrpc"), "2.0");
     return psResp.toString();
   }
 
   template <typename T>
   bool setResult(const T& v) {
-    psResp.set("result", storeToJsonValue(v));
+    storeToJsonNode(v, psResp, psResp.set(psResp.getRoot(), "result"));
     return true;
   }
 
   template <typename T>
   bool getResult(T& v) const {
-    if (!psResp.contains("result")) {
+    const Common::JsonNode* result = psResp.getRoot().find("result");
+    if (result == nullptr) {
+      return false;
+    }
+
+    loadFromJsonNode(v, *result);
+    return true;
+  }
+
+  void setResultValue(const Common::JsonValue& v) {
+    psResp.assign(psResp.set(psResp.getRoot(), "result"), v);
+  }
+
+  bool getResultValue(Common::JsonValue& v) const {
+    const Common::JsonNode* result = psResp.getRoot().find("result");
+    if (result == nullptr) {
       return false;
     }
 
-    loadFromJsonValue(v, psResp("result"));
+    v = Common::JsonDocument::toJsonValue(*result);
     return true;
   }
 
 private:
-  Common::JsonValue psResp;
+  Common::JsonDocument psResp;
 };
 
 
@@ -0,0 +1,118 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "RpcMetrics.h"
+
+#include <cstdio>
+
+namespace CryptoNote {
+
+namespace {
+
+const uint64_t FIRST_BUCKET_MICROSECONDS = 250;
+
+void writeHeader(std::string& out, const std::string& name, const char* type, const char* help) {
+  out += "# HELP " + name + ' ' + help + "\n# TYPE " + name + ' ' + type + '\n';
+}
+
+void writeSample(std::string& out, const std::string& name, const std::string& labels, const std::string& value) {
+  out += name;
+  if (!labels.empty()) {
+    out += '{' + labels + '}';
+  }
+
+  out += ' ' + value + '\n';
+}
+
+void writeSample(std::string& out, const std::string& name, const std::string& labels, uint64_t value) {
+  writeSample(out, name, labels, std::to_string(value));
+}
+
+void writeSample(std::string& out, const std::string& name, const std::string& labels, double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  writeSample(out, name, labels, std::string(buffer));
+}
+
+}
+
+RpcMetrics::RpcMetrics() : m_connections(0), m_connectionsTotal(0) {
+}
+
+void RpcMetrics::connectionOpened() {
+  ++m_connections;
+  ++m_connectionsTotal;
+}
+
+void RpcMetrics::connectionClosed() {
+  --m_connections;
+}
+
+void RpcMetrics::record(const std::string& route, std::chrono::steady_clock::duration latency, size_t requestBytes, size_t responseBytes, bool error) {
+  Route& metrics = m_routes[route];
+  ++metrics.requests;
+  if (error) {
+    ++metrics.errors;
+  }
+
+  metrics.requestBytes += requestBytes;
+  metrics.responseBytes += responseBytes;
+  metrics.latencySum += std::chrono::duration<double>(latency).count();
+
+  uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+  size_t bucket = 0;
+  for (uint64_t bound = FIRST_BUCKET_MICROSECONDS; bucket < BUCKET_COUNT && microseconds > bound; bound *= 2) {
+    ++bucket;
+  }
+
+  ++metrics.buckets[bucket];
+}
+
+void RpcMetrics::write(const std::string& prefix, std::string& out) const {
+  writeHeader(out, prefix + "connections", "gauge", "Open HTTP connections.");
+  writeSample(out, prefix + "connections", "", m_connections);
+  writeHeader(out, prefix + "connections_total", "counter", "Accepted HTTP connections.");
+  writeSample(out, prefix + "connections_total", "", m_connectionsTotal);
+
+  writeHeader(out, prefix + "requests_total", "counter", "Requests served per route.");
+  for (const auto& route : m_routes) {
+    writeSample(out, prefix + "requests_total", "route=\"" + route.first + '"', route.second.requests);
+  }
+
+  writeHeader(out, prefix + "errors_total", "counter", "Requests answered with an error per route.");
+  for (const auto& route : m_routes) {
+    writeSample(out, prefix + "errors_total", "route=\"" + route.first + '"', route.second.errors);
+  }
+
+  writeHeader(out, prefix + "request_bytes_total", "counter", "Request body bytes per route.");
+  for (const auto& route : m_routes) {
+    writeSample(out, prefix + "request_bytes_total", "route=\"" + route.first + '"', route.second.requestBytes);
+  }
+
+  writeHeader(out, prefix + "response_bytes_total", "counter", "Response body bytes per route.");
+  for (const auto& route : m_routes) {
+    writeSample(out, prefix + "response_bytes_total", "route=\"" + route.first + '"', route.second.responseBytes);
+  }
+
+  std::string name = prefix + "request_duration_seconds";
+  writeHeader(out, name, "histogram", "Request handling time per route.");
+  for (const auto& route : m_routes) {
+    std::string label = "route=\"" + route.first + '"';
+    uint64_t cumulative = 0;
+    uint64_t bound = FIRST_BUCKET_MICROSECONDS;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i, bound *= 2) {
+      cumulative += route.second.buckets[i];
+      char le[32];
+      snprintf(le, sizeof(le), "%g", static_cast<double>(bound) / 1000000);
+      writeSample(out, name + "_bucket", label + ",le=\"" + le + '"', cumulative);
+    }
+
+    writeSample(out, name + "_bucket", label + ",le=\"+Inf\"", route.second.requests);
+    writeSample(out, name + "_sum", label, route.second.latencySum);
+    writeSample(out, name + "_count", label, route.second.requests);
+  }
+}
+
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace CryptoNote {
+
+// Request counters and latency histograms per route, written in the Prometheus text format.
+// Updated and read on the dispatcher thread only.
+class RpcMetrics {
+public:
+  // upper bounds of the latency buckets are 250us * 2^i, the last bucket is +Inf
+  static const size_t BUCKET_COUNT = 17;
+
+  RpcMetrics();
+
+  void connectionOpened();
+  void connectionClosed();
+
+  void record(const std::string& route, std::chrono::steady_clock::duration latency, size_t requestBytes, size_t responseBytes, bool error);
+
+  // Appends all metrics to out, names are prefixed with 'prefix'
+  void write(const std::string& prefix, std::string& out) const;
+
+private:
+  struct Route {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t requestBytes = 0;
+    uint64_t responseBytes = 0;
+    double latencySum = 0;
+    std::array<uint64_t, BUCKET_COUNT + 1> buckets = {};
+  };
+
+  std::map<std::string, Route> m_routes;
+  uint64_t m_connections;
+  uint64_t m_connectionsTotal;
+};
+
+}
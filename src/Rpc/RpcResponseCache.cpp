@@ -0,0 +1,98 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "RpcResponseCache.h"
+
+namespace CryptoNote {
+
+namespace {
+
+// Chain and pool responses such as getinfo also carry peer counts, which are not covered by the key
+const std::chrono::seconds TIP_ENTRY_TTL(5);
+const std::chrono::seconds HISTORY_ENTRY_TTL(60 * 60);
+
+}
+
+RpcResponseCache::RpcResponseCache(size_t maxEntries) : m_maxEntries(maxEntries), m_poolVersion(0), m_hits(0), m_misses(0) {
+}
+
+bool RpcResponseCache::find(const std::string& key, Scope scope, const Crypto::Hash& blockHash, Entry& entry) {
+  auto now = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      const Entry& cached = it->second;
+      if (cached.blockHash == blockHash && now < cached.expires && (cached.scope != CACHE_POOL || cached.poolVersion == m_poolVersion)) {
+        entry = cached;
+        ++m_hits;
+        return true;
+      }
+
+      m_entries.erase(it);
+    }
+
+    entry.poolVersion = m_poolVersion;
+  }
+
+  entry.scope = scope;
+  entry.blockHash = blockHash;
+  entry.expires = now + (scope == CACHE_HISTORY ? HISTORY_ENTRY_TTL : TIP_ENTRY_TTL);
+  ++m_misses;
+  return false;
+}
+
+void RpcResponseCache::store(const std::string& key, Entry&& entry) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_entries.size() >= m_maxEntries) {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+      if (it->second.expires <= now) {
+        it = m_entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    if (m_entries.size() >= m_maxEntries) {
+      m_entries.clear();
+    }
+  }
+
+  m_entries[key] = std::move(entry);
+}
+
+void RpcResponseCache::chainUpdated() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  erase(CACHE_CHAIN);
+  erase(CACHE_POOL);
+}
+
+void RpcResponseCache::poolUpdated() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_poolVersion;
+  erase(CACHE_POOL);
+}
+
+uint64_t RpcResponseCache::getHits() const {
+  return m_hits;
+}
+
+uint64_t RpcResponseCache::getMisses() const {
+  return m_misses;
+}
+
+void RpcResponseCache::erase(Scope scope) {
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (it->second.scope == scope) {
+      it = m_entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}
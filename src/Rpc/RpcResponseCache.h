@@ -0,0 +1,65 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Common/JsonValue.h"
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+// Responses of hot RPC methods, keyed by method and normalized parameters.
+// Every entry remembers the block it was computed against, so it can only be served while that block
+// is still the tip (CACHE_CHAIN, CACHE_POOL) or still on the main chain (CACHE_HISTORY).
+class RpcResponseCache {
+public:
+  enum Scope {
+    CACHE_NONE,
+    CACHE_CHAIN,   // depends on the chain tip
+    CACHE_POOL,    // depends on the chain tip and the transaction pool
+    CACHE_HISTORY  // depends only on the blocks up to an anchor block
+  };
+
+  struct Entry {
+    Scope scope;
+    Crypto::Hash blockHash;
+    uint64_t poolVersion;
+    std::chrono::steady_clock::time_point expires;
+    std::string body;
+    Common::JsonValue result;
+  };
+
+  static const size_t DEFAULT_MAX_ENTRIES = 4096;
+
+  explicit RpcResponseCache(size_t maxEntries = DEFAULT_MAX_ENTRIES);
+
+  // Looks up a valid entry computed against blockHash. On a miss entry is prepared for store().
+  bool find(const std::string& key, Scope scope, const Crypto::Hash& blockHash, Entry& entry);
+  void store(const std::string& key, Entry&& entry);
+
+  void chainUpdated();
+  void poolUpdated();
+
+  uint64_t getHits() const;
+  uint64_t getMisses() const;
+
+private:
+  void erase(Scope scope);
+
+  const size_t m_maxEntries;
+  std::mutex m_mutex;
+  std::unordered_map<std::string, Entry> m_entries;
+  uint64_t m_poolVersion;
+  std::atomic<uint64_t> m_hits;
+  std::atomic<uint64_t> m_misses;
+};
+
+}
@@ -12,6 +12,11 @@
 #include <unordered_map>
 #include "math.h"
 
+#include <boost/scope_exit.hpp>
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+#include <System/Timer.h>
+
 // CryptoNote
 #include "BlockchainExplorerData.h"
 #include "Common/StringTools.h"
@@ -43,6 +48,8 @@ namespace CryptoNote {
 
 namespace {
 
+const uint32_t MAX_WAIT_FOR_CHANGES_TIMEOUT = 60000;
+
 template <typename Command>
 RpcServer::HandlerFunction binMethod(bool (RpcServer::*handler)(typename Command::request const&, typename Command::response&)) {
   return [handler](RpcServer* obj, const HttpRequest& request, HttpResponse& response) {
@@ -77,34 +84,49 @@ RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Comman
   };
 }
 
+// a well-formed batch call without an id is a notification: it runs but gets no reply entry
+bool isNotification(const Common::JsonNode& call) {
+  return call.isObject() && call.find("method") != nullptr && call.find("id") == nullptr;
+}
+
 }
 
 std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>> RpcServer::s_handlers = {
 
   // binary handlers
-  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false } },
-  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false } },
-  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false } },
-  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false } },
-  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false } },
-  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false } },
-  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false } },
+  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/get_pool_changes_since.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_SINCE>(&RpcServer::onGetPoolChangesSince), false, true, RpcResponseCache::CACHE_NONE } },
 
   // json handlers
-  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true } },
-  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true } },
-  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false } },
-  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false } },
-  { "/feeaddress", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_address), true } },
-  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
+  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true, false, RpcResponseCache::CACHE_POOL } },
+  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true, false, RpcResponseCache::CACHE_CHAIN } },
+  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false, true, RpcResponseCache::CACHE_NONE } },
+  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false, false, RpcResponseCache::CACHE_NONE } },
+  { "/feeaddress", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_address), true, false, RpcResponseCache::CACHE_NONE } },
+  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false, RpcResponseCache::CACHE_NONE } },
+  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false, RpcResponseCache::CACHE_NONE } },
+  { "/wait_for_changes", { jsonMethod<COMMAND_RPC_WAIT_FOR_CHANGES>(&RpcServer::on_wait_for_changes), true, false, RpcResponseCache::CACHE_NONE } },
 
   // json rpc
-  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true } }
+  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true, false, RpcResponseCache::CACHE_NONE } }
 };
 
 RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery) :
-  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery) {
+  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery), m_maxBatchSize(100), m_poolVersion(0), m_templateFeeThreshold(parameters::MINIMUM_FEE) {
+  m_templateCache.valid = false;
+  m_core.addObserver(this);
+}
+
+RpcServer::~RpcServer() {
+  m_core.removeObserver(this);
+  // run notifications already posted by other threads
+  m_dispatcher.yield();
 }
 
 void RpcServer::processRequest(const HttpRequest& request, HttpResponse& response) {
@@ -123,7 +145,29 @@ void RpcServer::processRequest(const HttpRequest& request, HttpResponse& respons
     return;
   }
 
-  it->second.handler(this, request, response);
+  RpcResponseCache::Scope cacheScope = it->second.cacheScope;
+  RpcResponseCache::Entry cacheEntry;
+  std::string cacheKey;
+  if (cacheScope != RpcResponseCache::CACHE_NONE) {
+    cacheKey = url + '\n' + request.getBody();
+    if (m_cache.find(cacheKey, cacheScope, getCacheBlockHash(cacheScope, 0), cacheEntry)) {
+      response.setBody(cacheEntry.body);
+      return;
+    }
+  }
+
+  bool result = false;
+  auto invoke = [&] { result = it->second.handler(this, request, response); };
+  if (it->second.threadSafe && m_workerPool) {
+    m_workerPool->execute(invoke);
+  } else {
+    invoke();
+  }
+
+  if (result && cacheScope != RpcResponseCache::CACHE_NONE) {
+    cacheEntry.body = response.getBody();
+    m_cache.store(cacheKey, std::move(cacheEntry));
+  }
 }
 
 bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse& response) {
@@ -131,28 +175,98 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
   using namespace JsonRpc;
 
   response.addHeader("Content-Type", "application/json");
+  logger(TRACE) << "JSON-RPC request: " << request.getBody();
+
+  Common::JsonDocument document;
+  try {
+    document.parse(request.getBody());
+  } catch (std::exception&) {
+    JsonRpcResponse jsonResponse;
+    jsonResponse.setError(JsonRpcError(errParseError));
+    response.setBody(jsonResponse.getBody());
+    return true;
+  }
+
+  const Common::JsonNode& root = document.getRoot();
+  if (!root.isArray()) {
+    JsonRpcResponse jsonResponse;
+    processJsonRpcCall(root, jsonResponse);
+    response.setBody(jsonResponse.getBody());
+    logger(TRACE) << "JSON-RPC response: " << response.getBody();
+    return true;
+  }
+
+  if (root.size() == 0 || root.size() > m_maxBatchSize) {
+    JsonRpcResponse jsonResponse;
+    jsonResponse.setError(JsonRpcError(errInvalidRequest, root.size() == 0 ? "Empty batch" : "Batch is too large"));
+    response.setBody(jsonResponse.getBody());
+    return true;
+  }
+
+  // calls of a batch are answered in request order; read-only ones overlap on the worker pool,
+  // the rest run one after another on the dispatcher thread
+  std::vector<JsonRpcResponse> jsonResponses(root.size());
+  if (m_workerPool) {
+    System::ContextGroup group(m_dispatcher);
+    for (uint64_t i = 0; i < root.size(); ++i) {
+      group.spawn([this, &root, &jsonResponses, i] { processJsonRpcCall(root[i], jsonResponses[i]); });
+    }
+
+    group.wait();
+  } else {
+    for (uint64_t i = 0; i < root.size(); ++i) {
+      processJsonRpcCall(root[i], jsonResponses[i]);
+    }
+  }
+
+  std::string body;
+  for (size_t i = 0; i < jsonResponses.size(); ++i) {
+    if (isNotification(root[i])) {
+      continue;
+    }
+
+    body += body.empty() ? '[' : ',';
+    body += jsonResponses[i].getBody();
+  }
+
+  if (body.empty()) {
+    response.setStatus(HttpResponse::STATUS_204);
+    logger(TRACE) << "JSON-RPC batch of notifications only, no response body";
+    return true;
+  }
+
+  body += ']';
+  response.setBody(body);
+  logger(TRACE) << "JSON-RPC response: " << body;
+  return true;
+}
+
+void RpcServer::processJsonRpcCall(const Common::JsonNode& call, JsonRpc::JsonRpcResponse& jsonResponse) {
+
+  using namespace JsonRpc;
 
   JsonRpcRequest jsonRequest;
-  JsonRpcResponse jsonResponse;
+  auto start = std::chrono::steady_clock::now();
+  std::string route = "json_rpc.unmatched";
+  bool failed = true;
 
   try {
-    logger(TRACE) << "JSON-RPC request: " << request.getBody();
-    jsonRequest.parseRequest(request.getBody());
+    jsonRequest.parseRequest(call);
     jsonResponse.setId(jsonRequest.getId()); // copy id
 
     static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod>> jsonRpcHandlers = {
-      { "f_blocks_list_json", { makeMemberMethod(&RpcServer::f_on_blocks_list_json), false } },
-      { "f_block_json", { makeMemberMethod(&RpcServer::f_on_block_json), false } },
-      { "f_transaction_json", { makeMemberMethod(&RpcServer::f_on_transaction_json), false } },
-      { "f_on_transactions_pool_json", { makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false } },
-      { "getblockcount", { makeMemberMethod(&RpcServer::on_getblockcount), true } },
-      { "on_getblockhash", { makeMemberMethod(&RpcServer::on_getblockhash), false } },
-      { "getblocktemplate", { makeMemberMethod(&RpcServer::on_getblocktemplate), false } },
-      { "getcurrencyid", { makeMemberMethod(&RpcServer::on_get_currency_id), true } },
-      { "submitblock", { makeMemberMethod(&RpcServer::on_submitblock), false } },
-      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false } },
-      { "getblockheaderbyhash", { makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false } },
-      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false } }
+      { "f_blocks_list_json", { makeMemberMethod(&RpcServer::f_on_blocks_list_json), false, true, RpcResponseCache::CACHE_HISTORY } },
+      { "f_block_json", { makeMemberMethod(&RpcServer::f_on_block_json), false, true, RpcResponseCache::CACHE_NONE } },
+      { "f_transaction_json", { makeMemberMethod(&RpcServer::f_on_transaction_json), false, true, RpcResponseCache::CACHE_NONE } },
+      { "f_on_transactions_pool_json", { makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false, true, RpcResponseCache::CACHE_POOL } },
+      { "getblockcount", { makeMemberMethod(&RpcServer::on_getblockcount), true, true, RpcResponseCache::CACHE_NONE } },
+      { "on_getblockhash", { makeMemberMethod(&RpcServer::on_getblockhash), false, true, RpcResponseCache::CACHE_NONE } },
+      { "getblocktemplate", { makeMemberMethod(&RpcServer::on_getblocktemplate), false, false, RpcResponseCache::CACHE_NONE } },
+      { "getcurrencyid", { makeMemberMethod(&RpcServer::on_get_currency_id), true, false, RpcResponseCache::CACHE_NONE } },
+      { "submitblock", { makeMemberMethod(&RpcServer::on_submitblock), false, false, RpcResponseCache::CACHE_NONE } },
+      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false, true, RpcResponseCache::CACHE_CHAIN } },
+      { "getblockheaderbyhash", { makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false, true, RpcResponseCache::CACHE_NONE } },
+      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, true, RpcResponseCache::CACHE_CHAIN } }
     };
 
     auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
@@ -160,21 +274,64 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       throw JsonRpcError(JsonRpc::errMethodNotFound);
     }
 
+    route = "json_rpc." + it->first;
+
     if (!it->second.allowBusyCore && !isCoreReady()) {
       throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
     }
 
-    it->second.handler(this, jsonRequest, jsonResponse);
+    RpcResponseCache::Scope cacheScope = it->second.cacheScope;
+    RpcResponseCache::Entry cacheEntry;
+    std::string cacheKey;
+    bool cached = false;
+    if (cacheScope != RpcResponseCache::CACHE_NONE) {
+      // the params value is re-serialized, so key order and whitespace of the request do not matter
+      Common::JsonValue params = jsonRequest.getParams();
+      uint32_t anchorHeight = 0;
+      if (cacheScope == RpcResponseCache::CACHE_HISTORY) {
+        // history responses are anchored at the highest block they cover
+        if (params.isObject() && params.contains("height") && params("height").isInteger()) {
+          anchorHeight = static_cast<uint32_t>(params("height").getInteger());
+        } else {
+          cacheScope = RpcResponseCache::CACHE_NONE;
+        }
+      }
+
+      Crypto::Hash blockHash = cacheScope != RpcResponseCache::CACHE_NONE ? getCacheBlockHash(cacheScope, anchorHeight) : NULL_HASH;
+      if (blockHash == NULL_HASH) {
+        cacheScope = RpcResponseCache::CACHE_NONE;
+      } else {
+        cacheKey = jsonRequest.getMethod() + '\n' + params.toString();
+        if (m_cache.find(cacheKey, cacheScope, blockHash, cacheEntry)) {
+          jsonResponse.setResultValue(cacheEntry.result);
+          cached = true;
+        }
+      }
+    }
+
+    if (!cached) {
+      bool result = false;
+      auto invoke = [&] { result = it->second.handler(this, jsonRequest, jsonResponse); };
+      if (it->second.threadSafe && m_workerPool) {
+        m_workerPool->execute(invoke);
+      } else {
+        invoke();
+      }
+
+      if (result && cacheScope != RpcResponseCache::CACHE_NONE && jsonResponse.getResultValue(cacheEntry.result)) {
+        m_cache.store(cacheKey, std::move(cacheEntry));
+      }
+    }
 
+    failed = false;
   } catch (const JsonRpcError& err) {
     jsonResponse.setError(err);
   } catch (const std::exception& e) {
     jsonResponse.setError(JsonRpcError(JsonRpc::errInternalError, e.what()));
   }
 
-  response.setBody(jsonResponse.getBody());
-  logger(TRACE) << "JSON-RPC response: " << jsonResponse.getBody();
-  return true;
+  // payload sizes are accounted to the /json_rpc route
+  m_metrics.record(route, std::chrono::steady_clock::now() - start, 0, 0, failed);
 }
 
 bool RpcServer::enableCors(const std::vector<std::string> domains) {
@@ -182,6 +339,25 @@ bool RpcServer::enableCors(const std::vector<std::string> domains) {
   return true;
 }
 
+bool RpcServer::setMaxBatchSize(size_t maxBatchSize) {
+  m_maxBatchSize = maxBatchSize;
+  return true;
+}
+
+bool RpcServer::setTemplateFeeThreshold(uint64_t threshold) {
+  m_templateFeeThreshold = threshold;
+  return true;
+}
+
+bool RpcServer::setWorkerThreads(size_t threadCount) {
+  m_workerPool.reset();
+  if (threadCount != 0) {
+    m_workerPool.reset(new System::WorkerPool(m_dispatcher, threadCount));
+  }
+
+  return true;
+}
+
 std::vector<std::string> RpcServer::getCorsDomains() {
   return m_cors_domains;
 }
@@ -190,6 +366,117 @@ bool RpcServer::isCoreReady() {
   return m_core.currency().isTestnet() || m_p2p.get_payload_object().isSynchronized();
 }
 
+void RpcServer::writeMetrics(std::string& out) {
+  HttpServer::writeMetrics(out);
+  out += "# HELP rpc_cache_hits_total Responses served from the response cache.\n# TYPE rpc_cache_hits_total counter\n";
+  out += "rpc_cache_hits_total " + std::to_string(m_cache.getHits()) + '\n';
+  out += "# HELP rpc_cache_misses_total Cacheable requests computed by a handler.\n# TYPE rpc_cache_misses_total counter\n";
+  out += "rpc_cache_misses_total " + std::to_string(m_cache.getMisses()) + '\n';
+  out += "# HELP txpool_transactions Transactions in the pool.\n# TYPE txpool_transactions gauge\n";
+  out += "txpool_transactions " + std::to_string(m_core.get_pool_transactions_count()) + '\n';
+  out += "# HELP txpool_bytes Total blob size of the transactions in the pool.\n# TYPE txpool_bytes gauge\n";
+  out += "txpool_bytes " + std::to_string(m_core.get_pool_size()) + '\n';
+  out += "# HELP txpool_evictions_total Transactions evicted from the full pool.\n# TYPE txpool_evictions_total counter\n";
+  out += "txpool_evictions_total " + std::to_string(m_core.get_pool_evicted_count()) + '\n';
+  out += "# HELP txpool_rejected_total Transactions refused for a fee per byte under the eviction floor.\n# TYPE txpool_rejected_total counter\n";
+  out += "txpool_rejected_total " + std::to_string(m_core.get_pool_rejected_count()) + '\n';
+#ifdef __linux__
+  out += "# HELP dispatcher_live_stacks Coroutine stacks in use.\n# TYPE dispatcher_live_stacks gauge\n";
+  out += "dispatcher_live_stacks " + std::to_string(m_dispatcher.getLiveStackCount()) + '\n';
+  out += "# HELP dispatcher_pooled_stacks Idle coroutine stacks kept for reuse.\n# TYPE dispatcher_pooled_stacks gauge\n";
+  out += "dispatcher_pooled_stacks " + std::to_string(m_dispatcher.getPooledStackCount()) + '\n';
+#endif
+}
+
+uint64_t RpcServer::getCacheHits() const {
+  return m_cache.getHits();
+}
+
+uint64_t RpcServer::getCacheMisses() const {
+  return m_cache.getMisses();
+}
+
+Crypto::Hash RpcServer::getCacheBlockHash(RpcResponseCache::Scope scope, uint32_t anchorHeight) {
+  if (scope == RpcResponseCache::CACHE_HISTORY) {
+    return m_core.getBlockIdByHeight(anchorHeight);
+  }
+
+  uint32_t height;
+  Crypto::Hash tailId;
+  m_core.get_blockchain_top(height, tailId);
+  return tailId;
+}
+
+void RpcServer::waitForChanges(std::chrono::milliseconds timeout) {
+  System::Event changed(m_dispatcher);
+  System::ContextGroup timeoutGroup(m_dispatcher);
+  timeoutGroup.spawn([this, &changed, timeout] {
+    try {
+      System::Timer(m_dispatcher).sleep(timeout);
+      changed.set();
+    } catch (System::InterruptedException&) {
+    }
+  });
+
+  m_changeWaiters.insert(&changed);
+  BOOST_SCOPE_EXIT_ALL(this, &changed) {
+    m_changeWaiters.erase(&changed);
+  };
+
+  changed.wait();
+}
+
+void RpcServer::notifyChanges() {
+  // core observers may be called from the miner thread
+  m_dispatcher.remoteSpawn([this] {
+    for (System::Event* waiter : m_changeWaiters) {
+      waiter->set();
+    }
+  });
+}
+
+void RpcServer::waitForTemplateChange(const std::string& longPollId) {
+  // longpollid is the hex tail block id followed by the pool fee total the template was built with
+  Hash knownTail;
+  uint64_t knownFee;
+  size_t separator = longPollId.find(':');
+  try {
+    if (separator == std::string::npos || !podFromHex(longPollId.substr(0, separator), knownTail)) {
+      throw std::invalid_argument("longpollid");
+    }
+    knownFee = std::stoull(longPollId.substr(separator + 1));
+  } catch (std::exception&) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_PARAM, "Failed to parse longpollid" };
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(MAX_WAIT_FOR_CHANGES_TIMEOUT);
+  for (;;) {
+    uint32_t height;
+    Hash tail;
+    m_core.get_blockchain_top(height, tail);
+    uint64_t fee = m_core.get_pool_fee();
+    uint64_t feeChange = fee > knownFee ? fee - knownFee : knownFee - fee;
+
+    auto now = std::chrono::steady_clock::now();
+    if (tail != knownTail || (feeChange != 0 && feeChange >= m_templateFeeThreshold) || now >= deadline) {
+      break;
+    }
+
+    waitForChanges(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+  }
+}
+
+void RpcServer::blockchainUpdated() {
+  m_cache.chainUpdated();
+  notifyChanges();
+}
+
+void RpcServer::poolUpdated() {
+  m_cache.poolUpdated();
+  ++m_poolVersion;
+  notifyChanges();
+}
+
 //
 // Binary handlers
 //
@@ -213,17 +500,13 @@ bool RpcServer::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, C
   res.current_height = totalBlockCount;
   res.start_height = startBlockIndex;
 
+  res.blocks.reserve(supplement.size());
   for (const auto& blockId : supplement) {
-    assert(m_core.have_block(blockId));
-    auto completeBlock = m_core.getBlock(blockId);
-    assert(completeBlock != nullptr);
-
     res.blocks.resize(res.blocks.size() + 1);
-    res.blocks.back().block = asString(toBinaryArray(completeBlock->getBlock()));
-
-    res.blocks.back().txs.reserve(completeBlock->getTransactionCount());
-    for (uint64_t i = 0; i < completeBlock->getTransactionCount(); ++i) {
-      res.blocks.back().txs.push_back(asString(toBinaryArray(completeBlock->getTransaction(i))));
+    if (!m_core.getRawBlock(blockId, res.blocks.back())) {
+      // the chain switched since the supplement was built
+      res.blocks.pop_back();
+      break;
     }
   }
 
@@ -354,11 +637,22 @@ bool RpcServer::onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& re
 
 bool RpcServer::onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::request& req, COMMAND_RPC_GET_POOL_CHANGES_LITE::response& rsp) {
   rsp.status = CORE_RPC_STATUS_OK;
+  // taken first: changes racing with the difference are reported again by the next delta, never lost
+  m_core.getPoolFeedPosition(rsp.poolFeedId, rsp.poolSequence);
   rsp.isTailBlockActual = m_core.getPoolChangesLite(req.tailBlockId, req.knownTxsIds, rsp.addedTxs, rsp.deletedTxsIds);
 
   return true;
 }
 
+bool RpcServer::onGetPoolChangesSince(const COMMAND_RPC_GET_POOL_CHANGES_SINCE::request& req, COMMAND_RPC_GET_POOL_CHANGES_SINCE::response& rsp) {
+  rsp.status = CORE_RPC_STATUS_OK;
+  rsp.poolFeedId = req.poolFeedId;
+  rsp.poolSequence = req.poolSequence;
+  rsp.isTailBlockActual = m_core.getPoolChangesSince(req.tailBlockId, rsp.poolFeedId, rsp.poolSequence, rsp.isSequenceActual, rsp.addedTxs, rsp.deletedTxsIds);
+
+  return true;
+}
+
 //
 // JSON handlers
 //
@@ -436,6 +730,35 @@ bool RpcServer::on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAN
   return true;
 }
 
+bool RpcServer::on_wait_for_changes(const COMMAND_RPC_WAIT_FOR_CHANGES::request& req, COMMAND_RPC_WAIT_FOR_CHANGES::response& res) {
+  Hash knownTail = NULL_HASH;
+  if (!req.tail_block_id.empty() && !parse_hash256(req.tail_block_id, knownTail)) {
+    res.status = "Failed to parse hex representation of block hash";
+    return true;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::min(req.timeout, MAX_WAIT_FOR_CHANGES_TIMEOUT));
+  for (;;) {
+    uint32_t height;
+    Hash tail;
+    m_core.get_blockchain_top(height, tail);
+    uint64_t poolVersion = m_poolVersion.load();
+
+    auto now = std::chrono::steady_clock::now();
+    if (tail != knownTail || poolVersion != req.pool_version || now >= deadline) {
+      res.tail_block_id = Common::podToHex(tail);
+      res.height = height;
+      res.pool_version = poolVersion;
+      break;
+    }
+
+    waitForChanges(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
 bool RpcServer::on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request& req, COMMAND_RPC_GET_TRANSACTIONS::response& res) {
   std::vector<Hash> vh;
   for (const auto& tx_hex_str : req.txs_hashes) {
@@ -884,14 +1207,39 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_WALLET_ADDRESS, "Failed to parse wallet address" };
   }
 
+  if (!req.longpollid.empty()) {
+    waitForTemplateChange(req.longpollid);
+  }
+
+  // read before building, so a change that lands meanwhile only makes the cached entry look older
+  uint32_t tailHeight;
+  Hash tailId;
+  m_core.get_blockchain_top(tailHeight, tailId);
+  uint64_t poolVersion = m_poolVersion.load();
+  uint64_t poolFee = m_core.get_pool_fee();
+  if (!m_templateCache.valid || m_templateCache.tailId != tailId || m_templateCache.poolVersion != poolVersion) {
+    if (!m_core.prepareBlockTemplate(m_templateCache.base)) {
+      m_templateCache.valid = false;
+      logger(ERROR) << "Failed to create block template";
+      throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR, "Internal error: failed to create block template" };
+    }
+
+    m_templateCache.valid = true;
+    m_templateCache.tailId = tailId;
+    m_templateCache.poolVersion = poolVersion;
+  }
+
   Block b = boost::value_initialized<Block>();
   CryptoNote::BinaryArray blob_reserve;
   blob_reserve.resize(req.reserve_size, 0);
-  if (!m_core.get_block_template(b, acc, res.difficulty, res.height, blob_reserve)) {
+  if (!m_core.completeBlockTemplate(m_templateCache.base, acc, blob_reserve, b)) {
     logger(ERROR) << "Failed to create block template";
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR, "Internal error: failed to create block template" };
   }
 
+  res.difficulty = m_templateCache.base.difficulty;
+  res.height = m_templateCache.base.height;
+
   BinaryArray block_blob = toBinaryArray(b);
   PublicKey tx_pub_key = CryptoNote::getTransactionPublicKeyFromExtra(b.baseTransaction.extra);
   if (tx_pub_key == NULL_PUBLIC_KEY) {
@@ -915,8 +1263,8 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
   }
 
   res.blocktemplate_blob = toHex(block_blob);
+  res.longpollid = podToHex(tailId) + ":" + std::to_string(poolFee);
   res.status = CORE_RPC_STATUS_OK;
-
   return true;
 }
 
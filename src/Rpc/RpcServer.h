@@ -10,28 +10,53 @@
 
 #include "HttpServer.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <Logging/LoggerRef.h>
+#include <System/WorkerPool.h>
 #include "Common/Math.h"
 #include "CoreRpcServerCommandsDefinitions.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/ICoreObserver.h"
+#include "RpcResponseCache.h"
+
+namespace System {
+class Event;
+}
+
+namespace Common {
+class JsonNode;
+}
 
 namespace CryptoNote {
 
-class core;
 class NodeServer;
 class ICryptoNoteProtocolQuery;
 
-class RpcServer : public HttpServer {
+namespace JsonRpc {
+class JsonRpcResponse;
+}
+
+class RpcServer : public HttpServer, private ICoreObserver {
 public:
   RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery);
+  ~RpcServer();
   
   typedef std::function<bool(RpcServer*, const HttpRequest& request, HttpResponse& response)> HandlerFunction;
   bool setFeeAddress(const std::string& fee_address, const AccountPublicAddress& fee_acc);
   bool setViewKey(const std::string& view_key);
   bool restrictRPC(const bool is_resctricted);
   bool enableCors(const std::vector<std::string> domains);
+  bool setWorkerThreads(size_t threadCount);
+  bool setMaxBatchSize(size_t maxBatchSize);
+  bool setTemplateFeeThreshold(uint64_t threshold);
+  uint64_t getCacheHits() const;
+  uint64_t getCacheMisses() const;
   std::vector<std::string> getCorsDomains();
   bool remotenode_check_incoming_tx(const BinaryArray& tx_blob);
   bool on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res);
@@ -42,14 +67,36 @@ private:
   struct RpcHandler {
     const Handler handler;
     const bool allowBusyCore;
+    // handler only reads core state and may run on a worker thread
+    const bool threadSafe;
+    const RpcResponseCache::Scope cacheScope;
+  };
+
+  // transactions of the last block template built, shared by the getblocktemplate clients woken by the same change;
+  // every call still gets its own coinbase and timestamp
+  struct BlockTemplateCache {
+    bool valid;
+    Crypto::Hash tailId;
+    uint64_t poolVersion;
+    BlockTemplateBase base;
   };
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
   static std::unordered_map<std::string, RpcHandler<HandlerFunction>> s_handlers;
 
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) override;
+  virtual void writeMetrics(std::string& out) override;
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
+  void processJsonRpcCall(const Common::JsonNode& call, JsonRpc::JsonRpcResponse& jsonResponse);
   bool isCoreReady();
+  Crypto::Hash getCacheBlockHash(RpcResponseCache::Scope scope, uint32_t anchorHeight);
+  void waitForChanges(std::chrono::milliseconds timeout);
+  void notifyChanges();
+  void waitForTemplateChange(const std::string& longPollId);
+
+  // ICoreObserver
+  virtual void blockchainUpdated() override;
+  virtual void poolUpdated() override;
 
   // binary handlers
   bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
@@ -59,6 +106,7 @@ private:
   bool on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
   bool onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& rsp);
   bool onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::request& req, COMMAND_RPC_GET_POOL_CHANGES_LITE::response& rsp);
+  bool onGetPoolChangesSince(const COMMAND_RPC_GET_POOL_CHANGES_SINCE::request& req, COMMAND_RPC_GET_POOL_CHANGES_SINCE::response& rsp);
 
   // json handlers
   bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res);
@@ -69,6 +117,7 @@ private:
   bool on_stop_mining(const COMMAND_RPC_STOP_MINING::request& req, COMMAND_RPC_STOP_MINING::response& res);
   bool on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res);
   bool on_get_fee_address(const COMMAND_RPC_GET_FEE_ADDRESS::request& req, COMMAND_RPC_GET_FEE_ADDRESS::response& res);
+  bool on_wait_for_changes(const COMMAND_RPC_WAIT_FOR_CHANGES::request& req, COMMAND_RPC_WAIT_FOR_CHANGES::response& res);
 
   // json rpc
   bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res);
@@ -97,6 +146,14 @@ private:
   std::string m_fee_address;
   Crypto::SecretKey m_view_key = NULL_SECRET_KEY;
   AccountPublicAddress m_fee_acc; 
+  std::unique_ptr<System::WorkerPool> m_workerPool;
+  size_t m_maxBatchSize;
+  RpcResponseCache m_cache;
+  std::atomic<uint64_t> m_poolVersion;
+  // events of pending /wait_for_changes requests, touched on the dispatcher thread only
+  std::unordered_set<System::Event*> m_changeWaiters;
+  uint64_t m_templateFeeThreshold;
+  BlockTemplateCache m_templateCache;
 };
 
 }
@@ -14,13 +14,22 @@ namespace CryptoNote {
 
     const std::string DEFAULT_RPC_IP = "127.0.0.1";
     const uint16_t DEFAULT_RPC_PORT = RPC_DEFAULT_PORT;
+    const uint32_t DEFAULT_RPC_WORKER_THREADS = 2;
+    const uint32_t DEFAULT_RPC_MAX_BATCH_SIZE = 100;
+    const uint64_t DEFAULT_RPC_TEMPLATE_FEE_THRESHOLD = parameters::MINIMUM_FEE;
 
     const command_line::arg_descriptor<std::string> arg_rpc_bind_ip = { "rpc-bind-ip", "", DEFAULT_RPC_IP };
     const command_line::arg_descriptor<uint16_t> arg_rpc_bind_port = { "rpc-bind-port", "", DEFAULT_RPC_PORT };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_worker_threads = { "rpc-worker-threads", "Number of threads serving read-only RPC requests, 0 to serve them on the network thread", DEFAULT_RPC_WORKER_THREADS };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_max_batch_size = { "rpc-max-batch-size", "Maximum number of calls in a JSON-RPC batch request", DEFAULT_RPC_MAX_BATCH_SIZE };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_template_fee_threshold = { "rpc-template-fee-threshold", "Change of the pool fee total, in atomic units, that wakes long-polling getblocktemplate requests", DEFAULT_RPC_TEMPLATE_FEE_THRESHOLD };
+    const command_line::arg_descriptor<uint16_t> arg_work_server_port = { "work-server-port", "Port of the stratum-style work server on --rpc-bind-ip, 0 to disable it", 0 };
+    const command_line::arg_descriptor<std::string> arg_work_server_address = { "work-server-address", "Address receiving the rewards of the blocks found through the work server", "" };
+    const command_line::arg_descriptor<uint64_t> arg_work_server_share_difficulty = { "work-server-share-difficulty", "Difficulty of the shares accepted by the work server, 0 for the block difficulty", 0 };
   }
 
 
-  RpcServerConfig::RpcServerConfig() : bindIp(DEFAULT_RPC_IP), bindPort(DEFAULT_RPC_PORT) {
+  RpcServerConfig::RpcServerConfig() : bindIp(DEFAULT_RPC_IP), bindPort(DEFAULT_RPC_PORT), workerThreads(DEFAULT_RPC_WORKER_THREADS), maxBatchSize(DEFAULT_RPC_MAX_BATCH_SIZE), templateFeeThreshold(DEFAULT_RPC_TEMPLATE_FEE_THRESHOLD), workServerPort(0), workServerShareDifficulty(0) {
   }
 
   std::string RpcServerConfig::getBindAddress() const {
@@ -30,11 +39,23 @@ namespace CryptoNote {
   void RpcServerConfig::initOptions(boost::program_options::options_description& desc) {
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
+    command_line::add_arg(desc, arg_rpc_worker_threads);
+    command_line::add_arg(desc, arg_rpc_max_batch_size);
+    command_line::add_arg(desc, arg_rpc_template_fee_threshold);
+    command_line::add_arg(desc, arg_work_server_port);
+    command_line::add_arg(desc, arg_work_server_address);
+    command_line::add_arg(desc, arg_work_server_share_difficulty);
   }
 
   void RpcServerConfig::init(const boost::program_options::variables_map& vm)  {
     bindIp = command_line::get_arg(vm, arg_rpc_bind_ip);
     bindPort = command_line::get_arg(vm, arg_rpc_bind_port);
+    workerThreads = command_line::get_arg(vm, arg_rpc_worker_threads);
+    maxBatchSize = command_line::get_arg(vm, arg_rpc_max_batch_size);
+    templateFeeThreshold = command_line::get_arg(vm, arg_rpc_template_fee_threshold);
+    workServerPort = command_line::get_arg(vm, arg_work_server_port);
+    workServerAddress = command_line::get_arg(vm, arg_work_server_address);
+    workServerShareDifficulty = command_line::get_arg(vm, arg_work_server_share_difficulty);
   }
 
 }
@@ -22,6 +22,12 @@ public:
 
   std::string bindIp;
   uint16_t bindPort;
+  uint32_t workerThreads;
+  uint32_t maxBatchSize;
+  uint64_t templateFeeThreshold;
+  uint16_t workServerPort;
+  std::string workServerAddress;
+  uint64_t workServerShareDifficulty;
 };
 
 }
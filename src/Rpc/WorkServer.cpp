@@ -0,0 +1,468 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "WorkServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include <boost/scope_exit.hpp>
+#include <boost/utility/value_init.hpp>
+
+#include <System/EventLock.h>
+#include <System/InterruptedException.h>
+#include <System/Ipv4Address.h>
+#include <System/Timer.h>
+
+#include "Common/StringTools.h"
+#include "crypto/hash.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "JsonRpc.h"
+#include "Serialization/SerializationTools.h"
+
+using namespace Logging;
+using namespace Common;
+
+namespace CryptoNote {
+
+namespace {
+
+const size_t HASH_THREADS = 2;
+const size_t MAX_MESSAGE_SIZE = 16 * 1024;
+const size_t MAX_SESSION_JOBS = 4;
+// shares are hashed on HASH_THREADS threads shared by all sessions, so one session may not take them all
+const uint32_t MAX_SESSION_SHARES_PER_SECOND = 10;
+// sessions are closed once this many shares in a row were rejected
+const uint32_t MAX_SESSION_INVALID_SHARES = 10;
+// the template is rebuilt this often even without a new block, to pick up pool transactions
+const std::chrono::seconds TEMPLATE_REFRESH_INTERVAL(30);
+
+const int errUnknownJob = -1;
+const int errDuplicateShare = -2;
+const int errLowDifficultyShare = -3;
+const int errUnauthenticated = -4;
+const int errTooManyShares = -5;
+
+void writeAll(System::TcpConnection& connection, const std::string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    offset += connection.write(reinterpret_cast<const uint8_t*>(data.data()) + offset, data.size() - offset);
+  }
+}
+
+}
+
+WorkServer::Session::Session(System::Dispatcher& dispatcher, System::TcpConnection& connection, uint32_t id) :
+  id(id), loggedIn(false), connection(connection), writeLock(dispatcher), windowShares(0), invalidShares(0), writers(dispatcher) {
+  writeLock.set();
+}
+
+WorkServer::WorkServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c) :
+  m_dispatcher(dispatcher), logger(log, "WorkServer"), m_core(c), m_workingContextGroup(dispatcher),
+  m_templateChanged(dispatcher), m_shareDifficulty(0), m_nextSessionId(Crypto::rand<uint32_t>()) {
+  m_template.valid = false;
+  m_template.version = 0;
+  m_core.addObserver(this);
+}
+
+WorkServer::~WorkServer() {
+  m_core.removeObserver(this);
+}
+
+bool WorkServer::setMinerAddress(const std::string& address) {
+  return m_core.currency().parseAccountAddressString(address, m_minerAddress);
+}
+
+void WorkServer::setShareDifficulty(difficulty_type difficulty) {
+  m_shareDifficulty = difficulty;
+}
+
+void WorkServer::start(const std::string& address, uint16_t port) {
+  m_hashPool.reset(new System::WorkerPool(m_dispatcher, HASH_THREADS));
+  m_listener = System::TcpListener(m_dispatcher, System::Ipv4Address(address), port);
+  m_workingContextGroup.spawn(std::bind(&WorkServer::acceptLoop, this));
+  m_workingContextGroup.spawn(std::bind(&WorkServer::jobLoop, this));
+}
+
+void WorkServer::stop() {
+  m_workingContextGroup.interrupt();
+  m_workingContextGroup.wait();
+  m_hashPool.reset();
+}
+
+void WorkServer::blockchainUpdated() {
+  // core observers may be called from the miner thread
+  m_dispatcher.remoteSpawn([this] {
+    m_templateChanged.set();
+  });
+}
+
+void WorkServer::acceptLoop() {
+  try {
+    System::TcpConnection connection;
+    bool accepted = false;
+
+    while (!accepted) {
+      try {
+        connection = m_listener.accept();
+        accepted = true;
+      } catch (System::InterruptedException&) {
+        throw;
+      } catch (std::exception&) {
+        // try again
+      }
+    }
+
+    m_workingContextGroup.spawn(std::bind(&WorkServer::acceptLoop, this));
+
+    Session session(m_dispatcher, connection, m_nextSessionId++);
+    m_sessions.emplace(session.id, &session);
+    BOOST_SCOPE_EXIT_ALL(this, &session) {
+      m_sessions.erase(session.id);
+      session.writers.interrupt();
+      session.writers.wait();
+    };
+
+    logger(DEBUGGING) << "Work server client connected, session " << session.id;
+
+    std::string buffer;
+    uint8_t chunk[4096];
+    for (;;) {
+      size_t size = static_cast<size_t>(connection.read(chunk, sizeof(chunk)));
+      if (size == 0) {
+        break;
+      }
+
+      buffer.append(reinterpret_cast<const char*>(chunk), size);
+
+      size_t lineEnd;
+      while (session.invalidShares < MAX_SESSION_INVALID_SHARES && (lineEnd = buffer.find('\n')) != std::string::npos) {
+        std::string line = buffer.substr(0, lineEnd);
+        buffer.erase(0, lineEnd + 1);
+        if (!line.empty() && line != "\r") {
+          processMessage(session, line);
+        }
+      }
+
+      if (session.invalidShares >= MAX_SESSION_INVALID_SHARES) {
+        logger(INFO) << "Work server session " << session.id << " sent " << session.invalidShares << " invalid shares in a row, closing";
+        break;
+      }
+
+      if (buffer.size() > MAX_MESSAGE_SIZE) {
+        logger(DEBUGGING) << "Work server session " << session.id << " sent an oversized message, closing";
+        break;
+      }
+    }
+
+    logger(DEBUGGING) << "Work server client disconnected, session " << session.id;
+  } catch (System::InterruptedException&) {
+  } catch (std::exception& e) {
+    logger(DEBUGGING) << "Work server connection error: " << e.what();
+  }
+}
+
+void WorkServer::jobLoop() {
+  try {
+    for (;;) {
+      {
+        System::ContextGroup timeoutGroup(m_dispatcher);
+        timeoutGroup.spawn([this] {
+          try {
+            System::Timer(m_dispatcher).sleep(TEMPLATE_REFRESH_INTERVAL);
+            m_templateChanged.set();
+          } catch (System::InterruptedException&) {
+          }
+        });
+
+        m_templateChanged.wait();
+        m_templateChanged.clear();
+      }
+
+      if (!updateTemplate()) {
+        continue;
+      }
+
+      for (auto& entry : m_sessions) {
+        Session* session = entry.second;
+        if (session->loggedIn) {
+          session->writers.spawn([this, session] { sendJob(*session); });
+        }
+      }
+    }
+  } catch (System::InterruptedException&) {
+  }
+}
+
+bool WorkServer::updateTemplate() {
+  Block block = boost::value_initialized<Block>();
+  difficulty_type difficulty;
+  uint32_t height;
+  BinaryArray extraNonce(sizeof(uint32_t), 0);
+  if (!m_core.get_block_template(block, m_minerAddress, difficulty, height, extraNonce)) {
+    logger(ERROR) << "Failed to create block template";
+    return false;
+  }
+
+  // the coinbase extra starts with the transaction public key followed by the extra nonce
+  const BinaryArray& extra = block.baseTransaction.extra;
+  const size_t extraNonceOffset = 1 + sizeof(Crypto::PublicKey) + 2;
+  if (extra.size() < extraNonceOffset + extraNonce.size() || extra[0] != TX_EXTRA_TAG_PUBKEY ||
+      extra[extraNonceOffset - 2] != TX_EXTRA_NONCE || extra[extraNonceOffset - 1] != extraNonce.size()) {
+    logger(ERROR) << "Failed to find the extra nonce in the block template coinbase";
+    return false;
+  }
+
+  m_template.valid = true;
+  m_template.block = std::move(block);
+  m_template.difficulty = difficulty;
+  m_template.height = height;
+  m_template.extraNonceOffset = extraNonceOffset;
+  ++m_template.version;
+  return true;
+}
+
+const WorkServer::Job* WorkServer::getJob(Session& session) {
+  if (!m_template.valid && !updateTemplate()) {
+    return nullptr;
+  }
+
+  if (!session.jobs.empty() && session.jobs.back().templateVersion == m_template.version) {
+    return &session.jobs.back();
+  }
+
+  Job job;
+  job.id = std::to_string(m_template.version);
+  job.templateVersion = m_template.version;
+  job.block = m_template.block;
+  job.blockDifficulty = m_template.difficulty;
+  job.shareDifficulty = m_shareDifficulty != 0 ? std::min(m_shareDifficulty, m_template.difficulty) : m_template.difficulty;
+  job.height = m_template.height;
+
+  // the session id is the extra nonce, which changes the coinbase and with it the whole hashing blob
+  std::memcpy(job.block.baseTransaction.extra.data() + m_template.extraNonceOffset, &session.id, sizeof(session.id));
+
+  BinaryArray header;
+  if (!toBinaryArray(static_cast<const BlockHeader&>(job.block), header) || !get_block_hashing_blob(job.block, job.hashingBlob)) {
+    logger(ERROR) << "Failed to build the hashing blob of a job";
+    return nullptr;
+  }
+  job.nonceOffset = header.size() - sizeof(job.block.nonce);
+
+  // jobs on an older tip can no longer become blocks
+  while (!session.jobs.empty() && (session.jobs.size() >= MAX_SESSION_JOBS || session.jobs.front().block.previousBlockHash != job.block.previousBlockHash)) {
+    session.jobs.pop_front();
+  }
+
+  session.jobs.push_back(std::move(job));
+  return &session.jobs.back();
+}
+
+WORK_JOB WorkServer::makeJobMessage(const Job& job) const {
+  WORK_JOB message;
+  message.job_id = job.id;
+  message.blob = toHex(job.hashingBlob);
+  message.target = podToHex(std::numeric_limits<uint64_t>::max() / job.shareDifficulty);
+  message.difficulty = job.shareDifficulty;
+  message.height = job.height;
+  return message;
+}
+
+void WorkServer::sendJob(Session& session) {
+  const Job* job = getJob(session);
+  if (job == nullptr) {
+    return;
+  }
+
+  JsonValue message(JsonValue::OBJECT);
+  message.insert("jsonrpc", std::string("2.0"));
+  message.insert("method", std::string(WORK_METHOD_JOB));
+  message.insert("params", storeToJsonValue(makeJobMessage(*job)));
+
+  try {
+    writeMessage(session, message);
+  } catch (System::InterruptedException&) {
+  } catch (std::exception& e) {
+    logger(DEBUGGING) << "Failed to send a job to work server session " << session.id << ": " << e.what();
+  }
+}
+
+void WorkServer::processMessage(Session& session, const std::string& line) {
+  JsonValue response(JsonValue::OBJECT);
+  response.insert("jsonrpc", std::string("2.0"));
+
+  try {
+    JsonValue request;
+    try {
+      request = JsonValue::fromString(line);
+    } catch (std::exception&) {
+      throw JsonRpc::JsonRpcError(JsonRpc::errParseError);
+    }
+
+    if (!request.isObject() || !request.contains("method") || !request("method").isString()) {
+      throw JsonRpc::JsonRpcError(JsonRpc::errInvalidRequest);
+    }
+
+    if (request.contains("id")) {
+      response.insert("id", request("id"));
+    }
+
+    const std::string& method = request("method").getString();
+    JsonValue params = request.contains("params") ? request("params") : JsonValue(JsonValue::OBJECT);
+    if (method == WORK_METHOD_LOGIN) {
+      COMMAND_WORK_LOGIN::request req;
+      COMMAND_WORK_LOGIN::response res;
+      loadFromJsonValue(req, params);
+      onLogin(session, req, res);
+      response.insert("result", storeToJsonValue(res));
+    } else if (method == WORK_METHOD_GETJOB) {
+      if (!session.loggedIn) {
+        throw JsonRpc::JsonRpcError(errUnauthenticated, "Unauthenticated");
+      }
+
+      const Job* job = getJob(session);
+      if (job == nullptr) {
+        throw JsonRpc::JsonRpcError(JsonRpc::errInternalError, "Failed to create block template");
+      }
+
+      response.insert("result", storeToJsonValue(makeJobMessage(*job)));
+    } else if (method == WORK_METHOD_SUBMIT) {
+      COMMAND_WORK_SUBMIT::request req;
+      COMMAND_WORK_SUBMIT::response res;
+      loadFromJsonValue(req, params);
+      onSubmit(session, req, res);
+      response.insert("result", storeToJsonValue(res));
+    } else if (method == WORK_METHOD_KEEPALIVED) {
+      JsonValue result(JsonValue::OBJECT);
+      result.insert("status", std::string("KEEPALIVED"));
+      response.insert("result", result);
+    } else {
+      throw JsonRpc::JsonRpcError(JsonRpc::errMethodNotFound);
+    }
+
+    response.insert("error", JsonValue(JsonValue::NIL));
+  } catch (JsonRpc::JsonRpcError& e) {
+    JsonValue error(JsonValue::OBJECT);
+    error.insert("code", static_cast<JsonValue::Integer>(e.code));
+    error.insert("message", e.message);
+    response.set("error", error);
+  }
+
+  if (!response.contains("id")) {
+    response.insert("id", JsonValue(JsonValue::NIL));
+  }
+
+  writeMessage(session, response);
+}
+
+void WorkServer::onLogin(Session& session, const COMMAND_WORK_LOGIN::request& req, COMMAND_WORK_LOGIN::response& res) {
+  const Job* job = getJob(session);
+  if (job == nullptr) {
+    throw JsonRpc::JsonRpcError(JsonRpc::errInternalError, "Failed to create block template");
+  }
+
+  session.loggedIn = true;
+  logger(INFO) << "Work server session " << session.id << " logged in as " << req.login << " (" << req.agent << ")";
+
+  res.id = std::to_string(session.id);
+  res.job = makeJobMessage(*job);
+  res.status = "OK";
+}
+
+void WorkServer::onSubmit(Session& session, const COMMAND_WORK_SUBMIT::request& req, COMMAND_WORK_SUBMIT::response& res) {
+  if (!session.loggedIn) {
+    throw JsonRpc::JsonRpcError(errUnauthenticated, "Unauthenticated");
+  }
+
+  uint32_t nonce;
+  if (!podFromHex(req.nonce, nonce)) {
+    throw JsonRpc::JsonRpcError(JsonRpc::errInvalidParams, "Failed to parse nonce");
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - session.shareWindowStart >= std::chrono::seconds(1)) {
+    session.shareWindowStart = now;
+    session.windowShares = 0;
+  }
+
+  if (++session.windowShares > MAX_SESSION_SHARES_PER_SECOND) {
+    throw JsonRpc::JsonRpcError(errTooManyShares, "Too many shares, raise the share difficulty");
+  }
+
+  // stale jobs are expected right after a new block, so they don't count as invalid
+  auto jobIt = std::find_if(session.jobs.begin(), session.jobs.end(), [&req](const Job& job) { return job.id == req.job_id; });
+  if (jobIt == session.jobs.end()) {
+    throw JsonRpc::JsonRpcError(errUnknownJob, "Unknown or stale job");
+  }
+
+  if (!jobIt->nonces.insert(nonce).second) {
+    ++session.invalidShares;
+    throw JsonRpc::JsonRpcError(errDuplicateShare, "Duplicate share");
+  }
+
+  // a new job may drop this one while the share is hashed, so work on copies
+  BinaryArray blob = jobIt->hashingBlob;
+  std::memcpy(blob.data() + jobIt->nonceOffset, &nonce, sizeof(nonce));
+  Block block = jobIt->block;
+  difficulty_type blockDifficulty = jobIt->blockDifficulty;
+  difficulty_type shareDifficulty = jobIt->shareDifficulty;
+
+  Crypto::Hash hash;
+  bool hashed = false;
+  m_hashPool->execute([&] {
+    std::unique_ptr<Crypto::cn_context> context = acquireContext();
+    hashed = get_block_longhash(*context, block.majorVersion, blob, hash);
+    releaseContext(std::move(context));
+  });
+
+  if (!hashed || !check_hash(hash, shareDifficulty)) {
+    ++session.invalidShares;
+    throw JsonRpc::JsonRpcError(errLowDifficultyShare, "Low difficulty share");
+  }
+
+  session.invalidShares = 0;
+
+  if (check_hash(hash, blockDifficulty)) {
+    block.nonce = nonce;
+    if (m_core.handle_block_found(block)) {
+      logger(INFO, BRIGHT_GREEN) << "Work server session " << session.id << " found block " << get_block_hash(block) << " at height " << get_block_height(block);
+    } else {
+      logger(WARNING) << "Block found by work server session " << session.id << " was not accepted";
+    }
+  }
+
+  res.status = "OK";
+}
+
+void WorkServer::writeMessage(Session& session, const JsonValue& message) {
+  // job notifications and responses are written from different contexts
+  System::EventLock lock(session.writeLock);
+  writeAll(session.connection, message.toString() + "\n");
+}
+
+std::unique_ptr<Crypto::cn_context> WorkServer::acquireContext() {
+  {
+    std::lock_guard<std::mutex> lock(m_contextsLock);
+    if (!m_contexts.empty()) {
+      std::unique_ptr<Crypto::cn_context> context = std::move(m_contexts.back());
+      m_contexts.pop_back();
+      return context;
+    }
+  }
+
+  return std::unique_ptr<Crypto::cn_context>(new Crypto::cn_context());
+}
+
+void WorkServer::releaseContext(std::unique_ptr<Crypto::cn_context>&& context) {
+  std::lock_guard<std::mutex> lock(m_contextsLock);
+  m_contexts.push_back(std::move(context));
+}
+
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <System/ContextGroup.h>
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+#include <System/TcpConnection.h>
+#include <System/TcpListener.h>
+#include <System/WorkerPool.h>
+
+#include <Logging/LoggerRef.h>
+
+#include "Common/JsonValue.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+#include "CryptoNoteCore/Difficulty.h"
+#include "CryptoNoteCore/ICoreObserver.h"
+#include "WorkServerCommandsDefinitions.h"
+
+namespace Crypto {
+class cn_context;
+}
+
+namespace CryptoNote {
+
+class core;
+
+// Stratum-style work distribution for external miners and pools. Clients get prebuilt hashing
+// blobs, each client mining its own extra nonce so no two clients search the same nonce space,
+// receive a new job whenever the tip changes and submit nonces only.
+class WorkServer : private ICoreObserver {
+public:
+  WorkServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c);
+  ~WorkServer();
+
+  bool setMinerAddress(const std::string& address);
+  // 0 hands out shares at the block difficulty
+  void setShareDifficulty(difficulty_type difficulty);
+  void start(const std::string& address, uint16_t port);
+  void stop();
+
+private:
+  struct WorkTemplate {
+    bool valid;
+    Block block;
+    difficulty_type difficulty;
+    uint32_t height;
+    // offset of the per-client extra nonce in the coinbase extra
+    size_t extraNonceOffset;
+    uint64_t version;
+  };
+
+  struct Job {
+    std::string id;
+    uint64_t templateVersion;
+    Block block;
+    BinaryArray hashingBlob;
+    size_t nonceOffset;
+    difficulty_type blockDifficulty;
+    difficulty_type shareDifficulty;
+    uint32_t height;
+    std::unordered_set<uint32_t> nonces;
+  };
+
+  struct Session {
+    Session(System::Dispatcher& dispatcher, System::TcpConnection& connection, uint32_t id);
+
+    uint32_t id;
+    bool loggedIn;
+    System::TcpConnection& connection;
+    System::Event writeLock;
+    // jobs on the current tip, newest last
+    std::deque<Job> jobs;
+    std::chrono::steady_clock::time_point shareWindowStart;
+    uint32_t windowShares;
+    // rejected shares since the last accepted one
+    uint32_t invalidShares;
+    // job notifications, interrupted when the connection closes; last, so they stop before the members they use go away
+    System::ContextGroup writers;
+  };
+
+  void acceptLoop();
+  void jobLoop();
+  bool updateTemplate();
+  const Job* getJob(Session& session);
+  WORK_JOB makeJobMessage(const Job& job) const;
+  void sendJob(Session& session);
+
+  void processMessage(Session& session, const std::string& line);
+  void onLogin(Session& session, const COMMAND_WORK_LOGIN::request& req, COMMAND_WORK_LOGIN::response& res);
+  void onSubmit(Session& session, const COMMAND_WORK_SUBMIT::request& req, COMMAND_WORK_SUBMIT::response& res);
+  void writeMessage(Session& session, const Common::JsonValue& message);
+
+  std::unique_ptr<Crypto::cn_context> acquireContext();
+  void releaseContext(std::unique_ptr<Crypto::cn_context>&& context);
+
+  // ICoreObserver
+  virtual void blockchainUpdated() override;
+
+  System::Dispatcher& m_dispatcher;
+  Logging::LoggerRef logger;
+  core& m_core;
+  System::ContextGroup m_workingContextGroup;
+  System::TcpListener m_listener;
+  System::Event m_templateChanged;
+  AccountPublicAddress m_minerAddress;
+  difficulty_type m_shareDifficulty;
+  WorkTemplate m_template;
+  uint32_t m_nextSessionId;
+  std::unordered_map<uint32_t, Session*> m_sessions;
+  // submitted shares are hashed here, away from the dispatcher thread
+  std::unique_ptr<System::WorkerPool> m_hashPool;
+  std::mutex m_contextsLock;
+  std::vector<std::unique_ptr<Crypto::cn_context>> m_contexts;
+};
+
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+
+#include "Serialization/ISerializer.h"
+
+namespace CryptoNote {
+
+// Messages of the work server. Every message is one line of JSON-RPC 2.0, the server also
+// sends WORK_METHOD_JOB notifications without an id when the job of a client changes.
+const char WORK_METHOD_LOGIN[] = "login";
+const char WORK_METHOD_GETJOB[] = "getjob";
+const char WORK_METHOD_SUBMIT[] = "submit";
+const char WORK_METHOD_KEEPALIVED[] = "keepalived";
+const char WORK_METHOD_JOB[] = "job";
+
+struct WORK_JOB {
+  std::string job_id;
+  std::string blob;   // hex hashing blob, the nonce is the last 4 bytes of the block header
+  std::string target; // hex little endian 64 bit target, (2^64 - 1) / difficulty
+  uint64_t difficulty;
+  uint32_t height;
+
+  void serialize(ISerializer &s) {
+    KV_MEMBER(job_id)
+    KV_MEMBER(blob)
+    KV_MEMBER(target)
+    KV_MEMBER(difficulty)
+    KV_MEMBER(height)
+  }
+};
+
+struct COMMAND_WORK_LOGIN {
+  struct request {
+    std::string login; // worker name, only used in the logs
+    std::string agent;
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(login)
+      KV_MEMBER(agent)
+    }
+  };
+
+  struct response {
+    std::string id;
+    WORK_JOB job;
+    std::string status;
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(id)
+      KV_MEMBER(job)
+      KV_MEMBER(status)
+    }
+  };
+};
+
+struct COMMAND_WORK_SUBMIT {
+  struct request {
+    std::string job_id;
+    std::string nonce; // hex, 4 bytes as they appear in the blob
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(job_id)
+      KV_MEMBER(nonce)
+    }
+  };
+
+  struct response {
+    std::string status;
+
+    void serialize(ISerializer &s) {
+      KV_MEMBER(status)
+    }
+  };
+};
+
+}
@@ -8,20 +8,23 @@
 
 #include <ctype.h>
 #include <exception>
+#include <iterator>
+#include <istream>
 
 namespace CryptoNote {
 
 namespace {
 
-Common::JsonValue getJsonValueFromStreamHelper(std::istream& stream) {
-  Common::JsonValue value;
-  stream >> value;
-  return value;
+Common::JsonDocument getJsonDocumentFromStreamHelper(std::istream& stream) {
+  std::string source((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  Common::JsonDocument document;
+  document.parse(source);
+  return document;
 }
 
 }
 
-JsonInputStreamSerializer::JsonInputStreamSerializer(std::istream& stream) : JsonInputValueSerializer(getJsonValueFromStreamHelper(stream)) {
+JsonInputStreamSerializer::JsonInputStreamSerializer(std::istream& stream) : JsonInputValueSerializer(getJsonDocumentFromStreamHelper(stream)) {
 }
 
 JsonInputStreamSerializer::~JsonInputStreamSerializer() {
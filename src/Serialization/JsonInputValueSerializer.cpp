@@ -11,23 +11,42 @@
 
 #include "Common/StringTools.h"
 
+using Common::JsonNode;
 using Common::JsonValue;
 using namespace CryptoNote;
 
-JsonInputValueSerializer::JsonInputValueSerializer(const Common::JsonValue& value) {
-  if (!value.isObject()) {
-    throw std::runtime_error("Serializer doesn't support this type of serialization: Object expected.");
+namespace {
+
+// same checks as Common::fromHex(const std::string&, void*, uint64_t) without copying the text
+uint64_t fromHex(Common::StringView text, void* data, uint64_t bufferSize) {
+  if ((text.getSize() & 1) != 0) {
+    throw std::runtime_error("fromHex: invalid string size");
   }
 
-  chain.push_back(&value);
-}
+  if (text.getSize() >> 1 > bufferSize) {
+    throw std::runtime_error("fromHex: invalid buffer size");
+  }
 
-JsonInputValueSerializer::JsonInputValueSerializer(Common::JsonValue&& value) : value(std::move(value)) {
-  if (!this->value.isObject()) {
-    throw std::runtime_error("Serializer doesn't support this type of serialization: Object expected.");
+  for (uint64_t i = 0; i < text.getSize() >> 1; ++i) {
+    static_cast<uint8_t*>(data)[i] = Common::fromHex(text[i << 1]) << 4 | Common::fromHex(text[(i << 1) + 1]);
   }
 
-  chain.push_back(&this->value);
+  return text.getSize() >> 1;
+}
+
+}
+
+JsonInputValueSerializer::JsonInputValueSerializer(const Common::JsonValue& value) {
+  document.assign(document.getRoot(), value);
+  setRoot(document.getRoot());
+}
+
+JsonInputValueSerializer::JsonInputValueSerializer(Common::JsonDocument&& value) : document(std::move(value)) {
+  setRoot(document.getRoot());
+}
+
+JsonInputValueSerializer::JsonInputValueSerializer(const Common::JsonNode& value) {
+  setRoot(value);
 }
 
 JsonInputValueSerializer::~JsonInputValueSerializer() {
@@ -38,21 +57,13 @@ ISerializer::SerializerType JsonInputValueSerializer::type() const {
 }
 
 bool JsonInputValueSerializer::beginObject(Common::StringView name) {
-  const JsonValue* parent = chain.back();
-
-  if (parent->isArray()) {
-    const JsonValue& v = (*parent)[idxs.back()++];
-    chain.push_back(&v);
-    return true;
-  }
-
-  if (parent->contains(std::string(name))) {
-    const JsonValue& v = (*parent)(std::string(name));
-    chain.push_back(&v);
-    return true;
+  const JsonNode* v = getValue(name);
+  if (v == nullptr) {
+    return false;
   }
 
-  return false;
+  chain.push_back({v, 0});
+  return true;
 }
 
 void JsonInputValueSerializer::endObject() {
@@ -61,27 +72,20 @@ void JsonInputValueSerializer::endObject() {
 }
 
 bool JsonInputValueSerializer::beginArray(uint64_t& size, Common::StringView name) {
-  const JsonValue* parent = chain.back();
-  std::string strName(name);
-
-  if (parent->contains(strName)) {
-    const JsonValue& arr = (*parent)(strName);
-    size = arr.size();
-    chain.push_back(&arr);
-    idxs.push_back(0);
-    return true;
+  const JsonNode* arr = getValue(name);
+  if (arr == nullptr) {
+    size = 0;
+    return false;
   }
- 
-  size = 0;
-  return false;
+
+  size = arr->size();
+  chain.push_back({arr, 0});
+  return true;
 }
 
 void JsonInputValueSerializer::endArray() {
   assert(!chain.empty());
-  assert(!idxs.empty());
-
   chain.pop_back();
-  idxs.pop_back();
 }
 
 bool JsonInputValueSerializer::operator()(uint16_t& value, Common::StringView name) {
@@ -109,7 +113,13 @@ bool JsonInputValueSerializer::operator()(uint64_t& value, Common::StringView na
 }
 
 bool JsonInputValueSerializer::operator()(double& value, Common::StringView name) {
-  return getNumber(name, value);
+  auto ptr = getValue(name);
+  if (ptr == nullptr) {
+    return false;
+  }
+
+  value = ptr->isReal() ? ptr->getReal() : static_cast<double>(ptr->getInteger());
+  return true;
 }
 
 bool JsonInputValueSerializer::operator()(uint8_t& value, Common::StringView name) {
@@ -121,7 +131,7 @@ bool JsonInputValueSerializer::operator()(std::string& value, Common::StringView
   if (ptr == nullptr) {
     return false;
   }
-  value = ptr->getString();
+  value = std::string(ptr->getString());
   return true;
 }
 
@@ -140,7 +150,7 @@ bool JsonInputValueSerializer::binary(void* value, uint64_t size, Common::String
     return false;
   }
 
-  Common::fromHex(ptr->getString(), value, size);
+  fromHex(ptr->getString(), value, size);
   return true;
 }
 
@@ -150,18 +160,32 @@ bool JsonInputValueSerializer::binary(std::string& value, Common::StringView nam
     return false;
   }
 
-  std::string valueHex = ptr->getString();
-  value = Common::asString(Common::fromHex(valueHex));
+  Common::StringView valueHex = ptr->getString();
+  value.resize(valueHex.getSize() >> 1);
+  fromHex(valueHex, &value[0], value.size());
 
   return true;
 }
 
-const JsonValue* JsonInputValueSerializer::getValue(Common::StringView name) {
-  const JsonValue& val = *chain.back();
-  if (val.isArray()) {
-    return &val[idxs.back()++];
+void JsonInputValueSerializer::setRoot(const JsonNode& value) {
+  if (!value.isObject()) {
+    throw std::runtime_error("Serializer doesn't support this type of serialization: Object expected.");
+  }
+
+  chain.push_back({&value, 0});
+}
+
+const JsonNode* JsonInputValueSerializer::getValue(Common::StringView name) {
+  Level& level = chain.back();
+  if (level.node->isArray()) {
+    return &(*level.node)[level.index++];
+  }
+
+  uint64_t index = level.node->findIndex(name, level.index);
+  if (index == level.node->size()) {
+    return nullptr;
   }
 
-  std::string strName(name);
-  return val.contains(strName) ? &val(strName) : nullptr;
+  level.index = index + 1;
+  return &level.node->getMember(index).value;
 }
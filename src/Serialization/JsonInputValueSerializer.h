@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "Common/JsonDocument.h"
 #include "Common/JsonValue.h"
 #include "ISerializer.h"
 
@@ -15,7 +16,9 @@ namespace CryptoNote {
 class JsonInputValueSerializer : public ISerializer {
 public:
   JsonInputValueSerializer(const Common::JsonValue& value);
-  JsonInputValueSerializer(Common::JsonValue&& value);
+  JsonInputValueSerializer(Common::JsonDocument&& document);
+  // 'value' must outlive the serializer
+  JsonInputValueSerializer(const Common::JsonNode& value);
   virtual ~JsonInputValueSerializer();
 
   SerializerType type() const override;
@@ -45,11 +48,17 @@ public:
   }
 
 private:
-  Common::JsonValue value;
-  std::vector<const Common::JsonValue*> chain;
-  std::vector<uint64_t> idxs;
+  struct Level {
+    const Common::JsonNode* node;
+    // next item of an array, member search hint of an object
+    uint64_t index;
+  };
 
-  const Common::JsonValue* getValue(Common::StringView name);
+  Common::JsonDocument document;
+  std::vector<Level> chain;
+
+  void setRoot(const Common::JsonNode& value);
+  const Common::JsonNode* getValue(Common::StringView name);
 
   template <typename T>
   bool getNumber(Common::StringView name, T& v) {
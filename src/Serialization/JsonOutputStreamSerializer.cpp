@@ -9,30 +9,23 @@
 #include <stdexcept>
 #include "Common/StringTools.h"
 
-using Common::JsonValue;
+using Common::JsonNode;
 using namespace CryptoNote;
 
 namespace CryptoNote {
 std::ostream& operator<<(std::ostream& out, const JsonOutputStreamSerializer& enumerator) {
-  out << enumerator.root;
+  out << enumerator.toString();
   return out;
 }
 }
 
-namespace {
-
-template <typename T>
-void insertOrPush(JsonValue& js, Common::StringView name, const T& value) {
-  if (js.isArray()) {
-    js.pushBack(JsonValue(value));
-  } else {
-    js.insert(std::string(name), JsonValue(value));
-  }
-}
-
+JsonOutputStreamSerializer::JsonOutputStreamSerializer() : document(ownDocument) {
+  document.setObject(document.getRoot());
+  chain.push_back(&document.getRoot());
 }
 
-JsonOutputStreamSerializer::JsonOutputStreamSerializer() : root(JsonValue::OBJECT) {
+JsonOutputStreamSerializer::JsonOutputStreamSerializer(Common::JsonDocument& document, Common::JsonNode& root) : document(document) {
+  document.setObject(root);
   chain.push_back(&root);
 }
 
@@ -44,15 +37,9 @@ ISerializer::SerializerType JsonOutputStreamSerializer::type() const {
 }
 
 bool JsonOutputStreamSerializer::beginObject(Common::StringView name) {
-  JsonValue& parent = *chain.back();
-  JsonValue obj(JsonValue::OBJECT);
-
-  if (parent.isObject()) {
-    chain.push_back(&parent.insert(std::string(name), obj));
-  } else {
-    chain.push_back(&parent.pushBack(obj));
-  }
-
+  JsonNode& obj = insertOrPush(name);
+  document.setObject(obj);
+  chain.push_back(&obj);
   return true;
 }
 
@@ -62,9 +49,9 @@ void JsonOutputStreamSerializer::endObject() {
 }
 
 bool JsonOutputStreamSerializer::beginArray(uint64_t& size, Common::StringView name) {
-  JsonValue val(JsonValue::ARRAY);
-  JsonValue& res = chain.back()->insert(std::string(name), val);
-  chain.push_back(&res);
+  JsonNode& arr = insertOrPush(name);
+  document.setArray(arr);
+  chain.push_back(&arr);
   return true;
 }
 
@@ -99,35 +86,46 @@ bool JsonOutputStreamSerializer::operator()(int32_t& value, Common::StringView n
 }
 
 bool JsonOutputStreamSerializer::operator()(int64_t& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  document.setInteger(insertOrPush(name), value);
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(double& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  document.setReal(insertOrPush(name), value);
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(std::string& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  document.setString(insertOrPush(name), value);
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(uint8_t& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, static_cast<int64_t>(value));
+  document.setInteger(insertOrPush(name), value);
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(bool& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  document.setBool(insertOrPush(name), value);
   return true;
 }
 
 bool JsonOutputStreamSerializer::binary(void* value, uint64_t size, Common::StringView name) {
-  std::string hex = Common::toHex(value, size);
+  std::string hex;
+  hex.reserve(size * 2);
+  Common::toHex(value, size, hex);
   return (*this)(hex, name);
 }
 
 bool JsonOutputStreamSerializer::binary(std::string& value, Common::StringView name) {
   return binary(const_cast<char*>(value.data()), value.size(), name);
 }
+
+JsonNode& JsonOutputStreamSerializer::insertOrPush(Common::StringView name) {
+  JsonNode& parent = *chain.back();
+  if (parent.isArray()) {
+    return document.pushBack(parent);
+  }
+
+  return document.insert(parent, name);
+}
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <iostream>
+#include "../Common/JsonDocument.h"
 #include "../Common/JsonValue.h"
 #include "ISerializer.h"
 
@@ -15,6 +16,8 @@ namespace CryptoNote {
 class JsonOutputStreamSerializer : public ISerializer {
 public:
   JsonOutputStreamSerializer();
+  // writes into 'root' of an external document, which must outlive the serializer
+  JsonOutputStreamSerializer(Common::JsonDocument& document, Common::JsonNode& root);
   virtual ~JsonOutputStreamSerializer();
 
   SerializerType type() const override;
@@ -43,15 +46,24 @@ public:
     return ISerializer::operator()(value, name);
   }
 
-  const Common::JsonValue& getValue() const {
-    return root;
+  Common::JsonValue getValue() const {
+    return Common::JsonDocument::toJsonValue(*chain.front());
+  }
+
+  std::string toString() const {
+    std::string text;
+    Common::JsonDocument::write(*chain.front(), text);
+    return text;
   }
 
   friend std::ostream& operator<<(std::ostream& out, const JsonOutputStreamSerializer& enumerator);
 
 private:
-  Common::JsonValue root;
-  std::vector<Common::JsonValue*> chain;
+  Common::JsonDocument ownDocument;
+  Common::JsonDocument& document;
+  std::vector<Common::JsonNode*> chain;
+
+  Common::JsonNode& insertOrPush(Common::StringView name);
 };
 
 }
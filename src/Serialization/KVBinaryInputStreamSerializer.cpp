@@ -6,11 +6,9 @@
 
 #include "KVBinaryInputStreamSerializer.h"
 
-#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
-#include <Common/StreamTools.h>
 #include "KVBinaryCommon.h"
 
 using namespace Common;
@@ -18,147 +16,231 @@ using namespace CryptoNote;
 
 namespace {
 
+const uint64_t MAX_STRING_SIZE = 100 * 1024 * 1024;
+// sections and skipped values recurse per level, deeper storages are rejected before they exhaust the stack
+const size_t MAX_NESTING_DEPTH = 128;
+
 template <typename T>
-T readPod(Common::IInputStream& s) {
+T loadPod(const char* data) {
   T v;
-  read(s, &v, sizeof(T));
+  memcpy(&v, data, sizeof(T));
   return v;
 }
 
-template <typename T, typename JsonT = T>
-JsonValue readPodJson(Common::IInputStream& s) {
-  JsonValue jv;
-  jv = static_cast<JsonT>(readPod<T>(s));
-  return jv;
+uint64_t podSize(uint8_t type) {
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:
+  case BIN_KV_SERIALIZE_TYPE_UINT64:
+  case BIN_KV_SERIALIZE_TYPE_DOUBLE:
+    return 8;
+  case BIN_KV_SERIALIZE_TYPE_INT32:
+  case BIN_KV_SERIALIZE_TYPE_UINT32:
+    return 4;
+  case BIN_KV_SERIALIZE_TYPE_INT16:
+  case BIN_KV_SERIALIZE_TYPE_UINT16:
+    return 2;
+  case BIN_KV_SERIALIZE_TYPE_INT8:
+  case BIN_KV_SERIALIZE_TYPE_UINT8:
+  case BIN_KV_SERIALIZE_TYPE_BOOL:
+    return 1;
+  default:
+    return 0;
+  }
 }
 
-template <typename T>
-JsonValue readIntegerJson(Common::IInputStream& s) {
-  return readPodJson<T, int64_t>(s);
+int64_t loadInteger(const char* data, uint8_t type) {
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:  return loadPod<int64_t>(data);
+  case BIN_KV_SERIALIZE_TYPE_INT32:  return loadPod<int32_t>(data);
+  case BIN_KV_SERIALIZE_TYPE_INT16:  return loadPod<int16_t>(data);
+  case BIN_KV_SERIALIZE_TYPE_INT8:   return loadPod<int8_t>(data);
+  case BIN_KV_SERIALIZE_TYPE_UINT64: return static_cast<int64_t>(loadPod<uint64_t>(data));
+  case BIN_KV_SERIALIZE_TYPE_UINT32: return loadPod<uint32_t>(data);
+  case BIN_KV_SERIALIZE_TYPE_UINT16: return loadPod<uint16_t>(data);
+  case BIN_KV_SERIALIZE_TYPE_UINT8:  return loadPod<uint8_t>(data);
+  default:
+    throw std::runtime_error("Integer value expected");
+  }
 }
 
-uint64_t readVarint(Common::IInputStream& s) {
-  uint8_t b = read<uint8_t>(s);
-  uint8_t size_mask = b & PORTABLE_RAW_SIZE_MARK_MASK;
-  uint64_t bytesLeft = 0;
+}
 
-  switch (size_mask){
-  case PORTABLE_RAW_SIZE_MARK_BYTE:
-    bytesLeft = 0;
-    break;
-  case PORTABLE_RAW_SIZE_MARK_WORD:
-    bytesLeft = 1;
-    break;
-  case PORTABLE_RAW_SIZE_MARK_DWORD:
-    bytesLeft = 3;
-    break;
-  case PORTABLE_RAW_SIZE_MARK_INT64:
-    bytesLeft = 7;
-    break;
+KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(Common::IInputStream& strm) {
+  char chunk[4096];
+  for (;;) {
+    uint64_t read = strm.readSome(chunk, sizeof(chunk));
+    if (read == 0) {
+      break;
+    }
+
+    m_buffer.append(chunk, read);
   }
 
-  uint64_t value = b;
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+  parseHeader();
+}
 
-  for (uint64_t i = 1; i <= bytesLeft; ++i) {
-    uint64_t n = read<uint8_t>(s);
-    value |= n << (i * 8);
-  }
+KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(const void* data, uint64_t size) :
+  m_data(static_cast<const char*>(data)), m_size(size) {
+  parseHeader();
+}
 
-  value >>= 2;
-  return value;
+ISerializer::SerializerType KVBinaryInputStreamSerializer::type() const {
+  return ISerializer::INPUT;
 }
 
-std::string readString(Common::IInputStream& s) {
-  auto size = readVarint(s);
-  if (size > 100 * 1024 * 1024) {
-    throw std::runtime_error("string size is too big");
+bool KVBinaryInputStreamSerializer::beginObject(Common::StringView name) {
+  uint8_t type;
+  uint64_t position;
+  bool advance;
+  if (!findValue(name, type, position, advance)) {
+    return false;
   }
 
-  std::string str;
-  str.resize(size);
-  if (size) {
-    read(s, &str[0], size);
+  if (type != BIN_KV_SERIALIZE_TYPE_OBJECT) {
+    throw std::runtime_error("Object expected");
   }
-  return str;
+
+  pushSection(false, 0, position, advance);
+  return true;
 }
 
-JsonValue readStringJson(Common::IInputStream& s) {
-  return JsonValue(readString(s));
+void KVBinaryInputStreamSerializer::endObject() {
+  popSection();
 }
 
-void readName(Common::IInputStream& s, std::string& name) {
-  uint8_t len = readPod<uint8_t>(s);
-  if (len) {
-    name.resize(len);
-    read(s, &name[0], len);
+bool KVBinaryInputStreamSerializer::beginArray(uint64_t& size, Common::StringView name) {
+  size = 0;
+  assert(!m_stack.empty());
+  if (m_stack.back().isArray) {
+    throw std::runtime_error("Nested arrays are not supported");
+  }
+
+  uint8_t type;
+  uint64_t position;
+  bool advance;
+  if (!findValue(name, type, position, advance)) {
+    return false;
+  }
+
+  uint8_t itemType;
+  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
+    itemType = type & ~BIN_KV_SERIALIZE_FLAG_ARRAY;
+  } else if (type == BIN_KV_SERIALIZE_TYPE_ARRAY) {
+    itemType = BIN_KV_SERIALIZE_TYPE_ARRAY;
+  } else {
+    throw std::runtime_error("Array expected");
   }
+
+  pushSection(true, itemType, position, advance);
+  size = m_stack.back().count;
+  return true;
 }
 
-JsonValue loadValue(Common::IInputStream& stream, uint8_t type);
-JsonValue loadSection(Common::IInputStream& stream);
-JsonValue loadEntry(Common::IInputStream& stream);
-JsonValue loadArray(Common::IInputStream& stream, uint8_t itemType);
+void KVBinaryInputStreamSerializer::endArray() {
+  popSection();
+}
 
+bool KVBinaryInputStreamSerializer::operator()(uint8_t& value, Common::StringView name) {
+  return readNumber(value, name);
+}
 
-JsonValue loadSection(Common::IInputStream& stream) {
-  JsonValue sec(JsonValue::OBJECT);
-  uint64_t count = readVarint(stream);
-  std::string name;
+bool KVBinaryInputStreamSerializer::operator()(int16_t& value, Common::StringView name) {
+  return readNumber(value, name);
+}
 
-  while (count--) {
-    readName(stream, name);
-    sec.insert(name, loadEntry(stream));
-  }
+bool KVBinaryInputStreamSerializer::operator()(uint16_t& value, Common::StringView name) {
+  return readNumber(value, name);
+}
 
-  return sec;
+bool KVBinaryInputStreamSerializer::operator()(int32_t& value, Common::StringView name) {
+  return readNumber(value, name);
 }
 
-JsonValue loadValue(Common::IInputStream& stream, uint8_t type) {
-  switch (type) {
-  case BIN_KV_SERIALIZE_TYPE_INT64:  return readIntegerJson<int64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT32:  return readIntegerJson<int32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT16:  return readIntegerJson<int16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT8:   return readIntegerJson<int8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT64: return readIntegerJson<uint64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT32: return readIntegerJson<uint32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT16: return readIntegerJson<uint16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT8:  return readIntegerJson<uint8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_DOUBLE: return readPodJson<double>(stream);
-  case BIN_KV_SERIALIZE_TYPE_BOOL:   return JsonValue(read<uint8_t>(stream) != 0);
-  case BIN_KV_SERIALIZE_TYPE_STRING: return readStringJson(stream);
-  case BIN_KV_SERIALIZE_TYPE_OBJECT: return loadSection(stream);
-  case BIN_KV_SERIALIZE_TYPE_ARRAY:  return loadArray(stream, type);
-  default:
-    throw std::runtime_error("Unknown data type");
-    break;
+bool KVBinaryInputStreamSerializer::operator()(uint32_t& value, Common::StringView name) {
+  return readNumber(value, name);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(int64_t& value, Common::StringView name) {
+  return readNumber(value, name);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(uint64_t& value, Common::StringView name) {
+  return readNumber(value, name);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(double& value, Common::StringView name) {
+  uint8_t type;
+  uint64_t position;
+  bool advance;
+  if (!findValue(name, type, position, advance)) {
+    return false;
   }
+
+  if (type == BIN_KV_SERIALIZE_TYPE_DOUBLE) {
+    check(position, sizeof(double));
+    value = loadPod<double>(m_data + position);
+  } else {
+    check(position, podSize(type));
+    value = static_cast<double>(loadInteger(m_data + position, type));
+  }
+
+  finishValue(advance, position + podSize(type));
+  return true;
 }
 
-JsonValue loadEntry(Common::IInputStream& stream) {
-  uint8_t type = readPod<uint8_t>(stream);
+bool KVBinaryInputStreamSerializer::operator()(bool& value, Common::StringView name) {
+  uint8_t type;
+  uint64_t position;
+  bool advance;
+  if (!findValue(name, type, position, advance)) {
+    return false;
+  }
 
-  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
-    type &= ~BIN_KV_SERIALIZE_FLAG_ARRAY;
-    return loadArray(stream, type);
+  if (type != BIN_KV_SERIALIZE_TYPE_BOOL) {
+    throw std::runtime_error("Bool value expected");
   }
 
-  return loadValue(stream, type);
+  check(position, 1);
+  value = m_data[position] != 0;
+  finishValue(advance, position + 1);
+  return true;
 }
 
-JsonValue loadArray(Common::IInputStream& stream, uint8_t itemType) {
-  JsonValue arr(JsonValue::ARRAY);
-  uint64_t count = readVarint(stream);
+bool KVBinaryInputStreamSerializer::operator()(std::string& value, Common::StringView name) {
+  const char* data;
+  uint64_t size;
+  if (!readString(name, data, size)) {
+    return false;
+  }
 
-  while (count--) {
-    arr.pushBack(loadValue(stream, itemType));
+  value.assign(data, size);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::binary(void* value, uint64_t size, Common::StringView name) {
+  const char* data;
+  uint64_t dataSize;
+  if (!readString(name, data, dataSize)) {
+    return false;
   }
 
-  return arr;
+  if (dataSize != size) {
+    throw std::runtime_error("Binary block size mismatch");
+  }
+
+  memcpy(value, data, size);
+  return true;
 }
 
+bool KVBinaryInputStreamSerializer::binary(std::string& value, Common::StringView name) {
+  return (*this)(value, name); // load as string
+}
 
-JsonValue parseBinary(Common::IInputStream& stream) {
-  auto hdr = readPod<KVBinaryStorageBlockHeader>(stream);
+void KVBinaryInputStreamSerializer::parseHeader() {
+  check(0, sizeof(KVBinaryStorageBlockHeader));
+  auto hdr = loadPod<KVBinaryStorageBlockHeader>(m_data);
 
   if (
     hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
@@ -170,30 +252,255 @@ JsonValue parseBinary(Common::IInputStream& stream) {
     throw std::runtime_error("Unknown binary storage format version");
   }
 
-  return loadSection(stream);
+  pushSection(false, 0, sizeof(KVBinaryStorageBlockHeader), false);
 }
 
+void KVBinaryInputStreamSerializer::pushSection(bool isArray, uint8_t itemType, uint64_t position, bool advanceParent) {
+  if (m_stack.size() >= MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Binary storage is nested too deep");
+  }
+
+  Section section;
+  section.isArray = isArray;
+  section.itemType = itemType;
+  section.count = readVarint(position);
+  section.begin = position;
+  section.position = position;
+  section.consumed = 0;
+  section.end = 0;
+  section.advanceParent = advanceParent;
+  m_stack.push_back(std::move(section));
 }
 
-KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(Common::IInputStream& strm) : JsonInputValueSerializer(parseBinary(strm)) {
+void KVBinaryInputStreamSerializer::popSection() {
+  assert(m_stack.size() > 1);
+  Section& section = m_stack.back();
+  uint64_t end = section.end;
+  if (end == 0) {
+    // skip whatever the reader did not ask for
+    if (section.isArray) {
+      end = section.position;
+      for (uint64_t i = section.consumed; i < section.count; ++i) {
+        end = skipValue(end, section.itemType, m_stack.size());
+      }
+    } else {
+      end = skipEntries(section.position, section.count - section.consumed, m_stack.size());
+    }
+  }
+
+  bool advance = section.advanceParent;
+  m_stack.pop_back();
+  finishValue(advance, end);
 }
 
-bool KVBinaryInputStreamSerializer::binary(void* value, uint64_t size, Common::StringView name) {
-  std::string str;
+bool KVBinaryInputStreamSerializer::findValue(Common::StringView name, uint8_t& type, uint64_t& position, bool& advance) {
+  assert(!m_stack.empty());
+  Section& section = m_stack.back();
+
+  if (section.isArray) {
+    if (section.consumed >= section.count) {
+      throw std::runtime_error("Array index out of range");
+    }
+
+    type = section.itemType;
+    position = section.position;
+    advance = true;
+    return true;
+  }
+
+  // fast path: the entry is the next one stored
+  if (section.consumed < section.count) {
+    uint64_t entryPosition = section.position;
+    if (readName(entryPosition) == name) {
+      check(entryPosition, 1);
+      type = static_cast<uint8_t>(m_data[entryPosition]);
+      position = entryPosition + 1;
+      advance = true;
+      return true;
+    }
+  }
+
+  if (section.index.empty() && section.count != 0) {
+    buildIndex(section);
+  }
+
+  for (const auto& entry : section.index) {
+    if (entry.first == name) {
+      type = static_cast<uint8_t>(m_data[entry.second]);
+      position = entry.second + 1;
+      advance = false;
+      return true;
+    }
+  }
 
-  if (!(*this)(str, name)) {
+  return false;
+}
+
+void KVBinaryInputStreamSerializer::finishValue(bool advance, uint64_t end) {
+  if (!advance) {
+    return;
+  }
+
+  Section& section = m_stack.back();
+  section.position = end;
+  ++section.consumed;
+}
+
+void KVBinaryInputStreamSerializer::buildIndex(Section& section) {
+  section.index.reserve(section.count);
+  uint64_t position = section.begin;
+  for (uint64_t i = 0; i < section.count; ++i) {
+    Common::StringView name = readName(position);
+    section.index.emplace_back(name, position);
+    position = skipEntryValue(position, m_stack.size());
+  }
+
+  section.end = position;
+}
+
+template<typename T>
+bool KVBinaryInputStreamSerializer::readNumber(T& value, Common::StringView name) {
+  uint8_t type;
+  uint64_t position;
+  bool advance;
+  if (!findValue(name, type, position, advance)) {
     return false;
   }
 
-  if (str.size() != size) {
-    throw std::runtime_error("Binary block size mismatch");
+  check(position, podSize(type));
+  value = static_cast<T>(loadInteger(m_data + position, type));
+  finishValue(advance, position + podSize(type));
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::readString(Common::StringView name, const char*& data, uint64_t& size) {
+  uint8_t type;
+  uint64_t position;
+  bool advance;
+  if (!findValue(name, type, position, advance)) {
+    return false;
+  }
+
+  if (type != BIN_KV_SERIALIZE_TYPE_STRING) {
+    throw std::runtime_error("String value expected");
   }
 
-  memcpy(value, str.data(), size);
+  size = readVarint(position);
+  if (size > MAX_STRING_SIZE) {
+    throw std::runtime_error("string size is too big");
+  }
+
+  check(position, size);
+  data = m_data + position;
+  finishValue(advance, position + size);
   return true;
 }
 
-bool KVBinaryInputStreamSerializer::binary(std::string& value, Common::StringView name) {
-  return (*this)(value, name); // load as string
+uint64_t KVBinaryInputStreamSerializer::readVarint(uint64_t& position) const {
+  check(position, 1);
+  uint8_t b = static_cast<uint8_t>(m_data[position]);
+  uint8_t size_mask = b & PORTABLE_RAW_SIZE_MARK_MASK;
+  uint64_t bytesLeft = 0;
+
+  switch (size_mask){
+  case PORTABLE_RAW_SIZE_MARK_BYTE:
+    bytesLeft = 0;
+    break;
+  case PORTABLE_RAW_SIZE_MARK_WORD:
+    bytesLeft = 1;
+    break;
+  case PORTABLE_RAW_SIZE_MARK_DWORD:
+    bytesLeft = 3;
+    break;
+  case PORTABLE_RAW_SIZE_MARK_INT64:
+    bytesLeft = 7;
+    break;
+  }
+
+  check(position, bytesLeft + 1);
+  uint64_t value = b;
+
+  for (uint64_t i = 1; i <= bytesLeft; ++i) {
+    uint64_t n = static_cast<uint8_t>(m_data[position + i]);
+    value |= n << (i * 8);
+  }
+
+  position += bytesLeft + 1;
+  value >>= 2;
+  return value;
+}
+
+Common::StringView KVBinaryInputStreamSerializer::readName(uint64_t& position) const {
+  check(position, 1);
+  uint8_t len = static_cast<uint8_t>(m_data[position]);
+  check(position + 1, len);
+  Common::StringView name(m_data + position + 1, len);
+  position += 1 + len;
+  return name;
+}
+
+void KVBinaryInputStreamSerializer::check(uint64_t position, uint64_t size) const {
+  if (position > m_size || size > m_size - position) {
+    throw std::runtime_error("Unexpected end of binary storage");
+  }
 }
 
+uint64_t KVBinaryInputStreamSerializer::skipValue(uint64_t position, uint8_t type, size_t depth) const {
+  if ((type == BIN_KV_SERIALIZE_TYPE_OBJECT || type == BIN_KV_SERIALIZE_TYPE_ARRAY) && depth >= MAX_NESTING_DEPTH) {
+    throw std::runtime_error("Binary storage is nested too deep");
+  }
+
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_STRING: {
+    uint64_t size = readVarint(position);
+    check(position, size);
+    return position + size;
+  }
+  case BIN_KV_SERIALIZE_TYPE_OBJECT: {
+    uint64_t count = readVarint(position);
+    return skipEntries(position, count, depth + 1);
+  }
+  case BIN_KV_SERIALIZE_TYPE_ARRAY: {
+    uint64_t count = readVarint(position);
+    for (uint64_t i = 0; i < count; ++i) {
+      position = skipValue(position, type, depth + 1);
+    }
+
+    return position;
+  }
+  default: {
+    uint64_t size = podSize(type);
+    if (size == 0) {
+      throw std::runtime_error("Unknown data type");
+    }
+
+    check(position, size);
+    return position + size;
+  }
+  }
+}
+
+uint64_t KVBinaryInputStreamSerializer::skipEntryValue(uint64_t position, size_t depth) const {
+  check(position, 1);
+  uint8_t type = static_cast<uint8_t>(m_data[position++]);
+  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
+    type &= ~BIN_KV_SERIALIZE_FLAG_ARRAY;
+    uint64_t count = readVarint(position);
+    for (uint64_t i = 0; i < count; ++i) {
+      position = skipValue(position, type, depth);
+    }
+
+    return position;
+  }
+
+  return skipValue(position, type, depth);
+}
+
+uint64_t KVBinaryInputStreamSerializer::skipEntries(uint64_t position, uint64_t count, size_t depth) const {
+  for (uint64_t i = 0; i < count; ++i) {
+    readName(position);
+    position = skipEntryValue(position, depth);
+  }
+
+  return position;
+}
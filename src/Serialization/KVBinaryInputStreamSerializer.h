@@ -6,18 +6,85 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <Common/IInputStream.h>
 #include "ISerializer.h"
-#include "JsonInputValueSerializer.h"
 
 namespace CryptoNote {
 
-class KVBinaryInputStreamSerializer : public JsonInputValueSerializer {
+// Binds portable storage entries directly to serializer calls while walking the buffer.
+// Entries are expected in the order they are requested; a section is indexed by name only
+// when a request does not match the next stored entry.
+class KVBinaryInputStreamSerializer : public ISerializer {
 public:
   KVBinaryInputStreamSerializer(Common::IInputStream& strm);
+  KVBinaryInputStreamSerializer(const void* data, uint64_t size);
+  virtual ~KVBinaryInputStreamSerializer() {}
+
+  virtual ISerializer::SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
 
+  virtual bool beginArray(uint64_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
   virtual bool binary(void* value, uint64_t size, Common::StringView name) override;
   virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+private:
+  struct Section {
+    bool isArray;
+    uint8_t itemType;
+    uint64_t begin;
+    uint64_t count;
+    uint64_t position;
+    uint64_t consumed;
+    uint64_t end;
+    bool advanceParent;
+    std::vector<std::pair<Common::StringView, uint64_t>> index;
+  };
+
+  void parseHeader();
+  void pushSection(bool isArray, uint8_t itemType, uint64_t position, bool advanceParent);
+  void popSection();
+  bool findValue(Common::StringView name, uint8_t& type, uint64_t& position, bool& advance);
+  void finishValue(bool advance, uint64_t end);
+  void buildIndex(Section& section);
+
+  template<typename T>
+  bool readNumber(T& value, Common::StringView name);
+  bool readString(Common::StringView name, const char*& data, uint64_t& size);
+
+  uint64_t readVarint(uint64_t& position) const;
+  Common::StringView readName(uint64_t& position) const;
+  void check(uint64_t position, uint64_t size) const;
+  // 'depth' is the nesting level of the skipped value, values nested deeper than 128 levels throw
+  uint64_t skipValue(uint64_t position, uint8_t type, size_t depth) const;
+  uint64_t skipEntryValue(uint64_t position, size_t depth) const;
+  uint64_t skipEntries(uint64_t position, uint64_t count, size_t depth) const;
+
+  std::string m_buffer;
+  const char* m_data;
+  uint64_t m_size;
+  std::vector<Section> m_stack;
 };
 
 }
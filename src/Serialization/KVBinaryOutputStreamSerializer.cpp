@@ -58,12 +58,11 @@ uint64_t writeArraySize(IOutputStream& s, uint64_t val) {
 
 namespace CryptoNote {
 
-KVBinaryOutputStreamSerializer::KVBinaryOutputStreamSerializer() {
-  beginObject(std::string());
+KVBinaryOutputStreamSerializer::KVBinaryOutputStreamSerializer() : m_stream(m_buffer) {
+  m_stack.push_back(Level(0));
 }
 
 void KVBinaryOutputStreamSerializer::dump(IOutputStream& target) {
-  assert(m_objectsStack.size() == 1);
   assert(m_stack.size() == 1);
 
   KVBinaryStorageBlockHeader hdr;
@@ -73,7 +72,7 @@ void KVBinaryOutputStreamSerializer::dump(IOutputStream& target) {
 
   Common::write(target, &hdr, sizeof(hdr));
   writeArraySize(target, m_stack.front().count);
-  write(target, stream().data(), stream().size());
+  write(target, m_buffer.data(), m_buffer.size());
 }
 
 ISerializer::SerializerType KVBinaryOutputStreamSerializer::type() const {
@@ -81,29 +80,29 @@ ISerializer::SerializerType KVBinaryOutputStreamSerializer::type() const {
 }
 
 bool KVBinaryOutputStreamSerializer::beginObject(Common::StringView name) {
-  checkArrayPreamble(BIN_KV_SERIALIZE_TYPE_OBJECT);
- 
-  m_stack.push_back(Level(name));
-  m_objectsStack.push_back(MemoryStream());
+  writeElementPrefix(BIN_KV_SERIALIZE_TYPE_OBJECT, name);
+
+  // one byte covers up to 63 entries, endObject widens it otherwise
+  m_stack.push_back(Level(m_buffer.size()));
+  m_buffer.push_back(0);
 
   return true;
 }
 
 void KVBinaryOutputStreamSerializer::endObject() {
-  assert(m_objectsStack.size());
+  assert(m_stack.size() > 1);
 
-  auto level = std::move(m_stack.back());
+  Level level = std::move(m_stack.back());
   m_stack.pop_back();
 
-  auto objStream = std::move(m_objectsStack.back());
-  m_objectsStack.pop_back();
-
-  auto& out = stream();
-
-  writeElementPrefix(BIN_KV_SERIALIZE_TYPE_OBJECT, level.name);
+  std::vector<uint8_t> count;
+  VectorOutputStream countStream(count);
+  writeArraySize(countStream, level.count);
 
-  writeArraySize(out, level.count);
-  write(out, objStream.data(), objStream.size());
+  m_buffer[level.countOffset] = count[0];
+  if (count.size() > 1) {
+    m_buffer.insert(m_buffer.begin() + level.countOffset + 1, count.begin() + 1, count.end());
+  }
 }
 
 bool KVBinaryOutputStreamSerializer::beginArray(uint64_t& size, Common::StringView name) {
@@ -230,10 +229,8 @@ void KVBinaryOutputStreamSerializer::checkArrayPreamble(uint8_t type) {
   }
 }
 
-
-MemoryStream& KVBinaryOutputStreamSerializer::stream() {
-  assert(m_objectsStack.size());
-  return m_objectsStack.back();
+IOutputStream& KVBinaryOutputStreamSerializer::stream() {
+  return m_stream;
 }
 
 }
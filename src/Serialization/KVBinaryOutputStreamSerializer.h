@@ -8,8 +8,8 @@
 
 #include <vector>
 #include <Common/IOutputStream.h>
+#include <Common/VectorOutputStream.h>
 #include "ISerializer.h"
-#include "MemoryStream.h"
 
 namespace CryptoNote {
 
@@ -51,8 +51,7 @@ private:
 
   void writeElementPrefix(uint8_t type, Common::StringView name);
   void checkArrayPreamble(uint8_t type);
-  void updateState(uint8_t type);
-  MemoryStream& stream();
+  Common::IOutputStream& stream();
 
   enum class State {
     Root,
@@ -65,22 +64,18 @@ private:
     State state;
     std::string name;
     uint64_t count;
+    size_t countOffset;
 
-    Level(Common::StringView nm) :
-      name(nm), state(State::Object), count(0) {}
+    Level(size_t offset) :
+      state(State::Object), count(0), countOffset(offset) {}
 
     Level(Common::StringView nm, uint64_t arraySize) :
-      name(nm), state(State::ArrayPrefix), count(arraySize) {}
-
-    Level(Level&& rv) {
-      state = rv.state;
-      name = std::move(rv.name);
-      count = rv.count;
-    }
-
+      state(State::ArrayPrefix), name(nm), count(arraySize), countOffset(0) {}
   };
 
-  std::vector<MemoryStream> m_objectsStack;
+  // objects are written in place; the entry count is patched into countOffset on endObject
+  std::vector<uint8_t> m_buffer;
+  Common::VectorOutputStream m_stream;
   std::vector<Level> m_stack;
 };
 
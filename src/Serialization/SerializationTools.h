@@ -80,7 +80,55 @@ void loadFromJsonValue(std::list<T>& v, const Common::JsonValue& js) {
 
 template <typename T>
 std::string storeToJson(const T& v) {
-  return storeToJsonValue(v).toString();
+  JsonOutputStreamSerializer s;
+  serialize(const_cast<T&>(v), s);
+  return s.toString();
+}
+
+template <typename T>
+std::string storeToJson(const std::vector<T>& v) { return storeToJsonValue(v).toString(); }
+
+template <typename T>
+std::string storeToJson(const std::list<T>& v) { return storeToJsonValue(v).toString(); }
+
+template <>
+inline std::string storeToJson(const std::string& v) { return storeToJsonValue(v).toString(); }
+
+template <typename T>
+void storeToJsonNode(const T& v, Common::JsonDocument& document, Common::JsonNode& node) {
+  JsonOutputStreamSerializer s(document, node);
+  serialize(const_cast<T&>(v), s);
+}
+
+template <typename T>
+void storeToJsonNode(const std::vector<T>& v, Common::JsonDocument& document, Common::JsonNode& node) {
+  document.assign(node, storeToJsonValue(v));
+}
+
+template <typename T>
+void storeToJsonNode(const std::list<T>& v, Common::JsonDocument& document, Common::JsonNode& node) {
+  document.assign(node, storeToJsonValue(v));
+}
+
+template <>
+inline void storeToJsonNode(const std::string& v, Common::JsonDocument& document, Common::JsonNode& node) {
+  document.setString(node, v);
+}
+
+template <typename T>
+void loadFromJsonNode(T& v, const Common::JsonNode& node) {
+  JsonInputValueSerializer s(node);
+  serialize(v, s);
+}
+
+template <typename T>
+void loadFromJsonNode(std::vector<T>& v, const Common::JsonNode& node) {
+  loadFromJsonValue(v, Common::JsonDocument::toJsonValue(node));
+}
+
+template <typename T>
+void loadFromJsonNode(std::list<T>& v, const Common::JsonNode& node) {
+  loadFromJsonValue(v, Common::JsonDocument::toJsonValue(node));
 }
 
 template <typename T>
@@ -89,8 +137,9 @@ bool loadFromJson(T& v, const std::string& buf) {
     if (buf.empty()) {
       return true;
     }
-    auto js = Common::JsonValue::fromString(buf);
-    loadFromJsonValue(v, js);
+    Common::JsonDocument document;
+    document.parse(buf);
+    loadFromJsonNode(v, document.getRoot());
   } catch (std::exception&) {
     return false;
   }
@@ -111,8 +160,7 @@ std::string storeToBinaryKeyValue(const T& v) {
 template <typename T>
 bool loadFromBinaryKeyValue(T& v, const std::string& buf) {
   try {
-    Common::MemoryInputStream stream(buf.data(), buf.size());
-    KVBinaryInputStreamSerializer s(stream);
+    KVBinaryInputStreamSerializer s(buf.data(), buf.size());
     serialize(v, s);
     return true;
   } catch (std::exception&) {
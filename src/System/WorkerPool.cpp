@@ -0,0 +1,119 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <exception>
+
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+
+namespace System {
+
+WorkerPool::WorkerPool(Dispatcher& dispatcher, size_t threadCount) : m_dispatcher(dispatcher), m_stopped(false) {
+  m_threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back(&WorkerPool::workerProcedure, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+  }
+
+  m_condition.notify_all();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::execute(const std::function<void()>& task) {
+  execute(std::vector<std::function<void()>>(1, task));
+}
+
+void WorkerPool::execute(const std::vector<std::function<void()>>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  Event done(m_dispatcher);
+  std::atomic<size_t> remaining(tasks.size());
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& task : tasks) {
+      m_tasks.emplace_back([this, &task, &done, &remaining, &errorMutex, &error] {
+        try {
+          task();
+        } catch (...) {
+          std::lock_guard<std::mutex> errorLock(errorMutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+
+        // the event is owned by the waiting context, only its address may be used after the last decrement
+        Event* event = &done;
+        if (--remaining == 0) {
+          m_dispatcher.remoteSpawn([event] { event->set(); });
+        }
+      });
+    }
+  }
+
+  if (tasks.size() == 1) {
+    m_condition.notify_one();
+  } else {
+    m_condition.notify_all();
+  }
+
+  // The tasks reference this frame, so return only after they have completed even if interrupted
+  bool interrupted = false;
+  while (!done.get()) {
+    try {
+      done.wait();
+    } catch (InterruptedException&) {
+      interrupted = true;
+    }
+  }
+
+  if (interrupted) {
+    m_dispatcher.interrupt();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+size_t WorkerPool::getThreadCount() const {
+  return m_threads.size();
+}
+
+void WorkerPool::workerProcedure() {
+  for (;;) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this] { return m_stopped || !m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return;
+      }
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+}
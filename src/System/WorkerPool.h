@@ -0,0 +1,48 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <System/Dispatcher.h>
+
+namespace System {
+
+// Fixed set of threads executing work that does not need the dispatcher.
+class WorkerPool {
+public:
+  WorkerPool(Dispatcher& dispatcher, size_t threadCount);
+  WorkerPool(const WorkerPool&) = delete;
+  ~WorkerPool();
+
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Run task on a worker thread. The calling context is suspended until the task completes,
+  // other contexts keep running on the dispatcher. Exceptions thrown by the task are rethrown here.
+  void execute(const std::function<void()>& task);
+  // Same for a set of tasks spread over the workers, returns once all of them completed.
+  // The first exception thrown by any task is rethrown.
+  void execute(const std::vector<std::function<void()>>& tasks);
+
+  size_t getThreadCount() const;
+
+private:
+  void workerProcedure();
+
+  Dispatcher& m_dispatcher;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::deque<std::function<void()>> m_tasks;
+  bool m_stopped;
+};
+
+}
@@ -5,8 +5,39 @@
 
 #include "cryptonight.hpp"
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 namespace Crypto {
 
+cn_context::cn_context(cn_scratchpad_memory memory) {
+#ifdef __linux__
+	if(memory == cn_scratchpad_memory::huge_pages) {
+		void* state = mmap(nullptr, CN_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if(state != MAP_FAILED) {
+			long_state = static_cast<uint8_t*>(state);
+			huge_pages = true;
+		}
+	}
+#endif
+	if(long_state == nullptr)
+		long_state = (uint8_t*)boost::alignment::aligned_alloc(4096, CN_PAGE_SIZE);
+	hash_state = (uint8_t*)boost::alignment::aligned_alloc(4096, 4096);
+}
+
+cn_context::~cn_context() {
+#ifdef __linux__
+	if(huge_pages) {
+		munmap(long_state, CN_PAGE_SIZE);
+		long_state = nullptr;
+	}
+#endif
+	if(long_state != nullptr)
+		boost::alignment::aligned_free(long_state);
+	if(hash_state != nullptr)
+		boost::alignment::aligned_free(hash_state);
+}
 
 void cn_slow_hash(cn_context &context, const void *data, size_t length, Hash &hash) {
 	if(hw_check_aes())
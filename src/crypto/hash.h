@@ -42,28 +42,26 @@ namespace Crypto {
     return h;
   }
 
+  /* Where the scratchpad of a cn_context lives, huge pages fall back to normal memory when none are reserved */
+  enum class cn_scratchpad_memory { normal, huge_pages };
+
   class cn_context {
   public:
 
-    cn_context()
-    {
-        long_state = (uint8_t*)boost::alignment::aligned_alloc(4096, CN_PAGE_SIZE);
-        hash_state = (uint8_t*)boost::alignment::aligned_alloc(4096, 4096);
-    }
-
-    ~cn_context()
-    {
-        if(long_state != nullptr)
-            boost::alignment::aligned_free(long_state);
-        if(hash_state != nullptr)
-            boost::alignment::aligned_free(hash_state);
-    }
+    cn_context() : cn_context(cn_scratchpad_memory::normal) {}
+    explicit cn_context(cn_scratchpad_memory memory);
+    ~cn_context();
 
     cn_context(const cn_context &) = delete;
     void operator=(const cn_context &) = delete;
 
+    bool has_huge_pages() const { return huge_pages; }
+
      uint8_t* long_state = nullptr;
      uint8_t* hash_state = nullptr;
+
+  private:
+     bool huge_pages = false;
   };
 
   void cn_slow_hash(cn_context &context, const void *data, size_t length, Hash &hash);
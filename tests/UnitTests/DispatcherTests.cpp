@@ -0,0 +1,63 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <System/ContextGroup.h>
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+
+namespace {
+
+// Two contexts hand control to each other through a pair of events, two switches per round
+template<class F>
+void pingPong(System::Dispatcher& dispatcher, size_t rounds, F onRound) {
+  System::Event ping(dispatcher);
+  System::Event pong(dispatcher);
+  System::ContextGroup group(dispatcher);
+  group.spawn([&] {
+    for (size_t i = 0; i < rounds; ++i) {
+      ping.wait();
+      ping.clear();
+      onRound('b');
+      pong.set();
+    }
+  });
+
+  for (size_t i = 0; i < rounds; ++i) {
+    onRound('a');
+    ping.set();
+    pong.wait();
+    pong.clear();
+  }
+
+  group.wait();
+}
+
+}
+
+TEST(Dispatcher, alternatesBetweenContexts) {
+  System::Dispatcher dispatcher;
+  std::string trace;
+  pingPong(dispatcher, 3, [&](char side) { trace += side; });
+  EXPECT_EQ("ababab", trace);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(Dispatcher, DISABLED_benchmarkContextSwitch) {
+  System::Dispatcher dispatcher;
+  const size_t rounds = 1000000;
+  size_t count = 0;
+  auto start = std::chrono::steady_clock::now();
+  pingPong(dispatcher, rounds, [&](char) { ++count; });
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << 2 * rounds / seconds / 1e6 << " M switches/s" << std::endl;
+  EXPECT_EQ(2 * rounds, count);
+}
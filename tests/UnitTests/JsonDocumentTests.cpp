@@ -0,0 +1,165 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "Common/JsonDocument.h"
+#include "Common/JsonValue.h"
+
+using namespace Common;
+
+namespace {
+
+const JsonNode& parse(JsonDocument& document, const std::string& text) {
+  document.parse(StringView(text.data(), text.size()));
+  return document.getRoot();
+}
+
+std::string nested(size_t depth) {
+  return std::string(depth, '[') + std::string(depth, ']');
+}
+
+std::string nestedObjects(size_t depth) {
+  std::string text;
+  for (size_t i = 0; i < depth; ++i) {
+    text += "{\"a\":";
+  }
+
+  return text + "1" + std::string(depth, '}');
+}
+
+// a getblocks-like reply: many small objects with hashes, counters and nested arrays
+std::string blockListPayload(size_t count) {
+  std::string text = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"blocks\":[";
+  for (size_t i = 0; i < count; ++i) {
+    if (i != 0) {
+      text += ',';
+    }
+
+    text += "{\"hash\":\"" + std::string(64, 'a' + i % 6) + "\",\"height\":" + std::to_string(i) +
+      ",\"timestamp\":" + std::to_string(1500000000 + i * 120) + ",\"difficulty\":" + std::to_string(i * 7919 + 1) +
+      ",\"reward\":" + std::to_string(i * 1000003) + ".25,\"orphan\":false,\"tx_hashes\":[\"" +
+      std::string(64, 'b') + "\",\"" + std::string(64, 'c') + "\"]}";
+  }
+
+  return text + "],\"status\":\"OK\"}}";
+}
+
+template<class F>
+double microsecondsPerRun(size_t runs, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < runs; ++i) {
+    f();
+  }
+
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+}
+
+TEST(JsonDocument, parsesIntegers) {
+  JsonDocument document;
+  ASSERT_TRUE(parse(document, "0").isInteger());
+  EXPECT_EQ(0, document.getRoot().getInteger());
+  EXPECT_EQ(-42, parse(document, "-42").getInteger());
+  EXPECT_EQ(std::numeric_limits<int64_t>::max(), parse(document, "9223372036854775807").getInteger());
+  EXPECT_EQ(std::numeric_limits<int64_t>::min(), parse(document, "-9223372036854775808").getInteger());
+}
+
+TEST(JsonDocument, rejectsLeadingZeros) {
+  JsonDocument document;
+  EXPECT_THROW(parse(document, "01"), std::runtime_error);
+  EXPECT_THROW(parse(document, "-01"), std::runtime_error);
+  EXPECT_THROW(parse(document, "-"), std::runtime_error);
+}
+
+TEST(JsonDocument, parsesFractions) {
+  JsonDocument document;
+  ASSERT_TRUE(parse(document, "1.5").isReal());
+  EXPECT_DOUBLE_EQ(1.5, document.getRoot().getReal());
+  EXPECT_DOUBLE_EQ(-0.25, parse(document, "-0.25").getReal());
+  EXPECT_THROW(parse(document, "1.2.3"), std::runtime_error);
+}
+
+TEST(JsonDocument, parsesExponents) {
+  JsonDocument document;
+  ASSERT_TRUE(parse(document, "1e5").isReal());
+  EXPECT_DOUBLE_EQ(1e5, document.getRoot().getReal());
+  EXPECT_DOUBLE_EQ(2.5e-3, parse(document, "2.5E-3").getReal());
+  EXPECT_DOUBLE_EQ(-3e+2, parse(document, "-3e+2").getReal());
+  EXPECT_THROW(parse(document, "1e"), std::runtime_error);
+  EXPECT_THROW(parse(document, "1e+"), std::runtime_error);
+  EXPECT_THROW(parse(document, "[1E]"), std::runtime_error);
+}
+
+TEST(JsonDocument, keepsUnsignedBitsAboveInt64) {
+  JsonDocument document;
+  ASSERT_TRUE(parse(document, "18446744073709551615").isInteger());
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), static_cast<uint64_t>(document.getRoot().getInteger()));
+  EXPECT_EQ(uint64_t(1) << 63, static_cast<uint64_t>(parse(document, "9223372036854775808").getInteger()));
+}
+
+TEST(JsonDocument, fallsBackToRealOnOverflow) {
+  JsonDocument document;
+  ASSERT_TRUE(parse(document, "18446744073709551616").isReal());
+  EXPECT_DOUBLE_EQ(18446744073709551616.0, document.getRoot().getReal());
+  ASSERT_TRUE(parse(document, "-9223372036854775809").isReal());
+  EXPECT_DOUBLE_EQ(-9223372036854775809.0, document.getRoot().getReal());
+  ASSERT_TRUE(parse(document, "123456789012345678901234567890").isReal());
+  EXPECT_DOUBLE_EQ(123456789012345678901234567890.0, document.getRoot().getReal());
+}
+
+TEST(JsonDocument, parsesNumbersInsideContainers) {
+  JsonDocument document;
+  const JsonNode& root = parse(document, "{\"a\":1e2,\"b\":[7,-8.5]}");
+  ASSERT_TRUE(root.isObject());
+  EXPECT_DOUBLE_EQ(100.0, root.find(StringView("a"))->getReal());
+  const JsonNode& b = *root.find(StringView("b"));
+  ASSERT_EQ(2, b.size());
+  EXPECT_EQ(7, b[0].getInteger());
+  EXPECT_DOUBLE_EQ(-8.5, b[1].getReal());
+}
+
+TEST(JsonDocument, acceptsNestingUpToLimit) {
+  JsonDocument document;
+  EXPECT_NO_THROW(parse(document, nested(128)));
+  EXPECT_TRUE(document.getRoot().isArray());
+  EXPECT_NO_THROW(parse(document, nestedObjects(128)));
+  EXPECT_TRUE(document.getRoot().isObject());
+}
+
+TEST(JsonDocument, rejectsDeeperNesting) {
+  JsonDocument document;
+  EXPECT_THROW(parse(document, nested(129)), std::runtime_error);
+  EXPECT_THROW(parse(document, std::string(100000, '[')), std::runtime_error);
+  EXPECT_THROW(parse(document, nestedObjects(129)), std::runtime_error);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(JsonDocument, DISABLED_benchmarkAgainstJsonValue) {
+  const std::string text = blockListPayload(2000);
+  const size_t runs = 50;
+  size_t sink = 0;
+
+  double valueParse = microsecondsPerRun(runs, [&] { sink += JsonValue::fromString(text).size(); });
+  JsonValue value = JsonValue::fromString(text);
+  double valueWrite = microsecondsPerRun(runs, [&] { sink += value.toString().size(); });
+
+  JsonDocument document;
+  double documentParse = microsecondsPerRun(runs, [&] { sink += parse(document, text).size(); });
+  double documentWrite = microsecondsPerRun(runs, [&] { sink += document.toString().size(); });
+
+  std::cout << "payload " << text.size() << " bytes, " << runs << " runs" << std::endl;
+  std::cout << "JsonValue     parse " << valueParse << " us, write " << valueWrite << " us" << std::endl;
+  std::cout << "JsonDocument  parse " << documentParse << " us, write " << documentWrite << " us" << std::endl;
+  EXPECT_NE(0, sink);
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Serialization/KVBinaryCommon.h"
+#include "Serialization/KVBinaryInputStreamSerializer.h"
+#include "Serialization/SerializationOverloads.h"
+#include "Serialization/SerializationTools.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+// Counts up to 63 fit in one varint byte
+const char ONE = 1 << 2;
+
+std::string storageHeader() {
+  KVBinaryStorageBlockHeader header = { PORTABLE_STORAGE_SIGNATUREA, PORTABLE_STORAGE_SIGNATUREB, PORTABLE_STORAGE_FORMAT_VER };
+  return std::string(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+// root { "a": { "a": { ... { } } } } with 'depth' objects below the root
+std::string nestedObjects(size_t depth) {
+  std::string storage = storageHeader() + ONE;
+  for (size_t i = 0; i < depth; ++i) {
+    storage += std::string("\x01" "a", 2) + static_cast<char>(BIN_KV_SERIALIZE_TYPE_OBJECT) + (i + 1 < depth ? ONE : '\0');
+  }
+
+  return storage;
+}
+
+// root { "a": [[[ ... ]]] } with 'depth' arrays of one array each, the innermost one empty
+std::string nestedArrays(size_t depth) {
+  std::string storage = storageHeader() + ONE + std::string("\x01" "a", 2) + static_cast<char>(BIN_KV_SERIALIZE_TYPE_ARRAY);
+  for (size_t i = 0; i < depth; ++i) {
+    storage += i + 1 < depth ? ONE : '\0';
+  }
+
+  return storage;
+}
+
+bool readMissing(const std::string& storage) {
+  KVBinaryInputStreamSerializer serializer(storage.data(), storage.size());
+  uint64_t value = 0;
+  return serializer(value, "x");
+}
+
+// the shape of a getblocks.bin reply: block blobs with their transaction blobs
+struct BlockEntry {
+  std::string block;
+  uint64_t height;
+  std::vector<std::string> txs;
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(block)
+    KV_MEMBER(height)
+    KV_MEMBER(txs)
+  }
+};
+
+struct BlocksReply {
+  std::vector<BlockEntry> blocks;
+  uint64_t start_height;
+  std::string status;
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(blocks)
+    KV_MEMBER(start_height)
+    KV_MEMBER(status)
+  }
+};
+
+}
+
+TEST(KVBinaryInputStreamSerializer, skipsShallowNesting) {
+  EXPECT_FALSE(readMissing(nestedObjects(10)));
+  EXPECT_FALSE(readMissing(nestedArrays(10)));
+}
+
+TEST(KVBinaryInputStreamSerializer, skipsNestingUpToLimit) {
+  EXPECT_NO_THROW(readMissing(nestedObjects(127)));
+  EXPECT_NO_THROW(readMissing(nestedArrays(127)));
+}
+
+TEST(KVBinaryInputStreamSerializer, rejectsDeepNesting) {
+  EXPECT_THROW(readMissing(nestedObjects(128)), std::runtime_error);
+  EXPECT_THROW(readMissing(nestedArrays(128)), std::runtime_error);
+  EXPECT_THROW(readMissing(nestedObjects(100000)), std::runtime_error);
+  EXPECT_THROW(readMissing(nestedArrays(1000000)), std::runtime_error);
+}
+
+TEST(KVBinaryInputStreamSerializer, rejectsDeepSections) {
+  std::string storage = nestedObjects(200);
+  KVBinaryInputStreamSerializer serializer(storage.data(), storage.size());
+  EXPECT_THROW({
+    for (size_t i = 0; i < 200; ++i) {
+      serializer.beginObject("a");
+    }
+  }, std::runtime_error);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(KVBinaryInputStreamSerializer, DISABLED_benchmarkBlocksReply) {
+  BlocksReply reply;
+  reply.start_height = 100000;
+  reply.status = "OK";
+  for (uint64_t i = 0; i < 1000; ++i) {
+    reply.blocks.push_back({ std::string(600, static_cast<char>(i)), reply.start_height + i, std::vector<std::string>(4, std::string(1500, 'x')) });
+  }
+
+  const size_t runs = 50;
+  std::string storage;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < runs; ++i) {
+    storage = storeToBinaryKeyValue(reply);
+  }
+
+  double store = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < runs; ++i) {
+    BlocksReply loaded;
+    ASSERT_TRUE(loadFromBinaryKeyValue(loaded, storage));
+    ASSERT_EQ(reply.blocks.size(), loaded.blocks.size());
+  }
+
+  double load = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+
+  std::cout << "payload " << storage.size() << " bytes, " << runs << " runs" << std::endl;
+  std::cout << "store " << store << " us, load " << load << " us" << std::endl;
+}
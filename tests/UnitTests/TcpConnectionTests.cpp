@@ -0,0 +1,88 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <System/ContextGroup.h>
+#include <System/Dispatcher.h>
+#include <System/Ipv4Address.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <System/TcpListener.h>
+
+namespace {
+
+void writeAll(System::TcpConnection& connection, const uint8_t* data, size_t size) {
+  size_t offset = 0;
+  while (offset < size) {
+    offset += connection.write(data + offset, size - offset);
+  }
+}
+
+void readAll(System::TcpConnection& connection, uint8_t* data, size_t size) {
+  size_t offset = 0;
+  while (offset < size) {
+    size_t read = connection.read(data + offset, size - offset);
+    ASSERT_NE(0, read);
+    offset += read;
+  }
+}
+
+// Sends 'rounds' messages of 'size' bytes over loopback and reads each one back from an echo context,
+// returns the elapsed time of the exchange
+std::chrono::duration<double> echo(size_t size, size_t rounds, uint16_t port) {
+  System::Dispatcher dispatcher;
+  System::TcpListener listener(dispatcher, System::Ipv4Address("127.0.0.1"), port);
+  System::ContextGroup group(dispatcher);
+  group.spawn([&] {
+    System::TcpConnection connection = listener.accept();
+    std::vector<uint8_t> buffer(64 * 1024);
+    for (;;) {
+      size_t read = connection.read(buffer.data(), buffer.size());
+      if (read == 0) {
+        break;
+      }
+
+      writeAll(connection, buffer.data(), read);
+    }
+  });
+
+  System::TcpConnection connection = System::TcpConnector(dispatcher).connect(System::Ipv4Address("127.0.0.1"), port);
+  std::vector<uint8_t> message(size);
+  std::vector<uint8_t> reply(size);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    message[0] = static_cast<uint8_t>(i);
+    writeAll(connection, message.data(), message.size());
+    readAll(connection, reply.data(), reply.size());
+    EXPECT_EQ(message, reply);
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  connection = System::TcpConnection();
+  group.wait();
+  return elapsed;
+}
+
+}
+
+TEST(TcpConnection, echoesOverLoopback) {
+  echo(16, 10, 18771);
+  echo(1024 * 1024, 2, 18772);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(TcpConnection, DISABLED_benchmarkLoopbackEcho) {
+  const size_t rounds = 100000;
+  for (size_t size : { 64, 64 * 1024 }) {
+    double seconds = echo(size, rounds, 18773).count();
+    std::cout << size << " B messages: " << rounds / seconds / 1e3 << " k round trips/s, " << 2.0 * size * rounds / seconds / 1e6 << " MB/s" << std::endl;
+  }
+}
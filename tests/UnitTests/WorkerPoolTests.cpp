@@ -0,0 +1,108 @@
+// Copyright (c) 2019-2020 The Lithe Project Development Team
+
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <System/ContextGroup.h>
+#include <System/Dispatcher.h>
+#include <System/Timer.h>
+#include <System/WorkerPool.h>
+
+namespace {
+
+void spin(std::chrono::milliseconds duration) {
+  auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+// Latencies of cheap requests arriving every millisecond while other clients keep the server
+// busy with slow read-only requests, run inline on the dispatcher or on the pool
+std::vector<double> mixedLoadLatencies(bool usePool) {
+  const size_t slowClients = 4;
+  const size_t slowRequests = 20;
+  const size_t fastRequests = 400;
+
+  System::Dispatcher dispatcher;
+  System::WorkerPool pool(dispatcher, slowClients);
+  System::ContextGroup group(dispatcher);
+  auto slowHandler = [] { spin(std::chrono::milliseconds(10)); };
+  for (size_t i = 0; i < slowClients; ++i) {
+    group.spawn([&] {
+      for (size_t j = 0; j < slowRequests; ++j) {
+        if (usePool) {
+          pool.execute(slowHandler);
+        } else {
+          slowHandler();
+        }
+
+        dispatcher.yield();
+      }
+    });
+  }
+
+  // latency counts from the moment a request was due, so time spent queued behind slow work is included
+  std::vector<double> latencies;
+  auto start = std::chrono::steady_clock::now();
+  System::Timer timer(dispatcher);
+  for (size_t i = 0; i < fastRequests; ++i) {
+    auto due = start + std::chrono::milliseconds(i);
+    auto now = std::chrono::steady_clock::now();
+    if (due > now) {
+      timer.sleep(due - now);
+    }
+
+    latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - due).count());
+  }
+
+  group.wait();
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+}
+
+TEST(WorkerPool, runsTaskOffDispatcherThread) {
+  System::Dispatcher dispatcher;
+  System::WorkerPool pool(dispatcher, 2);
+  std::thread::id worker;
+  pool.execute([&] { worker = std::this_thread::get_id(); });
+  EXPECT_NE(std::this_thread::get_id(), worker);
+}
+
+TEST(WorkerPool, runsWholeBatch) {
+  System::Dispatcher dispatcher;
+  System::WorkerPool pool(dispatcher, 3);
+  std::atomic<size_t> done(0);
+  pool.execute(std::vector<std::function<void()>>(10, [&] { ++done; }));
+  EXPECT_EQ(10, done.load());
+}
+
+TEST(WorkerPool, rethrowsTaskException) {
+  System::Dispatcher dispatcher;
+  System::WorkerPool pool(dispatcher, 2);
+  EXPECT_THROW(pool.execute([] { throw std::runtime_error("task"); }), std::runtime_error);
+  std::vector<std::function<void()>> tasks(4, [] {});
+  tasks[2] = [] { throw std::runtime_error("task"); };
+  EXPECT_THROW(pool.execute(tasks), std::runtime_error);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(WorkerPool, DISABLED_benchmarkMixedLoad) {
+  for (bool usePool : { false, true }) {
+    std::vector<double> latencies = mixedLoadLatencies(usePool);
+    std::cout << (usePool ? "worker pool" : "inline     ") << " p50 " << latencies[latencies.size() / 2] << " ms, p99 " <<
+      latencies[latencies.size() * 99 / 100] << " ms" << std::endl;
+  }
+}